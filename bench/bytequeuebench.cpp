@@ -0,0 +1,131 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/bytequeue.hpp"
+#include "pla/binarystring.hpp"
+#include "pla/string.hpp"
+
+using namespace pla;
+
+// Streams bytes through a FIFO holding a constant backlog, as protocol handlers do with their input:
+// a chunk is written, then a smaller record is read, until the total is transferred
+
+static double Run(Stream &fifo, size_t backlog, size_t chunk, size_t record, size_t total)
+{
+	std::vector<char> in(chunk), out(record);
+	for(size_t i = 0; i < chunk; ++i)
+		in[i] = char(i);
+
+	// Fill the backlog first
+	size_t pending = 0;
+	while(pending < backlog)
+	{
+		fifo.writeData(in.data(), chunk);
+		pending+= chunk;
+	}
+
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	size_t transferred = 0;
+	while(transferred < total)
+	{
+		fifo.writeData(in.data(), chunk);
+		pending+= chunk;
+
+		while(pending > backlog)
+		{
+			size_t size = fifo.readData(out.data(), record);
+			if(!size) throw Exception("FIFO is empty");
+			pending-= size;
+			transferred+= size;
+		}
+	}
+
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-c chunk size] [-r record size] [-m megabytes]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int chunk = 4096;
+	int record = 512;
+	int megabytes = 1024;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'c': chunk = value.toInt(); break;
+			case 'r': record = value.toInt(); break;
+			case 'm': megabytes = value.toInt(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(chunk <= 0 || record <= 0 || megabytes <= 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		const size_t Backlogs[] = { 4*1024, 64*1024, 1024*1024 };
+		for(size_t i = 0; i < sizeof(Backlogs)/sizeof(Backlogs[0]); ++i)
+		{
+			size_t backlog = Backlogs[i];
+			size_t total = size_t(megabytes)*1024*1024;
+
+			ByteQueue queue;
+			double queueTime = Run(queue, backlog, chunk, record, total);
+
+			// Erasing the front of a string is linear in the backlog, so less is transferred
+			BinaryString str;
+			size_t strTotal = std::max(total*4096/backlog/16, size_t(chunk));
+			double strTime = Run(str, backlog, chunk, record, strTotal);
+
+			std::cout<<"=== Backlog "<<backlog/1024<<" KiB, chunks of "<<chunk<<" B, records of "<<record<<" B"<<std::endl;
+			std::cout<<"ByteQueue: "<<total/queueTime/(1024*1024)<<" MiB/s"<<std::endl;
+			std::cout<<"BinaryString: "<<strTotal/strTime/(1024*1024)<<" MiB/s"<<std::endl;
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
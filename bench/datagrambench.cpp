@@ -0,0 +1,175 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/datagramsocket.hpp"
+#include "pla/iobuf.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace pla;
+
+// Datagrams are lent to the stream from shared blocks while the socket keeps receiving into them,
+// so appending to a chain read from the stream must never write into the room of the receive block
+
+static void Fill(char *buffer, size_t size, uint32_t seq)
+{
+	std::memcpy(buffer, &seq, sizeof(seq));
+	for(size_t i = sizeof(seq); i < size; ++i)
+		buffer[i] = char((seq + i) & 0xFF);
+}
+
+static bool Check(const char *buffer, size_t size, uint32_t &seq)
+{
+	if(size < sizeof(seq)) return false;
+	std::memcpy(&seq, buffer, sizeof(seq));
+	for(size_t i = sizeof(seq); i < size; ++i)
+		if(buffer[i] != char((seq + i) & 0xFF))
+			return false;
+	return true;
+}
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-n datagrams] [-z size] [-a appended size] [-w window]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 200000;
+	int size = 1000;
+	int appended = 256;
+	int window = 64;	// datagrams in flight, so the socket does not drop them
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'n': count = value.toInt(); break;
+			case 'z': size = value.toInt(); break;
+			case 'a': appended = value.toInt(); break;
+			case 'w': window = value.toInt(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(size < int(sizeof(uint32_t)) || size_t(size) > DatagramSocket::MaxDatagramSize || appended <= 0 || window <= 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		DatagramSocket server(Address("127.0.0.1", 0));
+		DatagramSocket client(Address("127.0.0.1", 0));
+		Address serverAddress("127.0.0.1", server.getBindAddress().port());
+		Address clientAddress("127.0.0.1", client.getBindAddress().port());
+
+		DatagramStream stream(&server, clientAddress);
+		stream.setTimeout(seconds(1.));
+
+		std::atomic<bool> stop(false);
+		std::atomic<int> progress(0);
+
+		// Reading the socket dispatches datagrams to the stream
+		std::thread receiver([&]() {
+			char buffer[1];
+			Address sender;
+			while(!stop)
+				server.read(buffer, sizeof(buffer), sender, milliseconds(100));
+		});
+
+		std::thread sender([&]() {
+			std::vector<char> buffer(size);
+			for(int i = 0; i < count && !stop; ++i)
+			{
+				while(i >= progress + window && !stop)
+					std::this_thread::yield();
+
+				Fill(buffer.data(), buffer.size(), uint32_t(i));
+				client.write(buffer.data(), buffer.size(), serverAddress);
+			}
+		});
+
+		const String trailer(appended, 'T');
+		std::vector<char> buffer(size + appended);
+		int received = 0;
+		int corrupted = 0;
+		int extended = 0;
+		uint32_t last = 0;
+		auto start = std::chrono::steady_clock::now();
+		try {
+			while(last + 1 < uint32_t(count))
+			{
+				IOBufChain chain;
+				if(!stream.readChain(chain, size)) break;
+				chain.append(trailer.data(), trailer.size());
+				if(chain.count() < 2) ++extended;	// the trailer was written after the datagram in the shared block
+				stream.nextRead();
+
+				// Give the socket time to receive the next datagram while the chain is alive
+				std::this_thread::yield();
+
+				uint32_t seq = 0;
+				size_t len = chain.copyTo(buffer.data(), buffer.size());
+				if(len != buffer.size()
+					|| !Check(buffer.data(), size, seq)
+					|| std::memcmp(buffer.data() + size, trailer.data(), trailer.size()) != 0)
+					++corrupted;
+				else last = seq;
+				progress = ++received;
+			}
+		}
+		catch(const Timeout &e)
+		{
+			// Remaining datagrams were dropped
+		}
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stop = true;
+		sender.join();
+		receiver.join();
+
+		IOBuf::Stats stats = IOBuf::GetStats();
+		std::cout<<"Datagrams: "<<received<<"/"<<count<<", "<<int(received/elapsed)<<"/s"<<std::endl;
+		std::cout<<"Blocks: "<<stats.allocations<<" allocated, "<<stats.reuses<<" reused"<<std::endl;
+		std::cout<<"Corrupted: "<<corrupted<<", extended: "<<extended<<std::endl;
+		if(corrupted || extended) return 1;
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/http.hpp"
+#include "pla/http2.hpp"
+#include "pla/histogram.hpp"
+
+#include "bench/referenceserver.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace pla;
+
+// HTTP/2 driver, LoadGenerator only speaks HTTP/1.1
+// Small requests are multiplexed over a single connection with prior knowledge, each thread
+// waiting for its response before sending the next request
+
+struct Results
+{
+	uint64_t requests = 0;
+	uint64_t errors = 0;
+	Histogram latency;	// milliseconds
+};
+
+static Results Run(Http2::Client &client, const String &url, int concurrency, duration d)
+{
+	using clock = std::chrono::steady_clock;
+	const auto end = clock::now() + std::chrono::duration_cast<clock::duration>(d);
+
+	std::vector<Results> results(concurrency);
+	std::vector<std::thread> threads;
+	for(int i = 0; i < concurrency; ++i)
+		threads.emplace_back([&client, &url, &results, end, i]()
+		{
+			Results &r = results[i];
+			while(clock::now() < end)
+			{
+				auto start = clock::now();
+				try {
+					if(client.request("GET", url) != 200)
+					{
+						++r.errors;
+						continue;
+					}
+				}
+				catch(const std::exception &e)
+				{
+					LogDebug("h2bench", e.what());
+					++r.errors;
+					if(client.isClosed()) break;
+					continue;
+				}
+
+				r.latency.add(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+				++r.requests;
+			}
+		});
+
+	Results total;
+	for(int i = 0; i < concurrency; ++i)
+	{
+		threads[i].join();
+		total.requests+= results[i].requests;
+		total.errors+= results[i].errors;
+		total.latency.merge(results[i].latency);
+	}
+
+	return total;
+}
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-p port] [-t server threads] [-c concurrent streams] [-s seconds]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int port = 8080;
+	int serverThreads = 4;
+	int concurrency = 0;	// 0 runs a series
+	double secs = 5.;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'p': port = value.toInt(); break;
+			case 't': serverThreads = value.toInt(); break;
+			case 'c': concurrency = value.toInt(); break;
+			case 's': secs = value.toDouble(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	try {
+		ReferenceServer server(port, serverThreads, "");
+
+		String host;
+		host << "127.0.0.1:" << port;
+		String url = "http://" + host + "/dynamic";
+
+		std::vector<int> levels;
+		if(concurrency > 0) levels.push_back(concurrency);
+		else levels = { 1, 16, 64, 256 };
+
+		for(auto it = levels.begin(); it != levels.end(); ++it)
+		{
+			Http2::Client client(host, false);	// a single connection per level
+
+			auto start = std::chrono::steady_clock::now();
+			Results results = Run(client, url, *it, seconds(secs));
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::cout<<"=== "<<*it<<" concurrent streams on one connection (GET /dynamic)"<<std::endl;
+			std::cout<<results.requests<<" requests in "<<elapsed<<" s"<<std::endl;
+			std::cout<<"Requests/s: "<<results.requests/elapsed<<std::endl;
+			std::cout<<"Errors: "<<results.errors<<std::endl;
+			std::cout<<"Latency (ms): "<<results.latency.toString()<<std::endl;
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/http.hpp"
+#include "pla/file.hpp"
+#include "pla/loadgenerator.hpp"
+
+#include "bench/referenceserver.hpp"
+
+using namespace pla;
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-p port] [-t server threads] [-c connections] [-l load threads] [-d pipelining] [-r rate] [-s seconds]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int port = 8080;
+	int serverThreads = 4;
+	int connections = 64;
+	int loadThreads = 2;
+	int pipelining = 1;
+	double rate = 0.;
+	double secs = 10.;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'p': port = value.toInt(); break;
+			case 't': serverThreads = value.toInt(); break;
+			case 'c': connections = value.toInt(); break;
+			case 'l': loadThreads = value.toInt(); break;
+			case 'd': pipelining = value.toInt(); break;
+			case 'r': rate = value.toDouble(); break;
+			case 's': secs = value.toDouble(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	try {
+		// Static file of 5 KB, small enough to be cached
+		TempFile file;
+		String content;
+		while(content.size() < 5*1024)
+			content << "Lorem ipsum dolor sit amet, consectetur adipiscing elit.\n";
+		file.write(content);
+		file.close();
+
+		ReferenceServer server(port, serverThreads, file.name());
+
+		StringMap form;
+		form["Content-Type"] = "application/x-www-form-urlencoded";
+		StringMap close;
+		close["Connection"] = "close";
+		String upload;
+		for(int i = 0; i < 16; ++i)
+			upload << (i ? "&" : "") << "field" << i << "=" << String(64, 'x');
+
+		struct Scenario
+		{
+			String name;
+			String method;
+			String path;
+			BinaryString body;
+			StringMap headers;
+			int pipelining;	// 0 means the -d option
+		};
+
+		// Small responses show the cost of connection setup, compared with keep-alive and pipelining
+		std::vector<Scenario> scenarios;
+		scenarios.push_back({ "Static file", "GET", "/static", "", StringMap(), 0 });
+		scenarios.push_back({ "Dynamic response", "GET", "/dynamic", "", StringMap(), 0 });
+		scenarios.push_back({ "Dynamic response, keep-alive", "GET", "/dynamic", "", StringMap(), 1 });
+		scenarios.push_back({ "Dynamic response, keep-alive pipelined", "GET", "/dynamic", "", StringMap(), 16 });
+		scenarios.push_back({ "Dynamic response, Connection: close", "GET", "/dynamic", "", close, 1 });
+		scenarios.push_back({ "POST upload", "POST", "/upload", upload, form, 0 });
+
+		Address address("127.0.0.1", uint16_t(port));
+		for(auto it = scenarios.begin(); it != scenarios.end(); ++it)
+		{
+			LoadGenerator generator(address);
+			generator.addRequest(it->method, it->path, it->body, it->headers);
+			generator.setConnections(connections);
+			generator.setThreads(loadThreads);
+			generator.setPipelining(it->pipelining ? it->pipelining : pipelining);
+			generator.setRate(rate);
+
+			LoadGenerator::Results results = generator.run(seconds(secs));
+			std::cout<<"=== "<<it->name<<" ("<<it->method<<" "<<it->path<<", pipelining "<<(it->pipelining ? it->pipelining : pipelining)<<")"<<std::endl;
+			std::cout<<results.toString()<<std::endl;
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/mime.hpp"
+#include "pla/map.hpp"
+
+using namespace pla;
+
+// Compares Mime::GetType with the former lookup, which locked a mutex, lowercased a copy of
+// the extension and searched a map of about 700 entries
+
+class MapLookup
+{
+public:
+	MapLookup(const std::vector<String> &extensions)
+	{
+		for(auto it = extensions.begin(); it != extensions.end(); ++it)
+			mTypes[*it] = Mime::GetType("file." + *it);
+
+		// Padded to the size of the former table, so the map has the same depth
+		for(int i = 0; mTypes.size() < 700; ++i)
+			mTypes[String("x-padding") + String::number(i)] = "application/octet-stream";
+	}
+
+	String get(const String &fileName)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		String extension = fileName.afterLast('.').toLower();
+		String type;
+		if(mTypes.get(extension, type)) return type;
+		return "application/octet-stream";
+	}
+
+private:
+	StringMap mTypes;
+	std::mutex mMutex;
+};
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-i iterations]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 10000000;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'i': iterations = value.toInt(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(iterations <= 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		// Names of static files as served by a web application, with a few unknown extensions
+		const char *Names[] = {
+			"index.html", "style.css", "app.min.js", "logo.png", "photo.JPG", "icon.svg",
+			"favicon.ico", "font.woff2", "data.json", "video.mp4", "song.mp3", "document.pdf",
+			"archive.tar.gz", "README", "notes.txt", "feed.xml", "image.webp", "page.HTM",
+			"backup.bak", "unknown.xyz"
+		};
+		const size_t NamesCount = sizeof(Names)/sizeof(Names[0]);
+
+		std::vector<String> names, extensions;
+		for(size_t i = 0; i < NamesCount; ++i)
+		{
+			names.push_back(Names[i]);
+			extensions.push_back(names.back().afterLast('.').toLower());
+		}
+
+		MapLookup mapLookup(extensions);
+
+		using clock = std::chrono::steady_clock;
+		size_t checksum = 0;
+
+		auto start = clock::now();
+		for(int i = 0; i < iterations; ++i)
+		{
+			const String &name = names[i % names.size()];
+			checksum+= std::strlen(Mime::GetType(name.data(), name.size()));
+		}
+		double viewTime = std::chrono::duration<double>(clock::now() - start).count();
+
+		start = clock::now();
+		for(int i = 0; i < iterations; ++i)
+			checksum+= Mime::GetType(names[i % names.size()]).size();
+		double stringTime = std::chrono::duration<double>(clock::now() - start).count();
+
+		start = clock::now();
+		for(int i = 0; i < iterations; ++i)
+			checksum+= mapLookup.get(names[i % names.size()]).size();
+		double mapTime = std::chrono::duration<double>(clock::now() - start).count();
+
+		for(size_t i = 0; i < names.size(); ++i)
+			if(mapLookup.get(names[i]) != Mime::GetType(names[i]))
+				throw Exception("Mismatch for " + names[i]);
+
+		std::cout<<"Lookups: "<<iterations<<" (checksum "<<checksum<<")"<<std::endl;
+		std::cout<<"Table, view: "<<viewTime*1e9/iterations<<" ns/lookup"<<std::endl;
+		std::cout<<"Table, String: "<<stringTime*1e9/iterations<<" ns/lookup"<<std::endl;
+		std::cout<<"Locked map: "<<mapTime*1e9/iterations<<" ns/lookup"<<std::endl;
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
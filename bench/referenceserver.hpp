@@ -0,0 +1,99 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef BENCH_REFERENCESERVER_H
+#define BENCH_REFERENCESERVER_H
+
+#include "pla/include.hpp"
+#include "pla/http.hpp"
+#include "pla/websocket.hpp"
+
+namespace pla
+{
+
+// Reference server for benchmarks, with a static file, a small dynamic response, an upload handler
+// and a WebSocket echo
+// The static route is only served if a file name is given
+class ReferenceServer : public Http::Server
+{
+public:
+	ReferenceServer(int port, int threads, const String &fileName) :
+		Http::Server(port, threads),
+		mFileName(fileName)
+	{
+
+	}
+
+	~ReferenceServer(void)
+	{
+		// Workers call process(), so requests in flight must end before this object does
+		mPool.join();
+	}
+
+	void process(Http::Request &request)
+	{
+		if(request.url == "/static" && !mFileName.empty())
+		{
+			respondWithFile(request, mFileName);
+			return;
+		}
+
+		if(request.url == "/websocket")
+		{
+			std::unique_ptr<WebSocket> ws(WebSocket::Upgrade(request, true));
+			if(!ws) throw 400;
+
+			BinaryString message;
+			while(ws->receive(message))
+			{
+				if(ws->isBinary()) ws->send(message);
+				else ws->send(String(message.data(), message.size()));
+			}
+			return;
+		}
+
+		String body;
+		if(request.url == "/dynamic")
+		{
+			if(request.method != "GET" && request.method != "HEAD") throw 405;
+			body = "Hello world!\n";
+		}
+		else if(request.url == "/upload")
+		{
+			if(request.method != "POST") throw 405;
+			body << request.post.size() << " fields, " << request.files.size() << " files\n";
+		}
+		else throw 404;
+
+		Http::Response response(request, 200);
+		response.headers["Content-Type"] = "text/plain; charset=UTF-8";
+		response.headers["Content-Length"] << body.size();
+		response.send();
+		if(request.method != "HEAD") *response.stream << body;
+	}
+
+private:
+	String mFileName;
+};
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/http.hpp"
+
+using namespace pla;
+
+// Compares Http::Router with the chain of comparisons applications used in process(),
+// matching patterns one after the other
+
+struct Route
+{
+	String method;
+	String pattern;
+};
+
+static bool LinearMatch(const String &pattern, const String &path)
+{
+	size_t p = 0, q = 0;
+	while(p < pattern.size() && q < path.size())
+	{
+		if(pattern[p] == '*' && pattern[p-1] == '/') return true;
+		if(pattern[p] == ':' && pattern[p-1] == '/')
+		{
+			p = pattern.find('/', p);
+			q = path.find('/', q);
+			if(p == String::npos || q == String::npos) return p == q;
+			continue;
+		}
+
+		if(pattern[p] != path[q]) return false;
+		++p; ++q;
+	}
+
+	return p == pattern.size() && q == path.size();
+}
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-n routes] [-i iterations]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 1000;
+	int iterations = 100000;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'n': count = value.toInt(); break;
+			case 'i': iterations = value.toInt(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(count <= 0 || iterations <= 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		// Realistic API: collections, items with an identifier, actions, and static trees
+		std::vector<Route> routes;
+		std::vector<String> paths;
+		for(int i = 0; int(routes.size()) < count; ++i)
+		{
+			String resource;
+			resource << "/api/v" << (i % 3 + 1) << "/resource" << i;
+			String file;
+			file << "/static/bundle" << i;
+			switch(i % 4)
+			{
+				case 0: routes.push_back({ "GET", resource }); paths.push_back(resource); break;
+				case 1: routes.push_back({ "GET", resource + "/:id" }); paths.push_back(resource + "/42"); break;
+				case 2: routes.push_back({ "POST", resource + "/:id/action" }); paths.push_back(resource + "/42/action"); break;
+				case 3: routes.push_back({ "GET", file + "/*path" }); paths.push_back(file + "/css/main.css"); break;
+			}
+		}
+
+		uint64_t handled = 0;
+		Http::Router router;
+		for(auto it = routes.begin(); it != routes.end(); ++it)
+			router.add(it->method, it->pattern, [&handled](Http::Request &request)
+			{
+				(void)request;
+				++handled;
+			});
+
+		std::vector<Http::Request> requests;
+		for(size_t i = 0; i < paths.size(); ++i)
+			requests.push_back(Http::Request(paths[i], routes[i].method));
+
+		using clock = std::chrono::steady_clock;
+
+		auto start = clock::now();
+		for(int i = 0; i < iterations; ++i)
+		{
+			Http::Request &request = requests[i % requests.size()];
+			request.params.clear();
+			if(!router.route(request)) throw Exception("No route for " + request.url);
+		}
+		double routerTime = std::chrono::duration<double>(clock::now() - start).count();
+
+		uint64_t matched = 0;
+		start = clock::now();
+		for(int i = 0; i < iterations; ++i)
+		{
+			const Http::Request &request = requests[i % requests.size()];
+			for(auto it = routes.begin(); it != routes.end(); ++it)
+				if(it->method == request.method && LinearMatch(it->pattern, request.url))
+				{
+					++matched;
+					break;
+				}
+		}
+		double linearTime = std::chrono::duration<double>(clock::now() - start).count();
+
+		if(handled != uint64_t(iterations) || matched != uint64_t(iterations))
+			throw Exception("Routes were missed");
+
+		std::cout<<"Routes: "<<routes.size()<<", lookups: "<<iterations<<std::endl;
+		std::cout<<"Router: "<<routerTime*1e9/iterations<<" ns/lookup"<<std::endl;
+		std::cout<<"Linear: "<<linearTime*1e9/iterations<<" ns/lookup"<<std::endl;
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/include.hpp"
+#include "pla/websocket.hpp"
+#include "pla/histogram.hpp"
+
+#include "bench/referenceserver.hpp"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+using namespace pla;
+
+// WebSocket driver, LoadGenerator only speaks HTTP/1.1
+// Each connection sends messages to the echo route of the reference server, keeping a window of
+// messages in flight, and the latency is the round trip of each message
+
+struct Results
+{
+	uint64_t messages = 0;
+	uint64_t errors = 0;
+	Histogram latency;	// milliseconds
+};
+
+static void Usage(const char *name)
+{
+	std::cerr<<"Usage: "<<name<<" [-p port] [-c connections] [-w window] [-z message size] [-m text|binary] [-d deflate 0|1] [-s seconds]"<<std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int port = 8080;
+	int connections = 16;
+	int window = 1;
+	int size = 64;
+	String mode = "binary";
+	bool deflate = false;
+	double secs = 5.;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		String arg(argv[i]);
+		if(i + 1 == argc || arg.size() != 2 || arg[0] != '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+
+		String value(argv[++i]);
+		switch(arg[1])
+		{
+			case 'p': port = value.toInt(); break;
+			case 'c': connections = value.toInt(); break;
+			case 'w': window = value.toInt(); break;
+			case 'z': size = value.toInt(); break;
+			case 'm': mode = value; break;
+			case 'd': deflate = (value.toInt() != 0); break;
+			case 's': secs = value.toDouble(); break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(connections <= 0 || window <= 0 || size <= 0 || (mode != "text" && mode != "binary"))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		// Each session holds a server thread
+		ReferenceServer server(port, connections + 1, "");
+		server.setUpgradeLimit(-1);
+
+		// Text messages mix ASCII and multibyte UTF-8 sequences
+		const bool text = (mode == "text");
+		String payload;
+		while(payload.size() < size_t(size))
+			payload << (text ? "Hello w\xC3\xB6rld \xE2\x82\xAC " : "0123456789abcdef");
+		while(payload.size() > size_t(size))
+			payload.resize(payload.size() - 1);
+		while(text && !payload.empty() && (payload[payload.size() - 1] & 0xC0) == 0x80)
+			payload.resize(payload.size() - 1);	// do not cut a sequence
+		BinaryString binaryPayload(payload.data(), payload.size());
+
+		String url;
+		url << "ws://127.0.0.1:" << port << "/websocket";
+
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+		const auto end = start + std::chrono::duration_cast<clock::duration>(seconds(secs));
+
+		std::vector<Results> results(connections);
+		std::vector<std::thread> threads;
+		for(int i = 0; i < connections; ++i)
+			threads.emplace_back([&, i]()
+			{
+				Results &r = results[i];
+				try {
+					std::unique_ptr<WebSocket> ws(WebSocket::Connect(url, StringMap(), deflate));
+					ws->setBinary(!text);
+
+					std::deque<clock::time_point> sent;
+					auto send = [&]()
+					{
+						sent.push_back(clock::now());
+						if(text) ws->send(payload);
+						else ws->send(binaryPayload);
+					};
+
+					for(int j = 0; j < window; ++j)
+						send();
+
+					BinaryString message;
+					while(!sent.empty() && ws->receive(message))
+					{
+						if(message.size() != payload.size()) ++r.errors;
+						r.latency.add(std::chrono::duration<double, std::milli>(clock::now() - sent.front()).count());
+						sent.pop_front();
+						++r.messages;
+
+						if(clock::now() < end) send();
+					}
+
+					ws->close();
+				}
+				catch(const std::exception &e)
+				{
+					LogDebug("wsbench", e.what());
+					++r.errors;
+				}
+			});
+
+		Results total;
+		for(int i = 0; i < connections; ++i)
+		{
+			threads[i].join();
+			total.messages+= results[i].messages;
+			total.errors+= results[i].errors;
+			total.latency.merge(results[i].latency);
+		}
+
+		double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		std::cout<<"=== "<<connections<<" connections, window "<<window<<", "<<mode<<" messages of "<<payload.size()<<" B"<<(deflate ? ", deflate" : "")<<std::endl;
+		std::cout<<total.messages<<" messages in "<<elapsed<<" s"<<std::endl;
+		std::cout<<"Messages/s: "<<total.messages/elapsed<<std::endl;
+		std::cout<<"Errors: "<<total.errors<<std::endl;
+		std::cout<<"Latency (ms): "<<total.latency.toString()<<std::endl;
+	}
+	catch(const std::exception &e)
+	{
+		LogError("main", e.what());
+		return 1;
+	}
+
+	return 0;
+}
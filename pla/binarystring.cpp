@@ -237,7 +237,7 @@ size_t BinaryString::readData(char *buffer, size_t size)
 {
 	size = std::min(size,this->size());
 	std::copy(begin(),begin()+size,buffer);
-	erase(begin(),begin()+size); // WARNING: linear with string size
+	erase(begin(),begin()+size); // WARNING: linear with string size, use ByteQueue as a FIFO
 	return size;
 }
 
@@ -246,6 +246,18 @@ void BinaryString::writeData(const char *data, size_t size)
 	insert(end(), data, data+size);
 }
 
+bool BinaryString::peekSpan(const char *&data, size_t &size)
+{
+	data = this->data();
+	size = this->size();
+	return true;
+}
+
+void BinaryString::consume(size_t size)
+{
+	erase(begin(),begin()+std::min(size,this->size())); // one erase for a whole scan instead of one per character
+}
+
 void BinaryString::clear(void)
 {
 	std::string::clear();
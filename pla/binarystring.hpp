@@ -73,6 +73,8 @@ public:
 	// Stream
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
+	bool peekSpan(const char *&data, size_t &size);
+	void consume(size_t size);
 	void clear(void);
 
 	// Serializable
@@ -190,4 +190,18 @@ void ByteArray::writeData(const char *data, size_t size)
 	mLeft+= size;
 }
 
+bool ByteArray::peekSpan(const char *&data, size_t &size)
+{
+	data = mArray+mReadPos;
+	size = mLeft;
+	return true;
+}
+
+void ByteArray::consume(size_t size)
+{
+	size = std::min(size,mLeft);
+	mReadPos+= size;
+	mLeft-= size;
+}
+
 }
@@ -59,6 +59,8 @@ public:
 protected:
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
+	bool peekSpan(const char *&data, size_t &size);
+	void consume(size_t size);
 
 private:
 	char *mArray		= NULL;
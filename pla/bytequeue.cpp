@@ -0,0 +1,147 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/bytequeue.hpp"
+
+namespace pla
+{
+
+ByteQueue::ByteQueue(void) :
+	mBegin(0),
+	mEnd(0)
+{
+
+}
+
+ByteQueue::ByteQueue(BinaryString &str) :
+	mBegin(0),
+	mEnd(0)
+{
+	swap(str);
+}
+
+ByteQueue::~ByteQueue(void)
+{
+
+}
+
+size_t ByteQueue::size(void) const
+{
+	return mEnd - mBegin;
+}
+
+bool ByteQueue::empty(void) const
+{
+	return mEnd == mBegin;
+}
+
+const char *ByteQueue::data(void) const
+{
+	return mBuffer.data() + mBegin;
+}
+
+void ByteQueue::consume(size_t size)
+{
+	mBegin+= std::min(size, mEnd - mBegin);
+	if(mBegin == mEnd) mBegin = mEnd = 0;
+}
+
+char *ByteQueue::reserve(size_t size)
+{
+	if(mBuffer.size() - mEnd >= size)
+		return mBuffer.ptr() + mEnd;
+
+	size_t readable = mEnd - mBegin;
+	if(mBegin >= readable && mBuffer.size() - readable >= size)
+	{
+		// Moving fewer bytes than were consumed keeps the cost amortized
+		std::memmove(mBuffer.ptr(), mBuffer.data() + mBegin, readable);
+	}
+	else {
+		// Growing geometrically, the consumed front is dropped at the same time
+		BinaryString buffer;
+		buffer.resize(std::max(readable + size, 2*mBuffer.size()));
+		std::memcpy(buffer.ptr(), mBuffer.data() + mBegin, readable);
+		mBuffer.swap(buffer);
+	}
+
+	mBegin = 0;
+	mEnd = readable;
+	return mBuffer.ptr() + mEnd;
+}
+
+void ByteQueue::commit(size_t size)
+{
+	Assert(mBuffer.size() - mEnd >= size);
+	mEnd+= size;
+}
+
+void ByteQueue::append(const char *data, size_t size)
+{
+	if(!size) return;
+	std::memcpy(reserve(size), data, size);
+	mEnd+= size;
+}
+
+void ByteQueue::swap(BinaryString &str)
+{
+	// Drop the consumed front and the unused space so the buffer holds exactly the readable bytes
+	if(mBegin) mBuffer.erase(0, mBegin);
+	mBuffer.resize(mEnd - mBegin);
+	mBuffer.swap(str);
+	mBegin = 0;
+	mEnd = mBuffer.size();
+}
+
+size_t ByteQueue::readData(char *buffer, size_t size)
+{
+	size = std::min(size, mEnd - mBegin);
+	std::memcpy(buffer, mBuffer.data() + mBegin, size);
+	consume(size);
+	return size;
+}
+
+void ByteQueue::writeData(const char *data, size_t size)
+{
+	append(data, size);
+}
+
+bool ByteQueue::ignore(size_t size)
+{
+	size = std::min(size, mEnd - mBegin);
+	if(size) mLast = mBuffer[mBegin + size - 1];
+	consume(size);
+	return true;
+}
+
+void ByteQueue::clear(void)
+{
+	mBegin = mEnd = 0;
+}
+
+bool ByteQueue::peekSpan(const char *&data, size_t &size)
+{
+	data = mBuffer.data() + mBegin;
+	size = mEnd - mBegin;
+	return true;
+}
+
+}
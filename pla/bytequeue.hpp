@@ -0,0 +1,68 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_BYTEQUEUE_H
+#define PLA_BYTEQUEUE_H
+
+#include "pla/include.hpp"
+#include "pla/stream.hpp"
+#include "pla/binarystring.hpp"
+
+namespace pla
+{
+
+// FIFO of bytes with read and write cursors over a single buffer
+// Reading is O(1), readable bytes are always contiguous, and the consumed front is reclaimed
+// by moving the remaining bytes only when they are fewer, so compaction is amortized
+class ByteQueue : public Stream
+{
+public:
+	ByteQueue(void);
+	ByteQueue(BinaryString &str);	// takes the content of str without copy, str is left empty
+	~ByteQueue(void);
+
+	size_t size(void) const;		// readable bytes
+	bool empty(void) const;
+	const char *data(void) const;	// readable bytes, valid until the next write
+	void consume(size_t size);		// drops readable bytes, also the Stream span interface
+
+	// Writing in place, for instance from a socket
+	char *reserve(size_t size);		// returns space for at least size bytes
+	void commit(size_t size);		// appends size bytes written in the reserved space
+
+	void append(const char *data, size_t size);
+	void swap(BinaryString &str);	// exchanges readable bytes with the content of str, without copy when nothing was consumed
+
+	// Stream
+	size_t readData(char *buffer, size_t size);
+	void writeData(const char *data, size_t size);
+	bool ignore(size_t size = 1);
+	void clear(void);
+	bool peekSpan(const char *&data, size_t &size);
+
+private:
+	BinaryString mBuffer;	// size() is the allocated space
+	size_t mBegin, mEnd;	// readable bytes
+};
+
+}
+
+#endif
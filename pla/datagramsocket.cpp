@@ -414,26 +414,37 @@ int DatagramSocket::recv(char *buffer, size_t size, Address &sender, duration ti
 		duration left = end - std::chrono::steady_clock::now();
 		if(!wait(left)) break;
 
-		char datagramBuffer[MaxDatagramSize];
+		// Received at the end of a pooled block, which successive datagrams fill so streams can share it
+		std::unique_lock<std::mutex> receiveLock(mReceiveMutex);
+		if(mReceiveBuffer.tailroom() < MaxDatagramSize)
+			mReceiveBuffer = IOBuf(IOBuf::BlockSize);
+
 		sockaddr_storage sa;
 		socklen_t sl = sizeof(sa);
-		int result = ::recvfrom(mSock, datagramBuffer, MaxDatagramSize, flags | MSG_PEEK, reinterpret_cast<sockaddr*>(&sa), &sl);
+		int result = ::recvfrom(mSock, mReceiveBuffer.tail(), MaxDatagramSize, flags | MSG_PEEK, reinterpret_cast<sockaddr*>(&sa), &sl);
 		if(result < 0) throw NetException("Unable to read from socket (error " + String::number(sockerrno) + ")");
 		sender.set(reinterpret_cast<sockaddr*>(&sa),sl);
 
+		// Reading a single byte is enough to remove the datagram from the socket
+		char discard;
+
 		std::unique_lock<std::mutex> lock(mStreamsMutex);
 		auto it = mStreams.find(sender.unmap());
 		if(it == mStreams.end())
 		{
+			// The datagram is not committed, so its room is reused
 			size = std::min(result, int(size));
-			std::memcpy(buffer, datagramBuffer, size);
+			IOBuf::Copy(buffer, mReceiveBuffer.tail(), size);
 
 			if(!(flags & MSG_PEEK))
-				::recvfrom(mSock, datagramBuffer, MaxDatagramSize, flags, reinterpret_cast<sockaddr*>(&sa), &sl);
+				::recvfrom(mSock, &discard, 1, flags, reinterpret_cast<sockaddr*>(&sa), &sl);
 			return size;
 		}
 
-		BinaryString tmp(datagramBuffer, size_t(result));
+		mReceiveBuffer.commit(size_t(result));
+		IOBuf datagram = mReceiveBuffer.slice(mReceiveBuffer.size() - size_t(result), size_t(result));
+		mReceiveBuffer.trimFront(mReceiveBuffer.size());	// keeps the room after the datagram
+
 		for(auto jt = it->second.begin(); jt != it->second.end(); ++jt)
 		{
 			DatagramStream *stream = *jt;
@@ -443,13 +454,13 @@ int DatagramSocket::recv(char *buffer, size_t size, Address &sender, duration ti
 				std::unique_lock<std::mutex> lock(stream->mMutex);
 
 				if(stream->mIncoming.size() < DatagramStream::MaxQueueSize)
-					stream->mIncoming.push(tmp);
+					stream->mIncoming.push(datagram);
 			}
 
 			stream->mCondition.notify_all();
 		}
 
-		::recvfrom(mSock, datagramBuffer, MaxDatagramSize, flags & ~MSG_PEEK, reinterpret_cast<sockaddr*>(&sa), &sl);
+		::recvfrom(mSock, &discard, 1, flags & ~MSG_PEEK, reinterpret_cast<sockaddr*>(&sa), &sl);
 	}
 	while(std::chrono::steady_clock::now() <= end);
 
@@ -551,11 +562,69 @@ size_t DatagramStream::readData(char *buffer, size_t size)
 
 	Assert(mOffset <= mIncoming.front().size());
 	size = std::min(size, size_t(mIncoming.front().size() - mOffset));
-	std::memcpy(buffer, mIncoming.front().data() + mOffset, size);
+	IOBuf::Copy(buffer, mIncoming.front().data() + mOffset, size);
 	mOffset+= size;
 	return size;
 }
 
+size_t DatagramStream::readChain(IOBufChain &chain, size_t max)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	if(!mCondition.wait_for(lock, mTimeout, [this]() {
+		return (!mSock || !mIncoming.empty());
+	}))
+		throw Timeout();
+
+	if(mIncoming.empty()) return 0;
+
+	const IOBuf &datagram = mIncoming.front();
+	Assert(mOffset <= datagram.size());
+	size_t size = std::min(max, size_t(datagram.size() - mOffset));
+	if(!size) return 0;
+
+	chain.append(datagram.slice(mOffset, size));
+	mOffset+= size;
+	mLast = datagram.data()[mOffset-1];
+	return size;
+}
+
+bool DatagramStream::lendsBuffers(void) const
+{
+	return true;
+}
+
+bool DatagramStream::peekSpan(const char *&data, size_t &size)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	if(!mCondition.wait_for(lock, mTimeout, [this]() {
+		return (!mSock || !mIncoming.empty());
+	}))
+		throw Timeout();
+
+	if(mIncoming.empty())
+	{
+		data = NULL;
+		size = 0;
+		return true;
+	}
+
+	const IOBuf &datagram = mIncoming.front();
+	Assert(mOffset <= datagram.size());
+	data = datagram.data() + mOffset;
+	size = datagram.size() - mOffset;
+	return true;
+}
+
+void DatagramStream::consume(size_t size)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	if(mIncoming.empty()) return;
+	mOffset+= std::min(size, size_t(mIncoming.front().size() - mOffset));
+}
+
 void DatagramStream::writeData(const char *data, size_t size)
 {
 	std::unique_lock<std::mutex> lock(mMutex);
@@ -25,6 +25,7 @@
 #include "pla/include.hpp"
 #include "pla/address.hpp"
 #include "pla/stream.hpp"
+#include "pla/iobuf.hpp"
 #include "pla/set.hpp"
 #include "pla/map.hpp"
 
@@ -74,6 +75,11 @@ private:
 	// Mapped streams
 	Map<Address, Set<DatagramStream*> > mStreams;
 	std::mutex mStreamsMutex;
+
+	IOBuf mReceiveBuffer;	// empty, at the end of the datagrams received in its block
+	std::mutex mReceiveMutex;
+
+	friend class EventLoop;
 };
 
 class DatagramStream : public Stream
@@ -94,6 +100,10 @@ public:
 	// Stream
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
+	size_t readChain(IOBufChain &chain, size_t max);	// lends the datagram without copy
+	bool lendsBuffers(void) const;
+	bool peekSpan(const char *&data, size_t &size);	// the span is valid until nextRead()
+	void consume(size_t size);
 	bool waitData(duration timeout);
 	bool nextRead(void);
 	bool nextWrite(void);
@@ -104,7 +114,7 @@ private:
 	DatagramSocket *mSock;
 	Address mAddr;
 	BinaryString mBuffer;
-	Queue<BinaryString> mIncoming;
+	Queue<IOBuf> mIncoming;	// datagrams are shared between the streams of a sender
 	size_t mOffset;
 	duration mTimeout;
 
@@ -0,0 +1,181 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/deflate.hpp"
+#include "pla/exception.hpp"
+
+namespace pla
+{
+
+static int WindowBits(Deflate::Format format)
+{
+	switch(format)
+	{
+	case Deflate::Raw:	return -MAX_WBITS;
+	case Deflate::Zlib:	return MAX_WBITS;
+	default:			return MAX_WBITS + 16;	// gzip header and trailer
+	}
+}
+
+void Deflate::Compress(const char *data, size_t size, String &output, Format format, int level)
+{
+	z_stream strm;
+	std::memset(&strm, 0, sizeof(strm));
+	if(deflateInit2(&strm, level, Z_DEFLATED, WindowBits(format), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw Exception("Unable to initialize deflate");
+
+	output.resize(deflateBound(&strm, uLong(size)));
+	strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	strm.avail_in = uInt(size);
+	strm.next_out = reinterpret_cast<Bytef*>(&output[0]);
+	strm.avail_out = uInt(output.size());
+
+	int ret = ::deflate(&strm, Z_FINISH);
+	output.resize(strm.total_out);
+	deflateEnd(&strm);
+
+	if(ret != Z_STREAM_END)
+		throw Exception("Deflate failed");
+}
+
+Deflate::Deflate(Stream *stream, Format format, int level, bool mustDelete) :
+	mStream(stream),
+	mFormat(format),
+	mLevel(std::max(std::min(level, Z_BEST_COMPRESSION), DefaultLevel)),
+	mMustDelete(mustDelete),
+	mDeflateInit(false),
+	mInflateInit(false),
+	mDeflateEnd(false),
+	mInflateEnd(false)
+{
+	Assert(mStream);
+	std::memset(&mDeflate, 0, sizeof(mDeflate));
+	std::memset(&mInflate, 0, sizeof(mInflate));
+}
+
+Deflate::~Deflate(void)
+{
+	if(mDeflateInit) deflateEnd(&mDeflate);
+	if(mInflateInit) inflateEnd(&mInflate);
+
+	if(mMustDelete)
+		delete mStream;
+}
+
+size_t Deflate::readData(char *buffer, size_t size)
+{
+	if(!mInflateInit)
+	{
+		// Gzip and zlib headers are detected automatically
+		int windowBits = (mFormat == Raw ? -MAX_WBITS : MAX_WBITS + 32);
+		if(inflateInit2(&mInflate, windowBits) != Z_OK)
+			throw Exception("Unable to initialize inflate");
+
+		mInflateInit = true;
+	}
+
+	if(mInflateEnd || !size)
+		return 0;
+
+	size = std::min(size, size_t(std::numeric_limits<uInt>::max()));
+	mInflate.next_out = reinterpret_cast<Bytef*>(buffer);
+	mInflate.avail_out = uInt(size);
+
+	// Read until some data is decompressed
+	while(mInflate.avail_out == uInt(size))
+	{
+		if(!mInflate.avail_in)
+		{
+			size_t len = mStream->readData(mReadBuffer, BufferSize);
+			if(!len) throw IOException("Compressed data is truncated");
+			mInflate.next_in = reinterpret_cast<Bytef*>(mReadBuffer);
+			mInflate.avail_in = uInt(len);
+		}
+
+		int ret = inflate(&mInflate, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END)
+		{
+			mInflateEnd = true;
+			break;
+		}
+
+		if(ret != Z_OK && ret != Z_BUF_ERROR)
+			throw IOException("Invalid compressed data");
+	}
+
+	return size - mInflate.avail_out;
+}
+
+void Deflate::writeData(const char *data, size_t size)
+{
+	if(size) deflate(data, size, Z_NO_FLUSH);
+}
+
+void Deflate::flush(void)
+{
+	if(mDeflateInit && !mDeflateEnd)
+		deflate(NULL, 0, Z_SYNC_FLUSH);
+
+	mStream->flush();
+}
+
+void Deflate::close(void)
+{
+	if(!mDeflateEnd)
+	{
+		deflate(NULL, 0, Z_FINISH);
+		mDeflateEnd = true;
+	}
+}
+
+void Deflate::deflate(const char *data, size_t size, int flush)
+{
+	if(mDeflateEnd)
+		throw IOException("Compressed data is already terminated");
+
+	if(!mDeflateInit)
+	{
+		if(deflateInit2(&mDeflate, mLevel, Z_DEFLATED, WindowBits(mFormat), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw Exception("Unable to initialize deflate");
+
+		mDeflateInit = true;
+	}
+
+	mDeflate.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	mDeflate.avail_in = uInt(size);
+
+	// Output is written each time the buffer is full, and when flushing
+	int ret;
+	do {
+		mDeflate.next_out = reinterpret_cast<Bytef*>(mWriteBuffer);
+		mDeflate.avail_out = uInt(sizeof(mWriteBuffer));
+
+		ret = ::deflate(&mDeflate, flush);
+		if(ret == Z_STREAM_ERROR)
+			throw Exception("Deflate failed");
+
+		size_t len = sizeof(mWriteBuffer) - mDeflate.avail_out;
+		if(len) mStream->writeData(mWriteBuffer, len);
+	}
+	while(mDeflate.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+}
+
+}
@@ -0,0 +1,71 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_DEFLATE_H
+#define PLA_DEFLATE_H
+
+#include "pla/include.hpp"
+#include "pla/stream.hpp"
+#include "pla/string.hpp"
+
+#include <zlib.h>
+
+namespace pla
+{
+
+// Deflate compresses what is written to the underlying stream,
+// and decompresses what is read from it.
+class Deflate : public Stream
+{
+public:
+	enum Format { Raw, Zlib, Gzip };	// Zlib is the "deflate" HTTP content coding
+
+	static const int DefaultLevel = Z_DEFAULT_COMPRESSION;
+
+	static void Compress(const char *data, size_t size, String &output, Format format = Gzip, int level = DefaultLevel);
+
+	Deflate(Stream *stream, Format format = Gzip, int level = DefaultLevel, bool mustDelete = false);
+	~Deflate(void);
+
+	// Stream
+	size_t readData(char *buffer, size_t size);
+	void writeData(const char *data, size_t size);
+	void flush(void);	// compressed data written so far can be decompressed
+	void close(void);	// terminates the compressed data, the underlying stream is not closed
+
+private:
+	void deflate(const char *data, size_t size, int flush);
+
+	Stream *mStream;
+	Format mFormat;
+	int mLevel;
+	bool mMustDelete;
+
+	z_stream mDeflate, mInflate;
+	bool mDeflateInit, mInflateInit;
+	bool mDeflateEnd, mInflateEnd;
+	char mReadBuffer[BufferSize];
+	char mWriteBuffer[BufferSize*4];
+};
+
+}
+
+#endif
@@ -0,0 +1,317 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/eventloop.hpp"
+#include "pla/exception.hpp"
+
+#ifdef LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace pla
+{
+
+#ifdef LINUX
+static uint32_t EpollEvents(int events)
+{
+	uint32_t flags = 0;
+	if(events & EventLoop::Readable) flags|= EPOLLIN;
+	if(events & EventLoop::Writable) flags|= EPOLLOUT;
+	return flags;
+}
+#endif
+
+EventLoop::EventLoop(void) :
+	mEpoll(-1),
+	mWakeup(-1),
+	mJoining(false)
+{
+#ifdef LINUX
+	mEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+	if(mEpoll < 0) throw Exception("Unable to create epoll instance");
+
+	mWakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(mWakeup < 0)
+	{
+		::close(mEpoll);
+		throw Exception("Unable to create event descriptor");
+	}
+
+	struct epoll_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = mWakeup;
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeup, &ev) < 0)
+	{
+		::close(mWakeup);
+		::close(mEpoll);
+		throw Exception("Unable to watch event descriptor");
+	}
+
+	mThread = std::thread([this]() {
+		run();
+	});
+#else
+	throw Unsupported("Event loop");
+#endif
+}
+
+EventLoop::~EventLoop(void)
+{
+	NOEXCEPTION(join());
+
+#ifdef LINUX
+	::close(mWakeup);
+	::close(mEpoll);
+#endif
+}
+
+void EventLoop::add(Socket *sock, int events, handler_t handler)
+{
+	Assert(sock);
+	add(sock->mSock, events, std::move(handler));
+}
+
+void EventLoop::add(ServerSocket *sock, handler_t handler)
+{
+	Assert(sock);
+	add(sock->mSock, Readable, std::move(handler));
+}
+
+void EventLoop::add(DatagramSocket *sock, handler_t handler)
+{
+	Assert(sock);
+	add(sock->mSock, Readable, std::move(handler));
+}
+
+void EventLoop::modify(Socket *sock, int events)
+{
+	Assert(sock);
+	modify(sock->mSock, events);
+}
+
+void EventLoop::remove(Socket *sock)
+{
+	Assert(sock);
+	remove(sock->mSock);
+}
+
+void EventLoop::remove(ServerSocket *sock)
+{
+	Assert(sock);
+	remove(sock->mSock);
+}
+
+void EventLoop::remove(DatagramSocket *sock)
+{
+	Assert(sock);
+	remove(sock->mSock);
+}
+
+void EventLoop::post(std::function<void()> task)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mTasks.push(std::move(task));
+	}
+
+	wakeup();
+}
+
+void EventLoop::schedule(duration delay, std::function<void()> task)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		auto time = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay);
+		mTimers.insert(std::make_pair(time, std::move(task)));
+	}
+
+	wakeup();
+}
+
+size_t EventLoop::count(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mHandlers.size();
+}
+
+void EventLoop::join(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mJoining) return;
+		mJoining = true;
+	}
+
+	wakeup();
+	if(mThread.joinable())
+	{
+		if(mThread.get_id() == std::this_thread::get_id()) mThread.detach();
+		else mThread.join();
+	}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mHandlers.clear();
+	mTimers.clear();
+}
+
+void EventLoop::add(socket_t fd, int events, handler_t handler)
+{
+	if(fd == INVALID_SOCKET) throw NetException("Socket is closed");
+
+#ifdef LINUX
+	std::unique_lock<std::mutex> lock(mMutex);
+	mHandlers[fd] = std::make_shared<handler_t>(std::move(handler));
+
+	struct epoll_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = EpollEvents(events);
+	ev.data.fd = fd;
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+	{
+		mHandlers.erase(fd);
+		throw Exception("Unable to watch socket (error " + String::number(errno) + ")");
+	}
+#endif
+}
+
+void EventLoop::modify(socket_t fd, int events)
+{
+#ifdef LINUX
+	struct epoll_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = EpollEvents(events);
+	ev.data.fd = fd;
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_MOD, fd, &ev) < 0)
+		throw Exception("Unable to modify watched socket (error " + String::number(errno) + ")");
+#endif
+}
+
+void EventLoop::remove(socket_t fd)
+{
+#ifdef LINUX
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mHandlers.erase(fd))
+		::epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, NULL);
+#endif
+}
+
+void EventLoop::wakeup(void)
+{
+#ifdef LINUX
+	uint64_t value = 1;
+	if(::write(mWakeup, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		LogWarn("EventLoop::wakeup", "Unable to signal event descriptor");
+#endif
+}
+
+void EventLoop::run(void)
+{
+#ifdef LINUX
+	const int MaxEvents = 256;
+	struct epoll_event events[MaxEvents];
+
+	while(true)
+	{
+		// Wait up to the next timer
+		int timeout = -1;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			if(!mTimers.empty())
+			{
+				auto left = mTimers.begin()->first - std::chrono::steady_clock::now();
+				timeout = std::max(0, int(std::ceil(milliseconds(left).count())));
+			}
+		}
+
+		int n = ::epoll_wait(mEpoll, events, MaxEvents, timeout);
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+			LogWarn("EventLoop::run", "epoll_wait failed (error " + String::number(errno) + ")");
+			break;
+		}
+
+		for(int i = 0; i < n; ++i)
+		{
+			int fd = events[i].data.fd;
+			if(fd == mWakeup)
+			{
+				uint64_t value;
+				while(::read(mWakeup, &value, sizeof(value)) > 0);
+				continue;
+			}
+
+			// Handler might be removed while running, so keep a reference
+			sptr<handler_t> handler;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				auto it = mHandlers.find(fd);
+				if(it == mHandlers.end()) continue;
+				handler = it->second;
+			}
+
+			// Errors are reported as readiness so the handler gets them on I/O
+			int flags = 0;
+			if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) flags|= Readable;
+			if(events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) flags|= Writable;
+
+			try {
+				(*handler)(flags);
+			}
+			catch(const std::exception &e)
+			{
+				LogWarn("EventLoop::run", String("Unhandled exception in handler: ") + e.what());
+			}
+		}
+
+		std::queue<std::function<void()> > tasks;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			if(mJoining) break;
+			std::swap(tasks, mTasks);
+
+			auto now = std::chrono::steady_clock::now();
+			while(!mTimers.empty() && mTimers.begin()->first <= now)
+			{
+				tasks.push(std::move(mTimers.begin()->second));
+				mTimers.erase(mTimers.begin());
+			}
+		}
+
+		while(!tasks.empty())
+		{
+			try {
+				tasks.front()();
+			}
+			catch(const std::exception &e)
+			{
+				LogWarn("EventLoop::run", String("Unhandled exception in task: ") + e.what());
+			}
+
+			tasks.pop();
+		}
+	}
+#endif
+}
+
+}
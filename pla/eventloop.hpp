@@ -0,0 +1,79 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_EVENTLOOP_H
+#define PLA_EVENTLOOP_H
+
+#include "pla/include.hpp"
+#include "pla/socket.hpp"
+#include "pla/serversocket.hpp"
+#include "pla/datagramsocket.hpp"
+#include "pla/map.hpp"
+
+namespace pla
+{
+
+// EventLoop watches sockets for readiness with epoll and calls handlers
+// from its own thread. Handlers must not block, see SecureTransport::setBlocking().
+// This is only available on Linux.
+class EventLoop
+{
+public:
+	enum Event { Readable = 0x1, Writable = 0x2 };
+	typedef std::function<void(int events)> handler_t;
+
+	EventLoop(void);
+	~EventLoop(void);
+
+	// Events are level-triggered
+	void add(Socket *sock, int events, handler_t handler);
+	void add(ServerSocket *sock, handler_t handler);		// readable when a connection is pending
+	void add(DatagramSocket *sock, handler_t handler);	// readable when a datagram is pending
+	void modify(Socket *sock, int events);
+	void remove(Socket *sock);
+	void remove(ServerSocket *sock);
+	void remove(DatagramSocket *sock);
+
+	void post(std::function<void()> task);	// task will be run from the loop thread
+	void schedule(duration delay, std::function<void()> task);	// same, after delay
+	size_t count(void) const;
+	void join(void);
+
+private:
+	void add(socket_t fd, int events, handler_t handler);
+	void modify(socket_t fd, int events);
+	void remove(socket_t fd);
+	void wakeup(void);
+	void run(void);
+
+	int mEpoll;
+	int mWakeup;	// eventfd to interrupt epoll_wait()
+	std::map<socket_t, sptr<handler_t> > mHandlers;
+	std::queue<std::function<void()> > mTasks;
+	std::multimap<std::chrono::steady_clock::time_point, std::function<void()> > mTimers;
+	std::thread mThread;
+	mutable std::mutex mMutex;
+	bool mJoining;
+};
+
+}
+
+#endif
@@ -172,6 +172,7 @@ void File::open(const String &filename, OpenMode mode)
 
 	mReadPosition = 0;
 	mWritePosition = 0;
+	mReadAhead.clear();
 
 	if(m & std::ios_base::app)
 		mWritePosition = size();
@@ -184,6 +185,7 @@ void File::close(void)
 		std::fstream::close();
 
 	std::fstream::clear();	// clear state
+	mReadAhead.clear();
 }
 
 File::OpenMode File::openMode(void) const
@@ -201,6 +203,7 @@ void  File::reopen(OpenMode mode)
 void File::seekRead(int64_t position)
 {
 	mReadPosition = position;
+	mReadAhead.clear();
 
 	int64_t step = std::numeric_limits<std::streamoff>::max();	// streamoff is signed
 	std::fstream::seekg(0, std::fstream::beg);
@@ -215,6 +218,7 @@ void File::seekRead(int64_t position)
 void File::seekWrite(int64_t position)
 {
 	mWritePosition = position;
+	mReadAhead.clear();
 
 	int64_t step = std::numeric_limits<std::streamoff>::max();	// streamoff is signed
 	std::fstream::seekp(0, std::fstream::beg);
@@ -252,6 +256,17 @@ uint64_t File::size(void) const
 }
 
 size_t File::readData(char *buffer, size_t size)
+{
+	if(!mReadAhead.empty())
+		size = mReadAhead.readData(buffer, size);
+	else
+		size = readFile(buffer, size);
+
+	mReadPosition+= size;
+	return size;
+}
+
+size_t File::readFile(char *buffer, size_t size)
 {
 #ifdef __clang__
 	// Hack to fix a bug with readsome() not resetting gcount
@@ -266,12 +281,15 @@ size_t File::readData(char *buffer, size_t size)
 	if(std::fstream::bad())
 		throw Exception(String("Unable to read from file: ") + mName);
 
-	mReadPosition+= std::fstream::gcount();
 	return std::fstream::gcount();
 }
 
 void File::writeData(const char *data, size_t size)
 {
+	// Reading and writing share the file position, so it is moved back over bytes read ahead
+	if(!mReadAhead.empty())
+		seekRead(mReadPosition);
+
 	std::fstream::clear();	// clear state
 	std::fstream::write(data,size);
 	if(std::fstream::bad())
@@ -307,6 +325,23 @@ bool File::skipMark(void)
 	return false;
 }
 
+bool File::peekSpan(const char *&data, size_t &size)
+{
+	if(mReadAhead.empty())
+		mReadAhead.commit(readFile(mReadAhead.reserve(BufferSize), BufferSize));
+
+	data = mReadAhead.data();
+	size = mReadAhead.size();
+	return true;
+}
+
+void File::consume(size_t size)
+{
+	size = std::min(size, mReadAhead.size());
+	mReadAhead.consume(size);
+	mReadPosition+= size;
+}
+
 Stream *File::pipeIn(void)
 {
 	// Somehow using Append here can result in a write failure
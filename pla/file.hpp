@@ -25,6 +25,7 @@
 #include "pla/stream.hpp"
 #include "pla/string.hpp"
 #include "pla/time.hpp"
+#include "pla/bytequeue.hpp"
 
 #include <fstream>
 
@@ -74,6 +75,8 @@ public:
 	void writeData(const char *data, size_t size);
 	void flush(void);
 	bool skipMark(void);
+	bool peekSpan(const char *&data, size_t &size);
+	void consume(size_t size);
 
 protected:
 	static String TempPath(void);
@@ -82,6 +85,11 @@ protected:
 	String mName;
 	OpenMode mMode;
 	int64_t mReadPosition, mWritePosition;
+
+private:
+	size_t readFile(char *buffer, size_t size);
+
+	ByteQueue mReadAhead;	// read by peekSpan() but not consumed yet, mReadPosition excludes it
 };
 
 class SafeWriteFile : public File
@@ -0,0 +1,193 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/histogram.hpp"
+
+namespace pla
+{
+
+Histogram::Histogram(void) :
+	mBuckets(BucketsCount, 0),
+	mCount(0),
+	mSum(0.),
+	mMin(0.),
+	mMax(0.)
+{
+
+}
+
+Histogram::Histogram(const Histogram &histogram) :
+	Histogram()
+{
+	merge(histogram);
+}
+
+Histogram::~Histogram(void)
+{
+
+}
+
+Histogram &Histogram::operator=(const Histogram &histogram)
+{
+	if(&histogram != this)
+	{
+		clear();
+		merge(histogram);
+	}
+	return *this;
+}
+
+void Histogram::add(double value)
+{
+	int index = BucketIndex(value);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	++mBuckets[index];
+	if(!mCount || value < mMin) mMin = value;
+	if(!mCount || value > mMax) mMax = value;
+	mSum+= value;
+	++mCount;
+}
+
+void Histogram::merge(const Histogram &histogram)
+{
+	std::vector<uint64_t> buckets;
+	uint64_t count;
+	double sum, min, max;
+	{
+		std::unique_lock<std::mutex> lock(histogram.mMutex);
+		buckets = histogram.mBuckets;
+		count = histogram.mCount;
+		sum = histogram.mSum;
+		min = histogram.mMin;
+		max = histogram.mMax;
+	}
+
+	if(!count) return;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	for(int i=0; i<BucketsCount; ++i)
+		mBuckets[i]+= buckets[i];
+	if(!mCount || min < mMin) mMin = min;
+	if(!mCount || max > mMax) mMax = max;
+	mSum+= sum;
+	mCount+= count;
+}
+
+void Histogram::clear(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	std::fill(mBuckets.begin(), mBuckets.end(), 0);
+	mCount = 0;
+	mSum = mMin = mMax = 0.;
+}
+
+uint64_t Histogram::count(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mCount;
+}
+
+double Histogram::sum(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mSum;
+}
+
+double Histogram::mean(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(!mCount) return 0.;
+	return mSum/double(mCount);
+}
+
+double Histogram::min(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mMin;
+}
+
+double Histogram::max(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mMax;
+}
+
+double Histogram::percentile(double p) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(!mCount) return 0.;
+
+	p = bounds(p, 0., 100.);
+	uint64_t rank = uint64_t(std::ceil(p/100.*double(mCount)));
+	if(!rank) return mMin;
+
+	// Zero and negative values are counted in the last bucket
+	uint64_t total = mBuckets[BucketsCount-1];
+	if(total >= rank) return std::min(0., mMax);
+
+	for(int i=0; i<BucketsCount-1; ++i)
+	{
+		total+= mBuckets[i];
+		if(total >= rank)
+			return bounds(BucketValue(i), mMin, mMax);
+	}
+
+	return mMax;
+}
+
+String Histogram::toString(void) const
+{
+	String str;
+	str<<"count="<<String::number64(count());
+	str<<" mean="<<String::number(mean());
+	str<<" min="<<String::number(min());
+	str<<" p50="<<String::number(percentile(50.));
+	str<<" p90="<<String::number(percentile(90.));
+	str<<" p99="<<String::number(percentile(99.));
+	str<<" p99.9="<<String::number(percentile(99.9));
+	str<<" max="<<String::number(max());
+	return str;
+}
+
+int Histogram::BucketIndex(double value)
+{
+	if(!(value > 0.)) return BucketsCount-1;
+
+	int exponent = 0;
+	double mantissa = std::frexp(value, &exponent);	// value = mantissa * 2^exponent, mantissa in [0.5, 1)
+	if(exponent <= MinExponent) return 0;
+	if(exponent > MaxExponent) return BucketsCount-2;
+
+	int sub = int((mantissa - 0.5)*2.*SubBuckets);
+	return (exponent - MinExponent - 1)*SubBuckets + std::min(sub, SubBuckets-1);
+}
+
+double Histogram::BucketValue(int index)
+{
+	// Middle of the bucket
+	int exponent = index/SubBuckets + MinExponent + 1;
+	int sub = index%SubBuckets;
+	double mantissa = 0.5 + (double(sub) + 0.5)/(2.*SubBuckets);
+	return std::ldexp(mantissa, exponent);
+}
+
+}
@@ -0,0 +1,73 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_HISTOGRAM_H
+#define PLA_HISTOGRAM_H
+
+#include "pla/include.hpp"
+#include "pla/string.hpp"
+
+namespace pla
+{
+
+// Thread-safe histogram with logarithmic buckets, suitable for latencies and rates
+// Relative error on percentiles is bounded by the bucket resolution (about 6%)
+class Histogram
+{
+public:
+	Histogram(void);
+	Histogram(const Histogram &histogram);
+	~Histogram(void);
+
+	Histogram &operator=(const Histogram &histogram);
+
+	void add(double value);
+	void merge(const Histogram &histogram);
+	void clear(void);
+
+	uint64_t count(void) const;
+	double sum(void) const;
+	double mean(void) const;
+	double min(void) const;
+	double max(void) const;
+	double percentile(double p) const;	// p in [0, 100]
+
+	String toString(void) const;	// summary with usual percentiles
+
+private:
+	static const int SubBuckets = 16;
+	static const int MinExponent = -32;
+	static const int MaxExponent = 64;
+	static const int BucketsCount = (MaxExponent - MinExponent)*SubBuckets + 1;	// last one is zero or negative
+
+	static int BucketIndex(double value);
+	static double BucketValue(int index);
+
+	std::vector<uint64_t> mBuckets;
+	uint64_t mCount;
+	double mSum, mMin, mMax;
+
+	mutable std::mutex mMutex;
+};
+
+}
+
+#endif
@@ -20,17 +20,517 @@
  *************************************************************************/
 
 #include "pla/http.hpp"
+#include "pla/http2.hpp"
+#include "pla/bytequeue.hpp"
 #include "pla/exception.hpp"
 #include "pla/directory.hpp"
 #include "pla/mime.hpp"
+#include "pla/crypto.hpp"
 #include "pla/proxy.hpp"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace pla
 {
 
 String Http::UserAgent = "unknown";
 duration Http::ConnectTimeout = seconds(10.);
 duration Http::RequestTimeout = seconds(10.);
+duration Http::KeepAliveTimeout = seconds(10.);
+int Http::KeepAliveMaxRequests = 100;
+int Http::CompressionLevel = 1;
+size_t Http::CompressionMinSize = 256;
+int64_t Http::MaxFieldSize = 1024*1024;
+int64_t Http::MaxFileSize = 0;
+bool Http::EnableHttp2 = true;
+
+duration Http::FileCache::RevalidationPeriod = seconds(1.);
+
+int Http::Downloader::DefaultConnections = 4;
+int64_t Http::Downloader::MinRangeSize = 256*1024;
+int64_t Http::Downloader::MaxRangeSize = 4*1024*1024;
+int Http::Downloader::MaxRetries = 3;
+
+size_t Http::ChunkedStream::ChunkSize = 16*1024;
+size_t Http::ChunkedStream::MaxTrailersSize = 16*1024;
+const size_t Http::ChunkedStream::MaxTrailers;
+const size_t Http::ChunkedStream::HeaderSize = 2*sizeof(size_t) + 2;	// hexadecimal size and CRLF
+
+Http::ChunkedStream::ChunkedStream(Stream *stream, bool mustDelete) :
+	mStream(stream),
+	mMustDelete(mustDelete),
+	mReadLeft(0),
+	mReadChunk(false),
+	mReadEnd(false),
+	mWriteBuffer(NULL),
+	mWriteSize(0),
+	mWriteEnd(false)
+{
+	Assert(mStream);
+}
+
+Http::ChunkedStream::~ChunkedStream(void)
+{
+	delete[] mWriteBuffer;
+
+	if(mMustDelete)
+		delete mStream;
+}
+
+StringMap &Http::ChunkedStream::trailers(void)
+{
+	return mTrailers;
+}
+
+const StringMap &Http::ChunkedStream::trailers(void) const
+{
+	return mTrailers;
+}
+
+size_t Http::ChunkedStream::readData(char *buffer, size_t size)
+{
+	if(mReadEnd) return 0;
+
+	if(!mReadLeft)
+	{
+		String line;
+		if(mReadChunk)
+		{
+			// CRLF after chunk data
+			AssertIO(mStream->readLine(line));
+			if(!line.empty()) throw Exception("Invalid HTTP chunk");
+			mReadChunk = false;
+		}
+
+		AssertIO(mStream->readLine(line));
+		line.cut(';');	// ignore chunk extensions
+		line.trim();
+
+		char *end = NULL;
+		mReadLeft = std::strtoull(line.c_str(), &end, 16);
+		if(line.empty() || *end != '\0')
+			throw Exception("Invalid HTTP chunk size");
+
+		if(!mReadLeft)
+		{
+			// Last chunk, read trailers
+			size_t count = 0, total = 0;
+			while(true)
+			{
+				AssertIO(mStream->readLine(line));
+				if(line.empty()) break;
+
+				// Limited like the head, as trailers are buffered
+				total+= line.size();
+				if(++count > MaxTrailers || total > MaxTrailersSize)
+					throw Exception("HTTP trailers too large");
+
+				String value = line.cut(':');
+				line.trim();
+				value.trim();
+				mTrailers.insert(line, value);
+			}
+
+			mReadEnd = true;
+			return 0;
+		}
+
+		mReadChunk = true;
+	}
+
+	size_t len = mStream->readData(buffer, size_t(std::min(uint64_t(size), mReadLeft)));
+	if(!len) throw NetException("Connection unexpectedly closed");
+	mReadLeft-= len;
+	return len;
+}
+
+void Http::ChunkedStream::writeData(const char *data, size_t size)
+{
+	if(mWriteEnd) throw Exception("Writing after end of chunked body");
+	if(!size) return;	// an empty chunk would end the body
+
+	if(!mWriteBuffer)
+		mWriteBuffer = new char[HeaderSize + ChunkSize + 2];
+
+	if(mWriteSize + size > ChunkSize)
+	{
+		writeBuffer();
+
+		if(size >= ChunkSize)
+		{
+			// Send large data directly as a single chunk
+			char header[HeaderSize + 1];
+			int len = std::snprintf(header, HeaderSize + 1, "%llx\r\n", (unsigned long long)size);
+			mStream->writeData(header, len);
+			mStream->writeData(data, size);
+			mStream->writeData("\r\n", 2);
+			return;
+		}
+	}
+
+	std::memcpy(mWriteBuffer + HeaderSize + mWriteSize, data, size);
+	mWriteSize+= size;
+}
+
+void Http::ChunkedStream::flush(void)
+{
+	writeBuffer();
+	mStream->flush();
+}
+
+void Http::ChunkedStream::close(void)
+{
+	if(mWriteEnd) return;
+	writeBuffer();
+	mWriteEnd = true;
+
+	String buf;
+	buf<<"0\r\n";
+	for(StringMap::iterator it = mTrailers.begin(); it != mTrailers.end(); ++it)
+		buf<<it->first<<": "<<it->second<<"\r\n";
+	buf<<"\r\n";
+	*mStream<<buf;
+}
+
+void Http::ChunkedStream::writeBuffer(void)
+{
+	if(!mWriteSize) return;
+
+	// Prepend the header in the reserved space to send the chunk at once
+	char header[HeaderSize + 1];
+	int len = std::snprintf(header, HeaderSize + 1, "%llx\r\n", (unsigned long long)mWriteSize);
+	char *chunk = mWriteBuffer + HeaderSize - len;
+	std::memcpy(chunk, header, len);
+	std::memcpy(mWriteBuffer + HeaderSize + mWriteSize, "\r\n", 2);
+
+	mStream->writeData(chunk, len + mWriteSize + 2);
+	mWriteSize = 0;
+}
+
+size_t Http::RequestParser::MaxHeadSize = 64*1024;
+
+// Returns the first occurrence of a or b in [begin, end), or end
+static const char *FindEither(const char *begin, const char *end, char a, char b)
+{
+#ifdef __SSE2__
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	while(end - begin >= 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)));
+		if(mask) return begin + __builtin_ctz(mask);
+		begin+= 16;
+	}
+#endif
+	while(begin != end && *begin != a && *begin != b) ++begin;
+	return begin;
+}
+
+static const char *FindChar(const char *begin, const char *end, char c)
+{
+	const char *p = static_cast<const char*>(std::memchr(begin, c, end - begin));	// vectorized by the C library
+	return p ? p : end;
+}
+
+static const char *TrimFront(const char *begin, const char *end)
+{
+	while(begin != end && (*begin == ' ' || *begin == '\t')) ++begin;
+	return begin;
+}
+
+static const char *TrimBack(const char *begin, const char *end)
+{
+	while(end != begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+	return end;
+}
+
+static int HexValue(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+bool Http::RequestParser::View::equals(const char *str) const
+{
+	return std::strncmp(data, str, size) == 0 && str[size] == '\0';
+}
+
+bool Http::RequestParser::View::equalsNoCase(const char *str) const
+{
+	for(size_t i = 0; i < size; ++i)
+	{
+		if(str[i] == '\0' || std::tolower(static_cast<unsigned char>(data[i])) != std::tolower(static_cast<unsigned char>(str[i])))
+			return false;
+	}
+
+	return str[size] == '\0';
+}
+
+String Http::RequestParser::View::toString(void) const
+{
+	return String(data, size);
+}
+
+String Http::RequestParser::View::urlDecode(void) const
+{
+	String out;
+	out.reserve(size);
+	for(size_t i = 0; i < size; ++i)
+	{
+		char c = data[i];
+		if(c == '%' && i + 2 < size && HexValue(data[i+1]) >= 0 && HexValue(data[i+2]) >= 0)
+		{
+			out+= char(HexValue(data[i+1])*16 + HexValue(data[i+2]));
+			i+= 2;
+		}
+		else if(c == '+') out+= ' ';
+		else out+= c;
+	}
+	return out;
+}
+
+Http::RequestParser::RequestParser(void)
+{
+	reset();
+}
+
+void Http::RequestParser::reset(void)
+{
+	mLineStart = 0;
+	mHeadStart = 0;
+	mHeadSize = 0;
+	mHeadersCount = 0;
+	mMethod = mTarget = mPath = mQuery = mVersion = View();
+}
+
+size_t Http::RequestParser::parse(const char *data, size_t size)
+{
+	if(mHeadSize) return mHeadSize;
+
+	// Look for the empty line ending the head, resuming at the current line
+	const char *end = data + size;
+	const char *line = data + mLineStart;
+	const char *eol;
+	while((eol = FindChar(line, end, '\n')) != end)
+	{
+		if(eol == line || (eol == line + 1 && *line == '\r'))
+		{
+			if(line != data + mHeadStart)
+			{
+				mHeadSize = eol + 1 - data;
+				parseHead(data, mHeadSize);
+				return mHeadSize;
+			}
+
+			// Ignore empty lines before the request line
+			mHeadStart = eol + 1 - data;
+		}
+
+		line = eol + 1;
+	}
+
+	mLineStart = line - data;
+	if(size > MaxHeadSize) throw 431;
+	return 0;
+}
+
+void Http::RequestParser::parseHead(const char *data, size_t size)
+{
+	const char *end = data + size;
+
+	// Request line: method, target and version
+	const char *line = data + mHeadStart;
+	const char *eol = FindChar(line, end, '\n');
+	const char *lineEnd = TrimBack(line, eol);
+
+	const char *sp = FindChar(line, lineEnd, ' ');
+	if(sp == line || sp == lineEnd) throw 400;
+	mMethod = View(line, sp - line);
+
+	const char *target = sp + 1;
+	sp = FindChar(target, lineEnd, ' ');
+	if(sp == target || sp == lineEnd) throw 400;
+	mTarget = View(target, sp - target);
+
+	const char *question = FindChar(target, sp, '?');
+	mPath = View(target, question - target);
+	if(question != sp) mQuery = View(question + 1, sp - question - 1);
+
+	const char *protocol = sp + 1;
+	if(lineEnd - protocol <= 5 || std::strncmp(protocol, "HTTP/", 5) != 0) throw 400;
+	mVersion = View(protocol + 5, lineEnd - protocol - 5);
+
+	// Header fields
+	mHeadersCount = 0;
+	line = eol + 1;
+	while(true)
+	{
+		// A single pass finds the colon or the end of line
+		const char *colon = FindEither(line, end, ':', '\n');
+		if(colon == end) throw 400;
+		if(*colon == '\n')
+		{
+			if(TrimBack(line, colon) == line) break;	// end of head
+			throw 400;	// missing colon
+		}
+
+		// Whitespace is not allowed in field names, nor obsolete line folding
+		if(colon == line || colon[-1] == ' ' || colon[-1] == '\t' || *line == ' ' || *line == '\t')
+			throw 400;
+
+		eol = FindChar(colon, end, '\n');
+		if(mHeadersCount == MaxHeaders) throw 431;
+
+		Header &header = mHeaders[mHeadersCount++];
+		header.name = View(line, colon - line);
+		const char *value = TrimFront(colon + 1, eol);
+		header.value = View(value, TrimBack(value, eol) - value);
+
+		line = eol + 1;
+	}
+}
+
+Http::RequestParser::View Http::RequestParser::method(void) const
+{
+	return mMethod;
+}
+
+Http::RequestParser::View Http::RequestParser::target(void) const
+{
+	return mTarget;
+}
+
+Http::RequestParser::View Http::RequestParser::path(void) const
+{
+	return mPath;
+}
+
+Http::RequestParser::View Http::RequestParser::query(void) const
+{
+	return mQuery;
+}
+
+Http::RequestParser::View Http::RequestParser::version(void) const
+{
+	return mVersion;
+}
+
+size_t Http::RequestParser::headersCount(void) const
+{
+	return mHeadersCount;
+}
+
+const Http::RequestParser::Header &Http::RequestParser::header(size_t i) const
+{
+	Assert(i < mHeadersCount);
+	return mHeaders[i];
+}
+
+bool Http::RequestParser::getHeader(const char *name, View &value) const
+{
+	for(size_t i = 0; i < mHeadersCount; ++i)
+	{
+		if(mHeaders[i].name.equalsNoCase(name))
+		{
+			value = mHeaders[i].value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Http::RequestParser::getParam(const char *name, String &value) const
+{
+	const char *p = mQuery.data;
+	const char *end = mQuery.data + mQuery.size;
+	while(p < end)
+	{
+		const char *next = FindChar(p, end, '&');
+		const char *equal = FindChar(p, next, '=');
+
+		// Names are only decoded if they are encoded
+		View key(p, equal - p);
+		bool encoded = FindEither(key.data, key.data + key.size, '%', '+') != key.data + key.size;
+		if(encoded ? key.urlDecode() == name : key.equals(name))
+		{
+			if(equal != next) value = View(equal + 1, next - equal - 1).urlDecode();
+			else value.clear();
+			return true;
+		}
+
+		p = next + 1;
+	}
+
+	return false;
+}
+
+bool Http::RequestParser::getCookie(const char *name, String &value) const
+{
+	for(size_t i = 0; i < mHeadersCount; ++i)
+	{
+		if(!mHeaders[i].name.equalsNoCase("Cookie")) continue;
+
+		const char *p = mHeaders[i].value.data;
+		const char *end = p + mHeaders[i].value.size;
+		while(p < end)
+		{
+			const char *next = FindChar(p, end, ';');
+			const char *equal = FindChar(p, next, '=');
+			const char *key = TrimFront(p, equal);
+			if(View(key, TrimBack(key, equal) - key).equals(name))
+			{
+				const char *v = (equal != next ? TrimFront(equal + 1, next) : next);
+				value = View(v, TrimBack(v, next) - v).toString();
+				return true;
+			}
+
+			p = next + 1;
+		}
+	}
+
+	return false;
+}
+
+void Http::RequestParser::getParams(StringMap &params) const
+{
+	const char *p = mQuery.data;
+	const char *end = mQuery.data + mQuery.size;
+	while(p < end)
+	{
+		const char *next = FindChar(p, end, '&');
+		const char *equal = FindChar(p, next, '=');
+		String value;
+		if(equal != next) value = View(equal + 1, next - equal - 1).urlDecode();
+		params.insert(View(p, equal - p).urlDecode(), value);
+		p = next + 1;
+	}
+}
+
+void Http::RequestParser::getCookies(StringMap &cookies) const
+{
+	for(size_t i = 0; i < mHeadersCount; ++i)
+	{
+		if(!mHeaders[i].name.equalsNoCase("Cookie")) continue;
+
+		const char *p = mHeaders[i].value.data;
+		const char *end = p + mHeaders[i].value.size;
+		while(p < end)
+		{
+			const char *next = FindChar(p, end, ';');
+			const char *equal = FindChar(p, next, '=');
+			const char *key = TrimFront(p, equal);
+			const char *v = (equal != next ? TrimFront(equal + 1, next) : next);
+			cookies.insert(View(key, TrimBack(key, equal) - key).toString(), View(v, TrimBack(v, next) - v).toString());
+			p = next + 1;
+		}
+	}
+}
 
 Http::Request::Request(void)
 {
@@ -69,6 +569,40 @@ Http::Request::Request(const String &url, const String &method)
 	this->headers["Accept-Charset"] = "utf-8";	// force UTF-8
 }
 
+// HTTP/2 field names are lowercase, HTTP/1 ones are capitalized by convention
+static String CanonicalName(const String &name)
+{
+	String result(name);
+	bool upper = true;
+	for(size_t i = 0; i < result.size(); ++i)
+	{
+		char &c = result[i];
+		if(upper && c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+		upper = (c == '-');
+	}
+
+	return result;
+}
+
+// Converts headers to HTTP/2 fields, connection-specific ones do not apply to streams
+static void AppendHttp2Fields(const StringMap &headers, Http2::headers_t &fields)
+{
+	for(StringMap::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		String name = it->first.toLower();
+		if(name == "connection" || name == "keep-alive" || name == "proxy-connection"
+			|| name == "transfer-encoding" || name == "upgrade" || name == "host")
+			continue;
+
+		List<String> lines;
+		String value(it->second);
+		value.remove('\r');
+		value.explode(lines, '\n');
+		for(List<String>::iterator l = lines.begin(); l != lines.end(); ++l)
+			fields.push_back(std::make_pair(name, *l));
+	}
+}
+
 void Http::Request::send(Stream *stream)
 {
 	Assert(stream);
@@ -110,6 +644,41 @@ void Http::Request::send(Stream *stream)
 		headers["Content-Type"] = "application/x-www-form-urlencoded";
 	}
 
+	Http2::Channel *channel = dynamic_cast<Http2::Channel*>(stream);
+	if(channel)
+	{
+		Http2::headers_t fields;
+		fields.push_back(std::make_pair(String(":method"), method));
+		fields.push_back(std::make_pair(String(":scheme"), protocol.empty() ? String("http") : protocol.toLower()));
+		if(headers.contains("Host")) fields.push_back(std::make_pair(String(":authority"), headers["Host"]));
+		fields.push_back(std::make_pair(String(":path"), completeUrl));
+		AppendHttp2Fields(headers, fields);
+
+		if(!cookies.empty())
+		{
+			String cookie;
+			for(StringMap::iterator it = cookies.begin(); it != cookies.end(); ++it)
+			{
+				if(it != cookies.begin()) cookie<<"; ";
+				cookie<<it->first<<'='<<it->second;
+			}
+
+			fields.push_back(std::make_pair(String("cookie"), cookie));
+		}
+
+		// The stream ends with the headers if there is no body to write
+		int64_t length = 0;
+		if(headers.contains("Content-Length")) headers["Content-Length"].extract(length);
+		channel->sendHeaders(fields, length == 0);
+
+		if(!postData.empty())
+		{
+			channel->write(postData);
+			channel->close();
+		}
+		return;
+	}
+
 	String buf;
 	buf<<method<<" "<<completeUrl<<" HTTP/"<<version<<"\r\n";
 
@@ -148,81 +717,340 @@ void Http::Request::send(Stream *stream)
 		*stream<<postData;
 }
 
-void Http::Request::recv(Stream *stream, bool parsePost)
+// Reads the request head into buffer, leaving the body in the stream
+static size_t ReadHead(Stream *stream, Http::RequestParser &parser, String &buffer)
 {
-	Assert(stream);
-	this->stream = stream;
+	Socket *sock = dynamic_cast<Socket*>(stream);
+	char tmp[BufferSize];
+	while(true)
+	{
+		size_t headSize;
+		if(sock)
+		{
+			// Peek and consume only the head, so the body and pipelined requests stay in the socket
+			size_t size = sock->peekData(tmp, BufferSize);
+			if(!size) throw NetException("Connection closed");
+
+			size_t offset = buffer.size();
+			buffer.append(tmp, size);
+			headSize = parser.parse(buffer.data(), buffer.size());
+			if(headSize)
+			{
+				size = headSize - offset;
+				buffer.resize(headSize);
+			}
 
-	clear();
+			AssertIO(sock->readBinary(tmp, size) == int64_t(size));
+		}
+		else {
+			// Generic streams are read byte by byte up to the end of the head
+			char chr;
+			if(!stream->readData(&chr, 1)) throw NetException("Connection closed");
+			buffer+= chr;
+			if(chr != '\n')
+			{
+				if(buffer.size() > Http::RequestParser::MaxHeadSize) throw 431;
+				continue;
+			}
 
-	// Read first line
-	String line;
-	if(!stream->readLine(line)) throw NetException("Connection closed");
-	method.clear();
-	url.clear();
-	line.readString(method);
-	line.readString(url);
+			headSize = parser.parse(buffer.data(), buffer.size());
+		}
 
-	String protocol;
-	line.readString(protocol);
-	version = protocol.cut('/');
+		if(headSize) return headSize;
+	}
+}
 
-	if(url.empty() || version.empty() || protocol != "HTTP")
+size_t Http::MultipartParser::BlockSize = 64*1024;
+
+Http::MultipartParser::MultipartParser(const String &boundary) :
+	mDelimiter("\r\n--" + boundary),
+	mMaxFieldSize(0),
+	mMaxFileSize(0)
+{
+	if(boundary.empty())
 		throw 400;
 
-	if(method != "GET" && method != "POST" && method != "HEAD")
-		throw 405;
+	// Horspool shifts by the distance from the last occurrence of the byte to the end
+	const size_t n = mDelimiter.size();
+	for(size_t c = 0; c < 256; ++c)
+		mSkip[c] = n;
+	for(size_t i = 0; i < n - 1; ++i)
+		mSkip[uint8_t(mDelimiter[i])] = n - 1 - i;
+}
+
+Http::MultipartParser::~MultipartParser(void)
+{
+
+}
+
+void Http::MultipartParser::setLimits(int64_t maxFieldSize, int64_t maxFileSize)
+{
+	mMaxFieldSize = maxFieldSize;
+	mMaxFileSize = maxFileSize;
+}
+
+int64_t Http::MultipartParser::parse(Stream *stream, int64_t length, handler_t handler)
+{
+	Assert(stream);
+
+	enum State { Preamble, Delimiter, Headers, Body, Epilogue };
+	State state = Preamble;
+
+	// The first delimiter has no leading line break, so one is prepended
+	String buffer;
+	buffer.resize(std::max(BlockSize, mDelimiter.size()*2));
+	char *data = &buffer[0];
+	std::memcpy(data, "\r\n", 2);
+	size_t begin = 0;
+	size_t end = 2;
+	int64_t total = 0;
+
+	Stream *output = NULL;
+	int64_t partSize = 0;
+	int64_t partLimit = 0;
 
-	// Read headers
 	while(true)
 	{
-		String line;
-		AssertIO(stream->readLine(line));
-		if(line.empty()) break;
+		bool more = false;
+		switch(state)
+		{
+		case Preamble:
+		case Body:
+		{
+			// Data that could be the start of a delimiter is kept for the next block
+			const char *p = find(data + begin, data + end);
+			size_t stop = (p ? size_t(p - data) : std::max(begin, end - std::min(end, mDelimiter.size() - 1)));
+			if(state == Body && stop > begin)
+			{
+				partSize+= stop - begin;
+				if(partLimit > 0 && partSize > partLimit) throw 413;
+				if(output) output->writeData(data + begin, stop - begin);
+			}
+
+			begin = stop;
+			if(p)
+			{
+				begin+= mDelimiter.size();
+				output = NULL;
+				state = Delimiter;
+			}
+			else more = true;
+			break;
+		}
+
+		case Delimiter:
+		{
+			// Transport padding might follow the boundary
+			while(begin < end && (data[begin] == ' ' || data[begin] == '\t')) ++begin;
+			if(end - begin < 2)
+			{
+				more = true;
+				break;
+			}
+
+			if(data[begin] == '-' && data[begin+1] == '-') state = Epilogue;
+			else if(data[begin] == '\r' && data[begin+1] == '\n') state = Headers;
+			else throw 400;
+			begin+= 2;
+			break;
+		}
+
+		case Headers:
+		{
+			// Headers end with an empty line
+			const char *line = data + begin;
+			const char *headersEnd = NULL;
+			while(true)
+			{
+				const char *nl = FindChar(line, data + end, '\n');
+				if(nl == data + end) break;
+				if(nl == line || (nl == line + 1 && *line == '\r'))
+				{
+					headersEnd = line;
+					line = nl + 1;
+					break;
+				}
+
+				line = nl + 1;
+			}
+
+			if(!headersEnd)
+			{
+				more = true;
+				break;
+			}
+
+			Part part;
+			parseHeaders(data + begin, headersEnd, part);
+			begin = line - data;
+
+			output = handler(part);
+			partSize = 0;
+			partLimit = (part.fileName.empty() ? mMaxFieldSize : mMaxFileSize);
+			state = Body;
+			break;
+		}
+
+		case Epilogue:
+			begin = end;
+			more = true;
+			break;
+		}
+
+		if(more)
+		{
+			if(total == length)
+			{
+				if(state == Epilogue) return total;
+				throw 400;	// missing final delimiter
+			}
+
+			// Move the remaining data to the front and read the next block
+			if(begin)
+			{
+				std::memmove(data, data + begin, end - begin);
+				end-= begin;
+				begin = 0;
+			}
+
+			if(end == buffer.size())
+				throw 400;	// part headers are too large
+
+			size_t size = size_t(std::min(int64_t(buffer.size() - end), length - total));
+			size_t len = stream->readData(data + end, size);
+			if(!len)
+			{
+				if(state == Epilogue) return total;	// end of a chunked body
+				throw NetException("Connection unexpectedly closed");
+			}
+
+			end+= len;
+			total+= len;
+		}
+	}
+}
+
+const char *Http::MultipartParser::find(const char *begin, const char *end) const
+{
+	const size_t n = mDelimiter.size();
+	const char *d = mDelimiter.data();
+	const char *p = begin;
+	while(size_t(end - p) >= n)
+	{
+		char last = p[n-1];
+		if(last == d[n-1] && std::memcmp(p, d, n-1) == 0)
+			return p;
+
+		p+= mSkip[uint8_t(last)];
+	}
+
+	return NULL;
+}
+
+void Http::MultipartParser::parseHeaders(const char *begin, const char *end, Part &part) const
+{
+	while(begin < end)
+	{
+		const char *nl = FindChar(begin, end, '\n');
+		String line(begin, TrimBack(begin, nl) - begin);
+		begin = (nl < end ? nl + 1 : end);
 
 		String value = line.cut(':');
 		line.trim();
 		value.trim();
-		headers.insert(line,value);
+		if(!line.empty()) part.headers.insert(line, value);
 	}
 
-	// Read cookies
-	String cookie;
-	if(headers.get("Cookie", cookie))
+	if(part.headers.get("Content-Type", part.contentType))
 	{
-		while(!cookie.empty())
-		{
-			String next = cookie.cut(';');
-			String value = cookie.cut('=');
-			cookie.trim();
-			value.trim();
-			cookies.insert(cookie,value);
-			cookie = next;
-		}
+		part.contentType.cut(';');
+		part.contentType.trim();
 	}
 
-	fullUrl = url;
+	String contentDisposition;
+	if(!part.headers.get("Content-Disposition", contentDisposition))
+		throw 400;
 
-	// Read URL variables
-	String getData = url.cut('?');
-	if(!getData.empty())
+	String parameters = contentDisposition.cut(';');
+	while(true)
 	{
-		List<String> exploded;
-		getData.explode(exploded,'&');
-		for(	List<String>::iterator it = exploded.begin();
-				it != exploded.end();
-				++it)
-		{
-			String value = it->cut('=').urlDecode();
-			get.insert(it->urlDecode(), value);
-		}
+		String key;
+		if(!parameters.readUntil(key,';')) break;
+		String value = key.cut('=');
+		key.trim();
+		value.trim();
+		value.trimQuotes();
+		if(key == "name") part.name = value;
+		else if(key == "filename") part.fileName = value;
+	}
+}
+
+void Http::Request::recv(Stream *stream, bool parsePost)
+{
+	Assert(stream);
+	this->stream = stream;	// set for the error response if the head is invalid
+
+	// Read and parse the head
+	RequestParser parser;
+	String head;
+	ReadHead(stream, parser, head);
+
+	recv(stream, parser, parsePost);
+}
+
+void Http::Request::recv(Stream *stream, const RequestParser &parser, bool parsePost)
+{
+	Assert(stream);
+	this->stream = stream;
+
+	clear();
+
+	method = parser.method().toString();
+	version = parser.version().toString();
+	fullUrl = parser.target().toString();
+	url = parser.path().urlDecode();
+
+	if(url.empty() || version.empty())
+		throw 400;
+
+	if(method != "GET" && method != "POST" && method != "HEAD")
+		throw 405;
+
+	for(size_t i = 0; i < parser.headersCount(); ++i)
+	{
+		const RequestParser::Header &header = parser.header(i);
+		headers.insert(header.name.toString(), header.value.toString());
+	}
+
+	parser.getCookies(cookies);
+	parser.getParams(get);
+
+	// HTTP/1.1 connections are persistent by default, HTTP/1.0 ones on demand
+	String connection;
+	headers.get("Connection", connection);
+	connection = connection.toLower();
+	if(version == "1.1") keepAlive = !connection.contains("close");
+	else keepAlive = connection.contains("keep-alive");
+
+	// The body is delimited by Content-Length or chunked transfer encoding
+	sptr<ChunkedStream> chunked;
+	String transferEncoding;
+	if(headers.get("Transfer-Encoding", transferEncoding))
+	{
+		transferEncoding = transferEncoding.toLower();
+		if(transferEncoding == "chunked") chunked = std::make_shared<ChunkedStream>(stream);
+		else if(transferEncoding != "identity") throw 501;
 	}
 
-	url = url.urlDecode();
+	Stream *body = (chunked ? chunked.get() : stream);
+
+	// With HTTP/2, the body ends with the stream and the client does not wait for 100 Continue
+	bool http2 = (version == "2");
+	bool delimited = (chunked || (http2 && !headers.contains("Content-Length")));
 
 	String expect;
-	if((headers.get("Expect",expect) && expect.toLower() == "100-continue")
-		|| (method == "POST" && version == "1.1"))
+	if(!http2 && ((headers.get("Expect",expect) && expect.toLower() == "100-continue")
+		|| (method == "POST" && version == "1.1")))
 	{
 		stream->write("HTTP/1.1 100 Continue\r\n\r\n");
 	}
@@ -230,11 +1058,12 @@ void Http::Request::recv(Stream *stream, bool parsePost)
 	// Read post variables
 	if(method == "POST" && parsePost)
 	{
-		if(!headers.contains("Content-Length"))
+		if(!delimited && !headers.contains("Content-Length"))
 			throw Exception("Missing Content-Length header in POST request");
 
-		size_t contentLength = 0;
-		headers["Content-Length"].extract(contentLength);
+		// With chunked encoding, the body is read up to its end
+		int64_t contentLength = std::numeric_limits<int64_t>::max();
+		if(!delimited) headers["Content-Length"].extract(contentLength);
 
 		String contentType;
 		if(headers.get("Content-Type", contentType))
@@ -245,7 +1074,7 @@ void Http::Request::recv(Stream *stream, bool parsePost)
 			if(contentType == "application/x-www-form-urlencoded")
 			{
 				String data;
-				if(stream->read(data, contentLength) != contentLength)
+				if(body->read(data, contentLength) != contentLength && !delimited)
 					throw NetException("Connection unexpectedly closed");
 
 				List<String> exploded;
@@ -269,158 +1098,83 @@ void Http::Request::recv(Stream *stream, bool parsePost)
 					key.trim();
 					value.trim();
 					value.trimQuotes();
-					if(key == "boundary") boundary = String("--") + value;
+					if(key == "boundary") boundary = value;
 				}
 
-				Assert(!boundary.empty());
+				MultipartParser parser(boundary);
+				parser.setLimits(MaxFieldSize, MaxFileSize);
 
-				String line;
-				while(line.empty()) AssertIO(stream->readLine(line));
-				Assert(line == boundary);
-
-				bool finished = false;
-				while(!finished)
+				auto start = std::chrono::steady_clock::now();
+				int64_t size = parser.parse(body, contentLength, [this](const MultipartParser::Part &part) -> Stream*
 				{
-					StringMap mimeHeaders;
-					while(true)
-					{
-						String line;
-						AssertIO(stream->readLine(line));
-						if(line.empty()) break;
-
-						String value = line.cut(':');
-						line.trim();
-						value.trim();
-						mimeHeaders.insert(line,value);
-					}
+					if(part.name.empty()) return NULL;
 
-					String contentType;
-					if(mimeHeaders.get("Content-Type", contentType))
+					if(part.fileName.empty())
 					{
-						String parameters = contentType.cut(';');
-						contentType.trim();
+						String &field = post[part.name];
+						field.clear();
+						return &field;
 					}
 
-					String contentDisposition;
-					if(!mimeHeaders.get("Content-Disposition", contentDisposition))
-						throw Exception("Missing Content-Disposition header in multipart POST request");
-
-					String parameters = contentDisposition.cut(';');
-					contentDisposition.trim();
-
-					String name, fileName;
-					while(true)
-					{
-						String key;
-			  			if(!parameters.readUntil(key,';')) break;
-						String value = key.cut('=');
-						key.trim();
-						value.trim();
-						value.trimQuotes();
-						if(key == "name") name = value;
-						else if(key == "filename") fileName = value;
-					}
+					LogDebug("Http::Request", String("File upload: ") + part.fileName);
+					post[part.name] = part.fileName;
 
-					Stream *output = NULL;
-					if(fileName.empty()) output = &post[name];
-					else {
-						post[name] = fileName;
-						TempFile *tempFile = new TempFile();
-						files[name] = tempFile;
-						output = tempFile;
-						LogDebug("Http::Request", String("File upload: ") + fileName);
-					}
+					TempFile *tempFile = new TempFile();
+					TempFile *previous = NULL;
+					if(files.get(part.name, previous)) delete previous;
+					files[part.name] = tempFile;
+					return tempFile;
+				});
 
-					String contentLength;
-					if(mimeHeaders.get("Content-Length", contentLength))
-					{
-						int64_t size = 0;
-						contentLength >> size;
-						stream->read(*output,size);
-
-						String line;
-						AssertIO(stream->readLine(line));
-						AssertIO(stream->readLine(line));
-						if(line == boundary + "--") finished = true;
-						else AssertIO(line == boundary);
-					}
-					else {
-					  	/*String line;
-						while(stream->readLine(line))
-						{
-							if(line == boundary) break;
-							output->write(line);
-							line.clear();
-						}*/
-
-						// TODO: This must be replaced with Boyer-Moore algorithm for performance
-						String bound = String("\r\n") + boundary;
-						char *buffer = new char[bound.size()];
-						try {
-							int size = 0;
-							int c = 0;
-							int i = 0;
-							while(true)
-							{
-								if(c == size)
-								{
-									c = 0;
-									size = stream->readData(buffer,bound.size()-i);
-									AssertIO(size);
-								}
-
-								if(buffer[c] == bound[i])
-								{
-									++i; ++c;
-									if(i == bound.size())
-									{
-										// If we are here there is no data left in buffer
-										String line;
-										AssertIO(stream->readLine(line));
-										if(line == "--") finished = true;
-										break;
-									}
-								}
-								else {
-									if(i) output->writeData(bound.data(), i);
-									int d = c;
-									while(c != size && buffer[c] != bound[0]) ++c;
-									if(c != d) output->writeData(buffer + d, c - d);
-									i = 0;
-								}
-							}
-						}
-						catch(...)
-						{
-							delete[] buffer;
-							throw;
-						}
-						delete[] buffer;
-					}
+				double elapsed = seconds(std::chrono::steady_clock::now() - start).count();
+				if(elapsed > 0.)
+				{
+					String rate;
+					rate << size << " bytes at " << int64_t(double(size)/elapsed/1024.) << " KiB/s";
+					LogDebug("Http::Request", String("Multipart body received: ") + rate);
 				}
 			}
 			else {
 				LogWarn("Http::Request", String("Unknown encoding: ") + contentType);
-				stream->ignore(contentLength);
+				body->ignore(contentLength);
 			}
 		}
 		else {
 			LogWarn("Http::Request", "Missing Content-Type header in POST request");
-			stream->ignore(contentLength);
+			body->ignore(contentLength);
 		}
 	}
+	else if(method != "POST" && !chunked && headers.contains("Content-Length"))
+	{
+		// Skip the unexpected body so the next request on the connection can be read
+		size_t contentLength = 0;
+		headers["Content-Length"].extract(contentLength);
+		stream->ignore(contentLength);
+	}
+
+	if(chunked && (method != "POST" || parsePost))
+	{
+		// Read up to the end of the body and merge trailers
+		chunked->discard();
+		headers.insertAll(chunked->trailers());
+	}
 }
 
 void Http::Request::clear(void)
 {
 	method = "GET";
-	version = "1.0";	// 1.1 requires chunked transfer encoding to be implemented
+	version = "1.1";
 	url.clear();
 	headers.clear();
 	cookies.clear();
 	get.clear();
 	post.clear();
+	params.clear();
 	fullUrl.clear();
+	server = NULL;
+	keepAlive = false;
+	persistent = false;
+	upgraded = false;
 
 	for(Map<String, TempFile*>::iterator it = files.begin(); it != files.end(); ++it)
 	 	delete it->second;
@@ -475,11 +1229,56 @@ bool Http::Request::extractRange(int64_t &rangeBegin, int64_t &rangeEnd, int64_t
 	return false;
 }
 
+String Http::Request::acceptedEncoding(void) const
+{
+	String accept;
+	if(!headers.get("Accept-Encoding", accept))
+		return "";
+
+	// Codings are weighted by quality values, gzip is preferred on a tie
+	double gzip = -1., deflate = -1., any = -1.;
+	List<String> codings;
+	accept.explode(codings, ',');
+	for(List<String>::iterator it = codings.begin(); it != codings.end(); ++it)
+	{
+		String name = *it;
+		String params = name.cut(';');
+		name.trim();
+		name = name.toLower();
+
+		double q = 1.;
+		params.trim();
+		if(params.substr(0, 2) == "q=")
+		{
+			try {
+				q = String(params.substr(2)).toDouble();
+			}
+			catch(...)
+			{
+				q = 0.;
+			}
+		}
+
+		if(name == "gzip" || name == "x-gzip") gzip = q;
+		else if(name == "deflate") deflate = q;
+		else if(name == "*") any = q;
+	}
+
+	if(gzip < 0.) gzip = any;
+	if(deflate < 0.) deflate = any;
+
+	if(gzip > 0. && gzip >= deflate) return "gzip";
+	if(deflate > 0.) return "deflate";
+	return "";
+}
+
 Http::Response::Response(int code)
 {
 	clear();
 
 	this->code = code;
+	this->stream = NULL;
+	this->request = NULL;
 	if(code != 204)	// 204 No content
 		this->headers["Content-Type"] = "text/html; charset=UTF-8";
 }
@@ -491,10 +1290,24 @@ Http::Response::Response(const Request &request, int code)
 	this->code = code;
 	this->version = request.version;
 	this->stream = request.stream;
+	this->request = &request;
 	if(code != 204)	// 204 No content
 		this->headers["Content-Type"] = "text/html; charset=UTF-8";
 }
 
+Http::Response::~Response(void)
+{
+	// Leave the body unterminated on error so it is not mistaken for a complete one
+	if(std::uncaught_exception())
+		return;
+
+	if(compressor && compressor.use_count() == 1)
+		NOEXCEPTION(compressor->close());
+
+	if(encoder && encoder.use_count() == 1)
+		NOEXCEPTION(encoder->close());
+}
+
 void Http::Response::send(void)
 {
 	if(!stream) throw Exception("No stream specified for HTTP response");
@@ -506,8 +1319,67 @@ void Http::Response::send(Stream *stream)
 	Assert(stream);
 	this->stream = stream;
 
-	if(version == "1.1" && code >= 200 && !headers.contains("Connexion"))
-		headers["Connection"] = "close";
+	Http2::Channel *channel = dynamic_cast<Http2::Channel*>(stream);
+	bool chunked = false;
+	bool bodyless = false;
+	String encoding;
+	if(code >= 200)
+	{
+		String contentType;
+		headers.get("Content-Type", contentType);
+		bool compressible = IsCompressible(contentType);
+
+		// Compressed bodies have an unknown length so it must be possible to chunk them, or to end the stream
+		if(compressible && code == 200 && request && (version == "1.1" || channel) && CompressionLevel > 0
+			&& !headers.contains("Content-Encoding") && !headers.contains("Transfer-Encoding"))
+		{
+			int64_t length = -1;
+			if(headers.contains("Content-Length")) headers["Content-Length"].extract(length);
+			if(length < 0 || length >= int64_t(CompressionMinSize))
+			{
+				encoding = request->acceptedEncoding();
+				if(!encoding.empty())
+				{
+					headers["Content-Encoding"] = encoding;
+					headers.erase("Content-Length");
+				}
+			}
+		}
+
+		if(compressible && !headers.contains("Vary"))
+			headers["Vary"] = "Accept-Encoding";
+
+		// Bodies of unknown length are chunked with HTTP/1.1
+		bodyless = (code == 204 || code == 304 || (request && request->method == "HEAD"));
+		if(version == "1.1" && !channel && !bodyless && !headers.contains("Content-Length") && !headers.contains("Transfer-Encoding"))
+		{
+			headers["Transfer-Encoding"] = "chunked";
+			chunked = true;
+		}
+	}
+
+	if(code >= 200 && !channel)
+	{
+		// The connection can only persist if the end of the response is known
+		String connection;
+		headers.get("Connection", connection);
+		bool persistent = request
+			&& request->keepAlive
+			&& connection.toLower() != "close"
+			&& (headers.contains("Content-Length") || chunked || bodyless);
+
+		if(persistent)
+		{
+			headers["Connection"] = "keep-alive";
+			headers["Keep-Alive"] = "timeout=";
+			headers["Keep-Alive"] << int64_t(seconds(KeepAliveTimeout).count());
+		}
+		else {
+			headers["Connection"] = "close";
+		}
+
+		if(request) request->persistent = persistent;
+	}
 
 	if(!headers.contains("Date"))
 		headers["Date"] = Time::Now().toHttpDate();
@@ -516,67 +1388,96 @@ void Http::Response::send(Stream *stream)
 		headers["Last-Modified"] = headers["Date"];
 
 	if(message.empty())
+		message = StatusMessage(code);
+
+	if(channel)
 	{
-		switch(code)
-		{
-		case 100: message = "Continue";				break;
-		case 200: message = "OK";					break;
-		case 204: message = "No content";			break;
-		case 206: message = "Partial Content";		break;
-		case 301: message = "Moved Permanently"; 	break;
-		case 302: message = "Found";				break;
-		case 303: message = "See Other";			break;
-		case 304: message = "Not Modified"; 		break;
-		case 305: message = "Use Proxy"; 			break;
-		case 307: message = "Temporary Redirect";	break;
-		case 400: message = "Bad Request"; 			break;
-		case 401: message = "Unauthorized";			break;
-		case 403: message = "Forbidden"; 			break;
-		case 404: message = "Not Found";			break;
-		case 405: message = "Method Not Allowed";	break;
-		case 406: message = "Not Acceptable";		break;
-		case 408: message = "Request Timeout";		break;
-		case 409: message = "Conflict";				break;
-		case 410: message = "Gone";					break;
-		case 413: message = "Request Entity Too Large"; 		break;
-		case 414: message = "Request-URI Too Long";				break;
-		case 416: message = "Requested Range Not Satisfiable";	break;
-		case 418: message = "I'm a teapot";						break;
-		case 500: message = "Internal Server Error";			break;
-		case 501: message = "Not Implemented";					break;
-		case 502: message = "Bad Gateway";						break;
-		case 503: message = "Service Unavailable";				break;
-		case 504: message = "Gateway Timeout";					break;
-		case 505: message = "HTTP Version Not Supported";		break;
-
-		default:
-			if(code < 300) message = "OK";
-			else message = "Error";
-			break;
-		}
-	}
+		Http2::headers_t fields;
+		fields.push_back(std::make_pair(String(":status"), String::number(code)));
+		AppendHttp2Fields(headers, fields);
+		for(StringMap::iterator it = cookies.begin(); it != cookies.end(); ++it)
+			fields.push_back(std::make_pair(String("set-cookie"), it->first + "=" + it->second + "; Path=/"));
 
-	String buf;
-	buf<<"HTTP/"<<version<<" "<<code<<" "<<message<<"\r\n";
+		channel->sendHeaders(fields, bodyless);
+	}
+	else {
+		String buf;
+		buf<<"HTTP/"<<version<<" "<<code<<" "<<message<<"\r\n";
 
-	for(StringMap::iterator it = headers.begin(); it != headers.end(); ++it)
-	{
-		List<String> lines;
-		it->second.remove('\r');
-		it->second.explode(lines,'\n');
-		for(	List<String>::iterator l = lines.begin();
-				l != lines.end();
-				++l)
+		for(StringMap::iterator it = headers.begin(); it != headers.end(); ++it)
 		{
-			buf<<it->first<<": "<<*l<<"\r\n";
+			List<String> lines;
+			it->second.remove('\r');
+			it->second.explode(lines,'\n');
+			for(	List<String>::iterator l = lines.begin();
+					l != lines.end();
+					++l)
+			{
+				buf<<it->first<<": "<<*l<<"\r\n";
+			}
 		}
+
+		for(StringMap::iterator it = cookies.begin(); it != cookies.end(); ++it)
+			buf<<"Set-Cookie: "<<it->first<<'='<<it->second<<"; Path=/\r\n";
+
+		buf<<"\r\n";
+		*stream<<buf;
 	}
 
-	for(StringMap::iterator it = cookies.begin(); it != cookies.end(); ++it)
-		buf<<"Set-Cookie: "<<it->first<<'='<<it->second<<"; Path=/\r\n";
+	if(chunked)
+	{
+		encoder = std::make_shared<ChunkedStream>(stream);
+		this->stream = encoder.get();
+	}
 
-	buf<<"\r\n";
-	*stream<<buf;
+	if(!encoding.empty() && request->method != "HEAD")
+	{
+		Deflate::Format format = (encoding == "gzip" ? Deflate::Gzip : Deflate::Zlib);
+		compressor = std::make_shared<Deflate>(this->stream, format, std::min(CompressionLevel, int(Z_BEST_COMPRESSION)));
+		this->stream = compressor.get();
+	}
+}
+
+String Http::Response::StatusMessage(int code)
+{
+	switch(code)
+	{
+	case 100: return "Continue";
+	case 101: return "Switching Protocols";
+	case 200: return "OK";
+	case 204: return "No content";
+	case 206: return "Partial Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 303: return "See Other";
+	case 304: return "Not Modified";
+	case 305: return "Use Proxy";
+	case 307: return "Temporary Redirect";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 406: return "Not Acceptable";
+	case 408: return "Request Timeout";
+	case 409: return "Conflict";
+	case 410: return "Gone";
+	case 413: return "Request Entity Too Large";
+	case 414: return "Request-URI Too Long";
+	case 416: return "Requested Range Not Satisfiable";
+	case 418: return "I'm a teapot";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 502: return "Bad Gateway";
+	case 503: return "Service Unavailable";
+	case 504: return "Gateway Timeout";
+	case 505: return "HTTP Version Not Supported";
+
+	default:
+		if(code < 300) return "OK";
+		else return "Error";
+	}
 }
 
 void Http::Response::recv(Stream *stream)
@@ -584,6 +1485,36 @@ void Http::Response::recv(Stream *stream)
 	this->stream = stream;
 	clear();
 
+	Http2::Channel *channel = dynamic_cast<Http2::Channel*>(stream);
+	if(channel)
+	{
+		// The stream ends with the body, so there is no transfer encoding
+		const Http2::headers_t &fields = channel->headers();
+		version = "2";
+		code = 0;
+		for(auto it = fields.begin(); it != fields.end(); ++it)
+		{
+			if(it->first == ":status") it->second.extract(code);
+			else if(it->first[0] == ':') continue;
+			else if(it->first == "set-cookie")
+			{
+				String cookie = it->second;
+				cookie.cut(';');
+				String value = cookie.cut('=');
+				cookies.insert(cookie, value);
+			}
+			else {
+				headers.insert(CanonicalName(it->first), it->second);
+			}
+		}
+
+		if(code < 100 || code > 999)
+			throw Exception("Invalid HTTP/2 response");
+
+		message = StatusMessage(code);
+		return;
+	}
+
 	// Read first line
 	String line;
 	if(!stream->readLine(line)) throw NetException("Connection closed");
@@ -620,234 +1551,2215 @@ void Http::Response::recv(Stream *stream)
 			headers.insert(line, value);
 		}
 	}
+
+	String transferEncoding;
+	if(headers.get("Transfer-Encoding", transferEncoding) && transferEncoding.toLower() == "chunked")
+	{
+		decoder = std::make_shared<ChunkedStream>(stream);
+		this->stream = decoder.get();
+	}
+}
+
+void Http::Response::clear(void)
+{
+	code = 200;
+	version = "1.0";
+	message.clear();
+	cookies.clear();
+}
+
+Http::FileCache::FileCache(size_t capacity, size_t maxFileSize) :
+	mCapacity(capacity),
+	mMaxFileSize(maxFileSize),
+	mSize(0)
+{
+
+}
+
+Http::FileCache::~FileCache(void)
+{
+
+}
+
+sptr<const Http::FileCache::Entry> Http::FileCache::get(const String &fileName)
+{
+	auto now = std::chrono::steady_clock::now();
+	sptr<const Entry> entry;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		auto it = mItems.find(fileName);
+		if(it != mItems.end())
+		{
+			mLru.splice(mLru.begin(), mLru, it->second.lru);
+			if(now - it->second.checked < RevalidationPeriod)
+				return it->second.entry;
+
+			entry = it->second.entry;
+		}
+	}
+
+	// The filesystem is accessed without holding the lock
+	if(entry)
+	{
+		try {
+			if(File::Exist(fileName) && File::Time(fileName) == entry->time && File::Size(fileName) == entry->size)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				auto it = mItems.find(fileName);
+				if(it != mItems.end() && it->second.entry == entry)
+					it->second.checked = now;
+
+				return entry;
+			}
+		}
+		catch(const std::exception &e)
+		{
+			// Reloading will fail too
+		}
+	}
+
+	entry = load(fileName);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	erase(fileName);
+	if(entry) insert(fileName, entry);
+	return entry;
+}
+
+sptr<const Http::FileCache::Entry> Http::FileCache::getVariant(const Entry &entry, const String &encoding)
+{
+	// Variants are keyed by content hash, so they never need revalidation
+	String key = entry.etag + ";" + encoding;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		auto it = mItems.find(key);
+		if(it != mItems.end())
+		{
+			mLru.splice(mLru.begin(), mLru, it->second.lru);
+			return it->second.entry;
+		}
+	}
+
+	auto variant = std::make_shared<Entry>(entry);
+	Deflate::Format format = (encoding == "gzip" ? Deflate::Gzip : Deflate::Zlib);
+	Deflate::Compress(entry.data.data(), entry.data.size(), variant->data, format, Z_BEST_COMPRESSION);
+	if(variant->data.size() >= entry.data.size())
+		return NULL;	// not worth it
+
+	String suffix = (encoding == "gzip" ? "-gz" : "-df");
+	variant->etag.insert(variant->etag.size() - 1, suffix);	// before the closing quote
+	variant->size = variant->data.size();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	erase(key);
+	insert(key, variant);
+	return variant;
+}
+
+void Http::FileCache::setCapacity(size_t capacity, size_t maxFileSize)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCapacity = capacity;
+	mMaxFileSize = maxFileSize;
+	evict();
+}
+
+void Http::FileCache::clear(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mItems.clear();
+	mLru.clear();
+	mSize = 0;
+}
+
+size_t Http::FileCache::size(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mSize;
+}
+
+sptr<const Http::FileCache::Entry> Http::FileCache::load(const String &fileName) const
+{
+	size_t maxFileSize;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		maxFileSize = std::min(mMaxFileSize, mCapacity);
+	}
+
+	try {
+		if(!File::Exist(fileName))
+			return NULL;
+
+		Time time = File::Time(fileName);
+		uint64_t size = File::Size(fileName);
+		if(size > maxFileSize)
+			return NULL;
+
+		auto entry = std::make_shared<Entry>();
+		entry->data.resize(size);
+
+		File file(fileName, File::Read);
+		if(file.readBinary(&entry->data[0], size) != int64_t(size))
+			return NULL;
+
+		file.close();
+
+		// The file must not have changed while it was read
+		if(!(File::Time(fileName) == time) || File::Size(fileName) != size)
+			return NULL;
+
+		BinaryString digest;
+		Sha256().compute(entry->data.data(), entry->data.size(), digest);
+		digest.resize(16);
+
+		entry->contentType = Mime::GetType(fileName.data(), fileName.size());
+		entry->lastModified = time.toHttpDate();
+		entry->etag = "\"" + digest.base64Encode(true) + "\"";
+		entry->time = time;
+		entry->size = size;
+		return entry;
+	}
+	catch(const std::exception &e)
+	{
+		// Directories and unreadable files are left to the caller
+		return NULL;
+	}
+}
+
+void Http::FileCache::insert(const String &fileName, sptr<const Entry> entry)
+{
+	mLru.push_front(fileName);
+
+	Item &item = mItems[fileName];
+	item.entry = entry;
+	item.checked = std::chrono::steady_clock::now();
+	item.lru = mLru.begin();
+
+	mSize+= entry->size;
+	evict();
+}
+
+void Http::FileCache::erase(const String &fileName)
+{
+	auto it = mItems.find(fileName);
+	if(it == mItems.end()) return;
+
+	mSize-= it->second.entry->size;
+	mLru.erase(it->second.lru);
+	mItems.erase(it);
+}
+
+void Http::FileCache::evict(void)
+{
+	// Least recently used files are evicted first
+	while(mSize > mCapacity && !mLru.empty())
+	{
+		String fileName = mLru.back();
+		erase(fileName);
+	}
+}
+
+Http::Router::Router(void)
+{
+
+}
+
+Http::Router::~Router(void)
+{
+
+}
+
+void Http::Router::add(const String &method, const String &pattern, handler_t handler)
+{
+	if(pattern.empty() || pattern[0] != '/')
+		throw Exception("Invalid route pattern: " + pattern);
+
+	String key = (method.empty() ? String("*") : method.toUpper());
+	sptr<Node> &root = mTrees[key];
+	if(!root) root = std::make_shared<Node>();
+
+	Insert(root.get(), pattern, handler);
+}
+
+bool Http::Router::route(Request &request) const
+{
+	values_t values;
+	const Node *node = find(request.method, request.url, values);
+	if(!node && request.method == "HEAD") node = find("GET", request.url, values);
+	if(!node) node = find("*", request.url, values);
+
+	if(!node)
+	{
+		// Tell apart an unknown path from a known one with another method
+		for(auto it = mTrees.begin(); it != mTrees.end(); ++it)
+		{
+			values.clear();
+			if(Match(it->second.get(), request.url.data(), request.url.data() + request.url.size(), values))
+				throw 405;
+		}
+
+		return false;
+	}
+
+	for(size_t i = 0; i < node->names.size() && i < values.size(); ++i)
+		request.params[node->names[i]] = String(values[i].first, values[i].first + values[i].second);
+
+	node->handler(request);
+	return true;
+}
+
+void Http::Router::clear(void)
+{
+	mTrees.clear();
+}
+
+void Http::Router::Insert(Node *node, const String &pattern, handler_t handler)
+{
+	std::vector<String> names;
+	const char *p = pattern.data();
+	const char *end = p + pattern.size();
+	while(p != end)
+	{
+		if(*p == ':' || *p == '*')
+		{
+			// Parameters span a whole segment, wildcards the rest of the path
+			if(*(p-1) != '/')
+				throw Exception("Route parameter must start a segment: " + pattern);
+
+			const char *q = (*p == ':' ? std::find(p, end, '/') : end);
+			if(*p == '*' && std::find(p, end, '/') != end)
+				throw Exception("Route wildcard must be last: " + pattern);
+
+			names.push_back(String(p + 1, q));
+			sptr<Node> &child = (*p == ':' ? node->param : node->wildcard);
+			if(!child) child = std::make_shared<Node>();
+			node = child.get();
+			p = q;
+			continue;
+		}
+
+		// Literal run up to the next parameter
+		const char *q = p;
+		while(q != end && !((*q == ':' || *q == '*') && *(q-1) == '/')) ++q;
+
+		size_t i = node->indices.find(*p);
+		if(i == String::npos)
+		{
+			auto child = std::make_shared<Node>();
+			child->prefix.assign(p, q);
+			node->indices+= *p;
+			node->children.push_back(child);
+			node = child.get();
+			p = q;
+			continue;
+		}
+
+		sptr<Node> &child = node->children[i];
+		size_t k = 0;
+		while(k < child->prefix.size() && p + k != q && child->prefix[k] == p[k]) ++k;
+
+		if(k < child->prefix.size())
+		{
+			// Split the edge at the common prefix
+			auto middle = std::make_shared<Node>();
+			middle->prefix = child->prefix.substr(0, k);
+			child->prefix = child->prefix.substr(k);
+			middle->indices+= child->prefix[0];
+			middle->children.push_back(child);
+			child = middle;
+		}
+
+		node = child.get();
+		p+= k;
+	}
+
+	if(node->handler)
+		throw Exception("Duplicate route: " + pattern);
+
+	node->handler = handler;
+	node->names = names;
+}
+
+const Http::Router::Node *Http::Router::Match(const Node *node, const char *path, const char *end, values_t &values)
+{
+	size_t size = node->prefix.size();
+	if(size)
+	{
+		if(size_t(end - path) < size || std::memcmp(path, node->prefix.data(), size) != 0)
+			return NULL;
+
+		path+= size;
+	}
+
+	if(path == end && node->handler)
+		return node;
+
+	if(path != end)
+	{
+		size_t i = node->indices.find(*path);
+		if(i != String::npos)
+		{
+			const Node *leaf = Match(node->children[i].get(), path, end, values);
+			if(leaf) return leaf;
+		}
+
+		if(node->param && *path != '/')
+		{
+			const char *next = static_cast<const char*>(std::memchr(path, '/', end - path));
+			if(!next) next = end;
+
+			values.push_back(std::make_pair(path, size_t(next - path)));
+			const Node *leaf = Match(node->param.get(), next, end, values);
+			if(leaf) return leaf;
+			values.pop_back();
+		}
+	}
+
+	if(node->wildcard && node->wildcard->handler)
+	{
+		values.push_back(std::make_pair(path, size_t(end - path)));
+		return node->wildcard.get();
+	}
+
+	return NULL;
+}
+
+const Http::Router::Node *Http::Router::find(const String &method, const String &path, values_t &values) const
+{
+	auto it = mTrees.find(method);
+	if(it == mTrees.end()) return NULL;
+
+	values.clear();
+	return Match(it->second.get(), path.data(), path.data() + path.size(), values);
+}
+
+static String FormatHttp2Head(const Http2::headers_t &fields)
+{
+	String method, path, authority, cookie, buf;
+	for(auto it = fields.begin(); it != fields.end(); ++it)
+	{
+		if(it->first == ":method") method = it->second;
+		else if(it->first == ":path") path = it->second;
+		else if(it->first == ":authority") authority = it->second;
+		else if(it->first[0] == ':') continue;
+		else if(it->first == "cookie")
+		{
+			// Cookies might be split into several fields
+			if(!cookie.empty()) cookie+= "; ";
+			cookie+= it->second;
+		}
+		else if(it->first == "host")
+		{
+			if(authority.empty()) authority = it->second;
+		}
+		else {
+			buf<<CanonicalName(it->first)<<": "<<it->second<<"\r\n";
+		}
+	}
+
+	String head;
+	head<<method<<" "<<path<<" HTTP/2\r\n";
+	if(!authority.empty()) head<<"Host: "<<authority<<"\r\n";
+	if(!cookie.empty()) head<<"Cookie: "<<cookie<<"\r\n";
+	head<<buf<<"\r\n";
+	return head;
+}
+
+// Connection is a stream over a socket served by the event loop: the loop thread does
+// non-blocking I/O into bounded buffers, and requests are processed on the pool,
+// one at a time and in order, reading and writing through the buffers.
+class Http::Server::Connection : public Stream, public std::enable_shared_from_this<Connection>
+{
+public:
+	static const size_t InputLimit = 64*1024;	// reading from the socket stops above
+	static const size_t OutputLimit = 256*1024;	// writers block above
+	static const size_t RecordSize = 16*1024;	// TLS writes
+	static const int LingerTimeout = 2;	// seconds to drain the input before closing
+
+	Connection(Server *server, Socket *sock);	// sock will be deleted
+	~Connection(void);
+
+	// Loop thread
+	void start(void);
+	void disconnect(void);
+	void checkTimeout(std::chrono::steady_clock::time_point now);
+
+	void upgrade(void);	// reads do not time out anymore
+
+	// Stream, from the worker processing the request
+	size_t readData(char *buffer, size_t size);
+	void writeData(const char *data, size_t size);
+	bool waitData(duration timeout);
+	void flush(void);
+
+private:
+	void onEvents(int events);
+	void handshake(void);	// submits a TLS handshake step, the socket is out of the loop until it completes
+	void handshaken(SecureTransport::Status status, std::exception_ptr error);
+	void update(void);	// dispatches complete requests and closes or watches the socket
+	void readSocket(void);
+	void writeSocket(void);
+	void attach(int events);	// adds the socket to the loop
+	void watch(int events);
+	void dispatch(size_t headSize);	// headSize is 0 if the head is invalid
+	void process(const String &head, int count, std::chrono::steady_clock::time_point queued);	// worker
+	void post(void);	// schedules update(), mMutex must be locked
+	size_t inputLimit(void) const;
+
+	// HTTP/2, the session replaces the parser and streams are processed concurrently
+	void startSession(void);
+	void exchange(void);	// passes input to the session and pulls its frames
+	void dispatch(sptr<Http2::Channel> channel);
+	void process(sptr<Http2::Channel> channel, int count, std::chrono::steady_clock::time_point queued);	// worker
+
+	Server *mServer;
+	Socket *mSock;
+	SecureTransport *mTransport;	// owns mSock if set
+	Address mRemote;
+	RequestParser mParser;
+	sptr<Http2::Session> mSession;
+	int mEvents;
+	int mRequests;
+	bool mHandshakeDone;
+	bool mHandshaking;	// a step is running outside the loop thread and uses the transport
+	size_t mPendingWrite;	// TLS write to retry with the same size
+
+	ByteQueue mInput, mOutput;
+	bool mInputClosed, mReadPaused;
+	bool mProcessing, mClosing, mClosed, mUpdatePosted;
+	bool mLingering;	// the write side is shut down and the input is discarded
+	bool mUpgraded;
+	std::chrono::steady_clock::time_point mDeadline;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+};
+
+const size_t Http::Server::Connection::InputLimit;
+const size_t Http::Server::Connection::OutputLimit;
+const size_t Http::Server::Connection::RecordSize;
+const int Http::Server::Connection::LingerTimeout;
+
+Http::Server::Server(int port, int threads) :
+	mSock(port),
+	mPool(threads),
+	mCredentials(NULL),
+	mRateLimit(0.),
+	mRateBurst(0.),
+	mConcurrencyLimit(0),
+	mActiveRequests(0),
+	mMaxQueueTime(0.),
+	mUpgradeLimit(int(threads) - 1),	// a thread is left for other requests
+	mUpgraded(0),
+	mHandshakeSteps(0)
+{
+	start();
+}
+
+Http::Server::Server(int port, int threads, SecureTransportServer::Credentials *credentials) :
+	mSock(port),
+	mPool(threads),
+	mCredentials(credentials),
+	mRateLimit(0.),
+	mRateBurst(0.),
+	mConcurrencyLimit(0),
+	mActiveRequests(0),
+	mMaxQueueTime(0.),
+	mUpgradeLimit(int(threads) - 1),	// a thread is left for other requests
+	mUpgraded(0),
+	mHandshakeSteps(0)
+{
+	start();
+}
+
+Http::Server::~Server(void)
+{
+	if(mLoop)
+	{
+		mLoop->join();
+		mSock.close();
+
+		// Workers blocked on a connection are woken up by disconnect()
+		std::map<Connection*, sptr<Connection> > connections(mConnections);
+		for(auto it = connections.begin(); it != connections.end(); ++it)
+			it->second->disconnect();
+
+		mPool.join();
+		mConnections.clear();
+	}
+	else {
+		mSock.close();
+		mPool.join();
+	}
+
+	// Steps on the handshake executor run outside the pool
+	{
+		std::unique_lock<std::mutex> lock(mHandshakeMutex);
+		mHandshakeCondition.wait(lock, [this]() {
+			return mHandshakeSteps == 0;
+		});
+	}
+
+	delete mCredentials;
+}
+
+void Http::Server::generate(Stream &out, int code, const String &message)
+{
+	out<<"<!DOCTYPE html>\n";
+	out<<"<html>\n";
+	out<<"<head><title>"<<message<<"</title></head>\n";
+	out<<"<body><h1>"<<code<<" "<<message<<"</h1></body>\n";
+	out<<"</html>\n";
+}
+
+const Http::Server::ConnectionStats &Http::Server::connectionStats(void) const
+{
+	return mConnectionStats;
+}
+
+void Http::Server::recordStats(const Socket &sock)
+{
+	try {
+		Socket::Stats stats = sock.stats();
+		mConnectionStats.rtt.add(milliseconds(stats.rtt).count());
+		mConnectionStats.rttVar.add(milliseconds(stats.rttVar).count());
+		mConnectionStats.congestionWindow.add(double(stats.congestionWindow));
+		mConnectionStats.retransmits.add(double(stats.retransmits));
+		mConnectionStats.bytesInFlight.add(double(stats.bytesInFlight));
+		if(stats.deliveryRate) mConnectionStats.deliveryRate.add(double(stats.deliveryRate));
+	}
+	catch(const std::exception &e)
+	{
+		// Statistics are not available on this platform or socket
+	}
+}
+
+void Http::Server::handle(Stream *stream, const Address &remote)
+{
+	handleRequests(stream, remote);
+
+	Socket *sock = dynamic_cast<Socket*>(stream);
+	if(sock) recordStats(*sock);
+
+	delete stream;
+}
+
+void Http::Server::handleRequests(Stream *stream, const Address &remote)
+{
+	// Requests are read in sequence, so pipelined requests are answered in order
+	for(int count = 1; handleRequest(stream, remote, count); ++count)
+	{
+		// Wait for the next request, pipelined ones are already available
+		try {
+			if(!stream->waitData(KeepAliveTimeout))
+				break;
+		}
+		catch(const std::exception &e)
+		{
+			break;
+		}
+	}
+}
+
+bool Http::Server::handleRequest(Stream *stream, const Address &remote, int count, const RequestParser *head, std::chrono::steady_clock::time_point queued)
+{
+	Request request;
+	request.stream = stream;	// for the error response if the head is invalid
+	bool received = false;
+	bool admitted = false;
+	bool failed = false;
+	int retryAfter = 0;
+	try {
+		try {
+			RequestParser parser;
+			String buffer;
+			if(!head)
+			{
+				ReadHead(stream, parser, buffer);
+				head = &parser;
+			}
+
+			// Admission is decided on the head alone, so shed requests cost no more than their head
+			retryAfter = admit(remote, queued);
+			if(retryAfter)
+			{
+				request.method = head->method().toString();
+				request.version = head->version().toString();
+				throw 503;
+			}
+
+			admitted = true;
+			request.recv(stream, *head);
+			request.remoteAddress = remote;
+			request.server = this;
+			received = true;
+
+			if(KeepAliveMaxRequests > 0 && count >= KeepAliveMaxRequests)
+				request.keepAlive = false;
+
+			process(request);
+		}
+		catch(const Timeout &e)
+		{
+			request.keepAlive = false;
+			throw 408;
+		}
+		catch(const NetException &e)
+		{
+			LogDebug("Http::Server::Handler", e.what());
+			failed = true;
+		}
+		catch(const std::exception &e)
+		{
+			LogWarn("Http::Server::Handler", e.what());
+			request.keepAlive = false;	// the response might be incomplete
+			throw 500;
+		}
+	}
+	catch(int code)
+	{
+		if(!received) request.keepAlive = false;
+
+		try {
+			String body;
+			if(request.method != "HEAD")
+				generate(body, code, Response::StatusMessage(code));
+
+			Response response(request, code);
+			response.headers["Content-Type"] = "text/html; charset=UTF-8";
+			response.headers["Content-Length"] << body.size();
+			if(retryAfter) response.headers["Retry-After"] << retryAfter;
+			response.send();
+			*response.stream << body;
+		}
+		catch(...)
+		{
+			failed = true;
+		}
+	}
+
+	if(admitted) release();
+
+	if(request.upgraded)
+	{
+		std::unique_lock<std::mutex> lock(mAdmissionMutex);
+		--mUpgraded;
+	}
+
+	return !failed && request.persistent;
+}
+
+void Http::Server::respondWithFile(const Request &request, const String &fileName)
+{
+	String path = fileName;	// file sent, a precompressed sidecar if too large for the cache
+	String pathEncoding;
+
+	if(request.method == "GET" || request.method == "HEAD")
+	{
+		// Ranges apply to the identity content only
+		String encoding;
+		if(!request.headers.contains("Range"))
+			encoding = request.acceptedEncoding();
+
+		sptr<const FileCache::Entry> entry = mFileCache.get(fileName);
+
+		// A precompressed sidecar file is served as is, unless the source file is newer
+		if(encoding == "gzip")
+		{
+			String sidecarName = fileName + ".gz";
+			sptr<const FileCache::Entry> sidecar = mFileCache.get(sidecarName);
+			if(sidecar || File::Exist(sidecarName))
+			{
+				Time sidecarTime = (sidecar ? sidecar->time : File::Time(sidecarName));
+				if((!entry && !File::Exist(fileName)) || sidecarTime >= (entry ? entry->time : File::Time(fileName)))
+				{
+					if(!sidecar)
+					{
+						path = sidecarName;
+						pathEncoding = encoding;
+					}
+					else if(respondWithEntry(request, fileName, *sidecar, encoding))
+						return;
+				}
+			}
+		}
+
+		if(entry && pathEncoding.empty())
+		{
+			if(!encoding.empty() && CompressionLevel > 0
+				&& entry->size >= CompressionMinSize
+				&& IsCompressible(entry->contentType))
+			{
+				sptr<const FileCache::Entry> variant = mFileCache.getVariant(*entry, encoding);
+				if(variant && respondWithEntry(request, fileName, *variant, encoding))
+					return;
+			}
+
+			if(respondWithEntry(request, fileName, *entry))
+				return;
+		}
+	}
+
+	int code = 200;
+	File file;
+
+	if(!File::Exist(path)) code = 404;
+	else {
+		if(request.method != "GET" && request.method != "HEAD") code = 405;
+		else {
+			String ifModifiedSince;
+			if(request.headers.get("If-Modified-Since", ifModifiedSince))
+			{
+				try {
+					Time time(ifModifiedSince);
+					if(time >= File::Time(path))
+					{
+						Response response(request, 304);
+						response.send();
+						return;
+					}
+				}
+				catch(const Exception &e)
+				{
+					LogWarn("Http::respondWithFile", e.what());
+				}
+			}
+
+			try {
+				file.open(path, File::Read);
+			}
+			catch(...)
+			{
+				code = 403;
+			}
+		}
+	}
+
+	int64_t rangeBegin = 0;
+	int64_t rangeEnd = 0;
+	bool hasRange = request.extractRange(rangeBegin, rangeEnd, file.size());
+	if(rangeBegin >= file.size() || rangeEnd >= file.size())
+		code = 406;
+
+	if(code != 200)
+	{
+		String body;
+		if(request.method != "HEAD")
+			generate(body, code, Response::StatusMessage(code));
+
+		Response response(request, code);
+		response.headers["Content-Type"] = "text/html; charset=UTF-8";
+		response.headers["Content-Length"] << body.size();
+		response.send();
+		*response.stream << body;
+		return;
+	}
+
+	if(hasRange) code = 206;
+	Response response(request, code);
+
+	String name = fileName.afterLast(Directory::Separator);
+	if(name != request.url.afterLast('/'))
+	{
+		response.headers["Content-Name"] = name;
+		response.headers["Content-Disposition"] = "inline; filename=\"" + name + "\"";
+	}
+
+	if(hasRange)
+	{
+		response.headers["Content-Length"] << (rangeEnd - rangeBegin + 1);
+		response.headers["Content-Range"] << "bytes " << rangeBegin << "-" << rangeEnd << "/" << file.size();
+	}
+	else {
+		response.headers["Content-Length"] << file.size();
+	}
+
+	response.headers["Accept-Ranges"] = "bytes";
+	response.headers["Content-Type"] = Mime::GetType(fileName.data(), fileName.size());
+	response.headers["Last-Modified"] = File::Time(path).toHttpDate();
+
+	if(!pathEncoding.empty())
+	{
+		response.headers["Content-Encoding"] = pathEncoding;
+		response.headers["Vary"] = "Accept-Encoding";
+	}
+
+	response.send();
+
+	if(request.method != "HEAD")
+	{
+		if(hasRange)
+		{
+			file.seekRead(rangeBegin);
+			file.read(*response.stream, rangeEnd - rangeBegin + 1);
+		}
+		else {
+			file.read(*response.stream);
+		}
+		file.close();
+	}
+}
+
+bool Http::Server::respondWithEntry(const Request &request, const String &fileName, const FileCache::Entry &entry, const String &encoding)
+{
+	// Conditional requests are answered without touching the filesystem
+	bool notModified = false;
+	String ifNoneMatch, ifModifiedSince;
+	if(request.headers.get("If-None-Match", ifNoneMatch))
+	{
+		List<String> tags;
+		ifNoneMatch.explode(tags, ',');
+		for(List<String>::iterator it = tags.begin(); it != tags.end(); ++it)
+		{
+			String tag = it->trimmed();
+			if(tag.substr(0, 2) == "W/") tag = tag.substr(2);	// weak comparison
+			if(tag == "*" || tag == entry.etag)
+			{
+				notModified = true;
+				break;
+			}
+		}
+	}
+	else if(request.headers.get("If-Modified-Since", ifModifiedSince))
+	{
+		try {
+			notModified = (ifModifiedSince == entry.lastModified || Time(ifModifiedSince) >= entry.time);
+		}
+		catch(const Exception &e)
+		{
+			LogWarn("Http::respondWithFile", e.what());
+		}
+	}
+
+	// Compressed variants keep the content type, but sidecar files have the one of the compression format
+	String contentType = entry.contentType;
+	if(!encoding.empty() && !IsCompressible(contentType))
+		contentType = Mime::GetType(fileName.data(), fileName.size());
+
+	if(notModified)
+	{
+		Response response(request, 304);
+		response.headers["ETag"] = entry.etag;
+		response.headers["Last-Modified"] = entry.lastModified;
+		if(!encoding.empty()) response.headers["Vary"] = "Accept-Encoding";
+		response.send();
+		return true;
+	}
+
+	int64_t rangeBegin = 0;
+	int64_t rangeEnd = 0;
+	int64_t size = int64_t(entry.size);
+	bool hasRange = request.extractRange(rangeBegin, rangeEnd, size);
+	if(rangeBegin >= size || rangeEnd >= size)
+		return false;	// the uncached path responds with the error
+
+	Response response(request, hasRange ? 206 : 200);
+
+	String name = fileName.afterLast(Directory::Separator);
+	if(name != request.url.afterLast('/'))
+	{
+		response.headers["Content-Name"] = name;
+		response.headers["Content-Disposition"] = "inline; filename=\"" + name + "\"";
+	}
+
+	if(hasRange)
+	{
+		response.headers["Content-Length"] << (rangeEnd - rangeBegin + 1);
+		response.headers["Content-Range"] << "bytes " << rangeBegin << "-" << rangeEnd << "/" << size;
+	}
+	else {
+		response.headers["Content-Length"] << size;
+	}
+
+	response.headers["Accept-Ranges"] = "bytes";
+	response.headers["Content-Type"] = contentType;
+	response.headers["Last-Modified"] = entry.lastModified;
+	response.headers["ETag"] = entry.etag;
+
+	if(!encoding.empty())
+	{
+		response.headers["Content-Encoding"] = encoding;
+		response.headers["Vary"] = "Accept-Encoding";
+	}
+
+	response.send();
+
+	if(request.method != "HEAD" && size > 0)
+	{
+		if(!hasRange) rangeEnd = size - 1;
+		response.stream->writeData(entry.data.data() + rangeBegin, size_t(rangeEnd - rangeBegin + 1));
+	}
+
+	return true;
+}
+
+void Http::Server::run(void)
+{
+	Socket *sock = NULL;
+	try {
+		while(true)
+		{
+			sock = new Socket;
+			mSock.accept(*sock);
+			sock->setReadTimeout(RequestTimeout);
+			sock->setNoDelay(true);	// responses on persistent connections must not wait for delayed acks
+
+			mPool.enqueue([this, sock]()
+			{
+				this->handle(sock, sock->getRemoteAddress());	// sock is deleted
+			});
+
+			sock = NULL;
+		}
+	}
+	catch(const NetException &e)
+	{
+		delete sock;
+		return;
+	}
+	catch(...)
+	{
+		delete sock;
+		throw;
+	}
+}
+
+void Http::Server::setRateLimit(double rate, double burst)
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	mRateLimit = std::max(rate, 0.);
+	mRateBurst = std::max(burst, std::max(rate, 1.));	// at least one second worth of requests
+	mBuckets.clear();
+}
+
+void Http::Server::setConcurrencyLimit(int limit)
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	mConcurrencyLimit = std::max(limit, 0);
+}
+
+void Http::Server::setMaxQueueTime(duration timeout)
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	mMaxQueueTime = std::max(timeout, duration::zero());
+}
+
+Http::Server::AdmissionStats Http::Server::admissionStats(void) const
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	return mAdmissionStats;
+}
+
+void Http::Server::setUpgradeLimit(int limit)
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	mUpgradeLimit = std::max(limit, -1);
+}
+
+bool Http::Server::upgrade(Request &request)
+{
+	if(request.upgraded) return true;
+
+	{
+		std::unique_lock<std::mutex> lock(mAdmissionMutex);
+		if(mUpgradeLimit >= 0 && mUpgraded >= mUpgradeLimit) return false;
+		++mUpgraded;
+	}
+
+	request.upgraded = true;	// released when process() returns
+
+	// Reads wait for as long as the connection lasts
+	Connection *connection = dynamic_cast<Connection*>(request.stream);
+	if(connection)
+	{
+		connection->upgrade();
+		return true;
+	}
+
+	SecureTransport *transport = dynamic_cast<SecureTransport*>(request.stream);
+	Socket *sock = (transport ? transport->socket() : dynamic_cast<Socket*>(request.stream));
+	if(sock) sock->setReadTimeout(seconds(-1.));
+	return true;
+}
+
+int Http::Server::admit(const Address &remote, std::chrono::steady_clock::time_point queued)
+{
+	auto now = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+
+	// The client has probably given up on a request that waited that long
+	if(mMaxQueueTime > duration::zero() && queued != std::chrono::steady_clock::time_point() && now - queued > mMaxQueueTime)
+	{
+		++mAdmissionStats.expired;
+		return 1;
+	}
+
+	if(mConcurrencyLimit > 0 && mActiveRequests >= mConcurrencyLimit)
+	{
+		++mAdmissionStats.overloaded;
+		return 1;
+	}
+
+	if(mRateLimit > 0.)
+	{
+		// Forget buckets which are full again
+		if(now - mBucketsSweep >= seconds(1.))
+		{
+			mBucketsSweep = now;
+			for(auto it = mBuckets.begin(); it != mBuckets.end(); )
+			{
+				double elapsed = std::chrono::duration_cast<seconds>(now - it->second.last).count();
+				if(it->second.tokens + elapsed*mRateLimit >= mRateBurst) it = mBuckets.erase(it);
+				else ++it;
+			}
+		}
+
+		String host = remote.host();
+		auto it = mBuckets.find(host);
+		if(it == mBuckets.end())
+		{
+			Bucket bucket;
+			bucket.tokens = mRateBurst;
+			bucket.last = now;
+			it = mBuckets.insert(std::make_pair(host, bucket)).first;
+		}
+
+		Bucket &bucket = it->second;
+		double elapsed = std::chrono::duration_cast<seconds>(now - bucket.last).count();
+		bucket.tokens = std::min(bucket.tokens + elapsed*mRateLimit, mRateBurst);
+		bucket.last = now;
+
+		if(bucket.tokens < 1.)
+		{
+			++mAdmissionStats.rateLimited;
+			return std::max(int(std::ceil((1. - bucket.tokens)/mRateLimit)), 1);
+		}
+
+		bucket.tokens-= 1.;
+	}
+
+	++mActiveRequests;
+	++mAdmissionStats.admitted;
+	return 0;
+}
+
+void Http::Server::release(void)
+{
+	std::unique_lock<std::mutex> lock(mAdmissionMutex);
+	--mActiveRequests;
+}
+
+void Http::Server::start(void)
+{
+	try {
+		mLoop = std::make_shared<EventLoop>();
+	}
+	catch(const Unsupported &e)
+	{
+		// Fall back to a thread per connection
+		mPool.enqueue([this]()
+		{
+			this->run();
+		});
+		return;
+	}
+
+	mLoop->add(&mSock, [this](int events)
+	{
+		this->accept();
+	});
+
+	mLoop->schedule(seconds(1.), [this]()
+	{
+		this->sweep();
+	});
+}
+
+void Http::Server::accept(void)
+{
+	Socket *sock = new Socket;
+	try {
+		mSock.accept(*sock);
+		sock->setNoDelay(true);	// responses on persistent connections must not wait for delayed acks
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http::Server::accept", e.what());
+		delete sock;
+		return;
+	}
+
+	sptr<Connection> connection;
+	try {
+		connection = std::make_shared<Connection>(this, sock);	// sock is now owned by connection
+	}
+	catch(const std::exception &e)
+	{
+		LogWarn("Http::Server::accept", e.what());
+		return;
+	}
+
+	mConnections[connection.get()] = connection;
+	connection->start();
+}
+
+void Http::Server::sweep(void)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	// Connections remove themselves from the map when closed
+	std::map<Connection*, sptr<Connection> > connections(mConnections);
+	for(auto it = connections.begin(); it != connections.end(); ++it)
+		it->second->checkTimeout(now);
+
+	mLoop->schedule(seconds(1.), [this]()
+	{
+		this->sweep();
+	});
+}
+
+Http::Server::Connection::Connection(Server *server, Socket *sock) :
+	mServer(server),
+	mSock(sock),
+	mTransport(NULL),
+	mEvents(0),
+	mRequests(0),
+	mHandshakeDone(false),
+	mHandshaking(false),
+	mPendingWrite(0),
+	mInputClosed(false),
+	mReadPaused(false),
+	mProcessing(false),
+	mClosing(false),
+	mClosed(false),
+	mUpdatePosted(false),
+	mLingering(false),
+	mUpgraded(false)
+{
+	Assert(mServer);
+	Assert(mSock);
+
+	try {
+		mRemote = mSock->getRemoteAddress();
+
+		if(mServer->mCredentials)
+		{
+			mTransport = new SecureTransportServer(mSock);	// mSock is now owned by mTransport
+			mTransport->addCredentials(mServer->mCredentials);
+			mTransport->setBlocking(false);
+
+			if(EnableHttp2)
+			{
+				List<String> protocols;
+				protocols.push_back("h2");
+				protocols.push_back("http/1.1");
+				mTransport->setProtocols(protocols);
+			}
+		}
+	}
+	catch(...)
+	{
+		if(mTransport) delete mTransport;
+		else delete mSock;
+		throw;
+	}
+
+	mDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(RequestTimeout);
+}
+
+Http::Server::Connection::~Connection(void)
+{
+	if(mTransport) delete mTransport;
+	else delete mSock;
+}
+
+void Http::Server::Connection::start(void)
+{
+	attach(EventLoop::Readable);
+}
+
+void Http::Server::Connection::disconnect(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mClosed) return;
+		mClosed = true;
+		mInputClosed = true;
+		mCondition.notify_all();
+	}
+
+	// Workers blocked on streams are woken up
+	if(mSession) mSession->close();
+
+	mServer->mLoop->remove(mSock);
+	mServer->recordStats(*mSock);
+
+	if(mTransport)
+	{
+		// A running handshake step still uses the transport, it is deleted with the connection
+		if(!mHandshaking)
+		{
+			NOEXCEPTION(mTransport->tryClose());
+			delete mTransport;
+			mTransport = NULL;
+		}
+	}
+	else {
+		NOEXCEPTION(mSock->close());
+		delete mSock;
+	}
+
+	mSock = NULL;
+	mServer->mConnections.erase(this);	// the caller holds a reference
+}
+
+void Http::Server::Connection::checkTimeout(std::chrono::steady_clock::time_point now)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mClosed || mProcessing || now < mDeadline) return;
+	}
+
+	if(mSession && !mSession->isIdle()) return;	// streams have their own timeouts
+
+	LogDebug("Http::Server::Connection", "Connection timed out");
+	disconnect();
+}
+
+void Http::Server::Connection::upgrade(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mUpgraded = true;
+}
+
+size_t Http::Server::Connection::readData(char *buffer, size_t size)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mInput.empty() && !mOutput.empty())
+		post();	// the client might wait for the output before sending more
+
+	auto ready = [this]()
+	{
+		return !mInput.empty() || mInputClosed;
+	};
+
+	// disconnect() closes the input, so an upgraded connection can wait without timeout
+	if(mUpgraded) mCondition.wait(lock, ready);
+	else if(!mCondition.wait_for(lock, RequestTimeout, ready))
+		throw Timeout();
+
+	size = mInput.readData(buffer, size);
+	if(!size) return 0;
+
+	if(mReadPaused && mInput.size() < inputLimit()) post();
+	return size;
+}
+
+void Http::Server::Connection::writeData(const char *data, size_t size)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(!mCondition.wait_for(lock, RequestTimeout, [this]()
+	{
+		return mClosed || mOutput.size() < OutputLimit;
+	}))
+		throw Timeout();
+
+	if(mClosed) throw NetException("Connection closed");
+
+	// Output is sent once the loop runs the update, writes made in the meantime are sent with it
+	mOutput.append(data, size);
+	post();
+}
+
+void Http::Server::Connection::flush(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(!mOutput.empty()) post();
+}
+
+bool Http::Server::Connection::waitData(duration timeout)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mInput.empty() && !mOutput.empty())
+		post();
+	mCondition.wait_for(lock, timeout, [this]()
+	{
+		return !mInput.empty() || mInputClosed;
+	});
+
+	return !mInput.empty();
+}
+
+void Http::Server::Connection::onEvents(int events)
+{
+	try {
+		if(mTransport && !mHandshakeDone)
+		{
+			handshake();
+			return;
+		}
+
+		if(events & EventLoop::Writable) writeSocket();
+		if(events & EventLoop::Readable) readSocket();
+		update();
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http::Server::Connection", e.what());
+		disconnect();
+	}
+}
+
+void Http::Server::Connection::handshake(void)
+{
+	if(mHandshaking) return;
+	mHandshaking = true;
+
+	// Asymmetric crypto must not stall the loop, so steps run on the handshake executor,
+	// or on the pool if there is none. The socket is removed from the loop meanwhile,
+	// as hangups and errors would still be reported, and added again once they complete.
+	mServer->mLoop->remove(mSock);
+	sptr<Connection> self = shared_from_this();
+	sptr<EventLoop> loop = mServer->mLoop;
+	Server *server = mServer;
+	auto done = [self, loop, server](SecureTransport::Status status, std::exception_ptr error)
+	{
+		loop->post([self, status, error]()
+		{
+			self->handshaken(status, error);
+		});
+
+		std::unique_lock<std::mutex> lock(server->mHandshakeMutex);
+		if(--server->mHandshakeSteps == 0)
+			server->mHandshakeCondition.notify_all();
+	};
+
+	{
+		std::unique_lock<std::mutex> lock(mServer->mHandshakeMutex);
+		++mServer->mHandshakeSteps;
+	}
+
+	try {
+		sptr<SecureTransport::HandshakeExecutor> executor = SecureTransport::GetHandshakeExecutor();
+		if(executor) executor->submit(mTransport, done);
+		else mServer->mPool.enqueue([self, done]()
+		{
+			SecureTransport::Status status = SecureTransport::Closed;
+			std::exception_ptr error;
+			try {
+				status = self->mTransport->tryHandshake();
+			}
+			catch(...)
+			{
+				error = std::current_exception();
+			}
+
+			done(status, error);
+		});
+	}
+	catch(...)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mServer->mHandshakeMutex);
+			--mServer->mHandshakeSteps;
+		}
+
+		mHandshaking = false;
+		throw;
+	}
+}
+
+void Http::Server::Connection::handshaken(SecureTransport::Status status, std::exception_ptr error)
+{
+	mHandshaking = false;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mClosed) return;	// disconnected during the step
+	}
+
+	try {
+		if(error) std::rethrow_exception(error);
+
+		if(status != SecureTransport::Success)
+		{
+			attach(status == SecureTransport::WantWrite ? EventLoop::Writable : EventLoop::Readable);
+			return;
+		}
+
+		attach(EventLoop::Readable);
+		mHandshakeDone = true;
+		if(EnableHttp2 && mTransport->getProtocol() == "h2")
+			startSession();
+
+		readSocket();	// records might already be buffered
+		update();
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http::Server::Connection", e.what());
+		disconnect();
+	}
+}
+
+void Http::Server::Connection::update(void)
+{
+	bool resume;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mClosed) return;
+		mUpdatePosted = false;
+		resume = mReadPaused && mInput.size() < inputLimit();
+		if(resume) mReadPaused = false;
+	}
+
+	// Resuming must read directly as TLS records might be buffered
+	if(resume && mHandshakeDone) readSocket();
+	if(mSession) exchange();
+	writeSocket();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	bool pending = !mOutput.empty();
+
+	if(mSession)
+	{
+		if(!pending && (mInputClosed || mSession->isClosed()))
+		{
+			lock.unlock();
+			disconnect();
+			return;
+		}
+
+		// Frames left in the session once the socket took everything
+		if(!pending && mSession->hasOutput()) post();
+	}
+	else if(!mProcessing)
+	{
+		if(mClosing)
+		{
+			if(!pending)
+			{
+				if(mTransport || mInputClosed)
+				{
+					lock.unlock();
+					disconnect();
+					return;
+				}
+
+				// Closing with unread input, like pipelined requests, would reset the connection
+				// and might destroy the last response, so the input is drained until the peer closes
+				if(!mLingering)
+				{
+					mLingering = true;
+					mDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(LingerTimeout);
+					mSock->shutdownWrite();
+				}
+
+				mInput.clear();
+			}
+		}
+		else if(!mInput.empty())
+		{
+			// A connection in clear starting with the preface is HTTP/2 with prior knowledge
+			size_t available = mInput.size();
+			if(EnableHttp2 && !mTransport && mRequests == 0
+				&& std::memcmp(mInput.data(), Http2::Preface, std::min(available, Http2::PrefaceSize)) == 0)
+			{
+				if(available >= Http2::PrefaceSize)
+				{
+					lock.unlock();
+					startSession();
+					update();
+					return;
+				}
+			}
+			else {
+				// Dispatch the request as soon as the head is complete
+				size_t headSize = 0;
+				bool invalid = false;
+				try {
+					headSize = mParser.parse(mInput.data(), mInput.size());
+				}
+				catch(int code)
+				{
+					invalid = true;	// the worker reads the head again to respond with the error
+				}
+
+				if(headSize || invalid)
+					dispatch(headSize);
+			}
+		}
+		else if(mInputClosed)
+		{
+			if(!pending)
+			{
+				lock.unlock();
+				disconnect();
+				return;
+			}
+		}
+	}
+
+	// Reading resumes when the worker consumes the input
+	bool full = (mInput.size() >= inputLimit());
+	if(full) mReadPaused = true;
+
+	int events = 0;
+	if((!mClosing || mLingering) && !mInputClosed && !full) events|= EventLoop::Readable;
+	if(pending) events|= EventLoop::Writable;
+	lock.unlock();
+
+	if(mHandshakeDone || !mTransport) watch(events);
+}
+
+void Http::Server::Connection::readSocket(void)
+{
+	char buffer[RecordSize];
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			if(mInputClosed) return;
+			if(mInput.size() >= inputLimit())
+			{
+				mReadPaused = true;
+				return;
+			}
+		}
+
+		size_t count = 0;
+		bool closed = false;
+		if(mTransport)
+		{
+			SecureTransport::Status status = mTransport->tryRead(buffer, sizeof(buffer), count);
+			if(status == SecureTransport::Closed) closed = true;
+			else if(status != SecureTransport::Success) return;
+		}
+		else {
+			ssize_t ret = mSock->tryReadData(buffer, sizeof(buffer));
+			if(ret < 0) return;
+			if(ret == 0) closed = true;
+			count = size_t(ret);
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(closed) mInputClosed = true;
+		else mInput.append(buffer, count);
+		mCondition.notify_all();
+
+		// A short read drained the socket, but TLS records might remain buffered
+		if(closed || (!mTransport && count < sizeof(buffer)))
+			return;
+	}
+}
+
+void Http::Server::Connection::writeSocket(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mOutput.empty()) return;
+
+	while(!mOutput.empty())
+	{
+		size_t left = mOutput.size();
+		if(mTransport)
+		{
+			size_t size = (mPendingWrite ? mPendingWrite : std::min(left, RecordSize));
+			size_t count = 0;
+			if(mTransport->tryWrite(mOutput.data(), size, count) != SecureTransport::Success)
+			{
+				mPendingWrite = size;
+				break;
+			}
+
+			mPendingWrite = 0;
+			mOutput.consume(count);
+		}
+		else {
+			struct iovec iov;
+			iov.iov_base = const_cast<char*>(mOutput.data());
+			iov.iov_len = left;
+			ssize_t ret = mSock->tryWriteData(&iov, 1);
+			if(ret < 0) break;
+			mOutput.consume(size_t(ret));
+		}
+	}
+
+	mCondition.notify_all();
+}
+
+void Http::Server::Connection::attach(int events)
+{
+	std::weak_ptr<Connection> weak(shared_from_this());
+	mServer->mLoop->add(mSock, events, [weak](int events)
+	{
+		sptr<Connection> self = weak.lock();
+		if(self) self->onEvents(events);
+	});
+
+	mEvents = events;
+}
+
+void Http::Server::Connection::watch(int events)
+{
+	if(events != mEvents)
+	{
+		mServer->mLoop->modify(mSock, events);
+		mEvents = events;
+	}
+}
+
+void Http::Server::Connection::dispatch(size_t headSize)
+{
+	String head;
+	if(headSize)
+	{
+		head.assign(mInput.data(), headSize);
+		mInput.consume(headSize);
+	}
+
+	mParser.reset();
+	mProcessing = true;
+	int count = ++mRequests;
+
+	auto queued = std::chrono::steady_clock::now();
+	sptr<Connection> self = shared_from_this();
+	mServer->mPool.enqueue([self, head, count, queued]()
+	{
+		self->process(head, count, queued);
+	});
+}
+
+void Http::Server::Connection::process(const String &head, int count, std::chrono::steady_clock::time_point queued)
+{
+	bool persistent;
+	if(!head.empty())
+	{
+		RequestParser parser;
+		parser.parse(head.data(), head.size());
+		persistent = mServer->handleRequest(this, mRemote, count, &parser, queued);
+	}
+	else {
+		persistent = mServer->handleRequest(this, mRemote, count, NULL, queued);
+	}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mProcessing = false;
+	mClosing = !persistent;
+	mDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(persistent ? KeepAliveTimeout : RequestTimeout);
+	post();
+}
+
+void Http::Server::Connection::post(void)
+{
+	if(mUpdatePosted || mClosed) return;
+	mUpdatePosted = true;
+
+	sptr<Connection> self = shared_from_this();
+	mServer->mLoop->post([self]()
+	{
+		try {
+			self->update();
+		}
+		catch(const std::exception &e)
+		{
+			LogDebug("Http::Server::Connection", e.what());
+			self->disconnect();
+		}
+	});
+}
+
+size_t Http::Server::Connection::inputLimit(void) const
+{
+	// The head must fit so the parser can reject it if it is too large
+	return std::max(InputLimit, RequestParser::MaxHeadSize + 1);
+}
+
+void Http::Server::Connection::startSession(void)
+{
+	LogDebug("Http::Server::Connection", "Starting HTTP/2 session");
+
+	std::weak_ptr<Connection> weak(shared_from_this());
+	mSession = std::make_shared<Http2::Session>(true);
+	mSession->setRequestHandler([weak](sptr<Http2::Channel> channel)
+	{
+		sptr<Connection> self = weak.lock();
+		if(self) self->dispatch(channel);
+	});
+	mSession->setOutputHandler([weak]()
+	{
+		sptr<Connection> self = weak.lock();
+		if(!self) return;
+		std::unique_lock<std::mutex> lock(self->mMutex);
+		self->post();
+	});
+}
+
+void Http::Server::Connection::exchange(void)
+{
+	BinaryString input;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(!mInput.empty())
+		{
+			mInput.swap(input);	// without copy, as nothing else consumes the input
+			mDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(KeepAliveTimeout);
+		}
+	}
+
+	// The session calls dispatch() for new requests
+	if(!input.empty()) mSession->receive(input.data(), input.size());
+
+	size_t pending;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		pending = mOutput.size();
+	}
+
+	String output;
+	if(pending < OutputLimit && mSession->pull(output, OutputLimit - pending))
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mOutput.append(output.data(), output.size());
+	}
+}
+
+void Http::Server::Connection::dispatch(sptr<Http2::Channel> channel)
+{
+	int count = ++mRequests;
+	auto queued = std::chrono::steady_clock::now();
+	sptr<Connection> self = shared_from_this();
+	mServer->mPool.enqueue([self, channel, count, queued]()
+	{
+		self->process(channel, count, queued);
+	});
+}
+
+void Http::Server::Connection::process(sptr<Http2::Channel> channel, int count, std::chrono::steady_clock::time_point queued)
+{
+	try {
+		// The head is rebuilt in HTTP/1 syntax so requests go through the same parser
+		String head = FormatHttp2Head(channel->headers());
+		RequestParser parser;
+		if(!parser.parse(head.data(), head.size()))
+			throw Exception("Incomplete HTTP/2 request head");
+
+		mServer->handleRequest(channel.get(), mRemote, count, &parser, queued);
+		channel->close();
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http::Server::Connection", e.what());
+		channel->reset(Http2::InternalError);
+	}
+	catch(int code)
+	{
+		LogDebug("Http::Server::Connection", "Invalid HTTP/2 request head");
+		channel->reset(Http2::ProtocolError);
+	}
+}
+
+Http::SecureServer::SecureServer(SecureTransportServer::Credentials *credentials, int port) :
+	Server(port, 8, credentials)
+{
+
+}
+
+Http::SecureServer::~SecureServer(void)
+{
+
+}
+
+void Http::SecureServer::handle(Stream *stream, const Address &remote)
+{
+	Socket *sock = dynamic_cast<Socket*>(stream);
+	SecureTransportServer *transport = NULL;
+	try {
+		transport = new SecureTransportServer(stream);	// stream is now owned by transport
+		transport->addCredentials(mCredentials);
+		transport->handshake();
+
+		handleRequests(transport, remote);
+
+		if(sock) recordStats(*sock);
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http::SecureServer::Handler", e.what());
+	}
+
+	if(transport) delete transport;
+	else delete stream;
+}
+
+// Handle relative location even if not RFC-compliant
+static String ResolveLocation(const String &url, const String &location)
+{
+	if(location.contains(":/")) return location;
+
+	if(location[0] == '/')
+	{
+		Http::Request request(url, "GET");
+		return request.protocol.toLower() + "://" + request.headers["Host"] + location;
+	}
+
+	int p = url.lastIndexOf('/');
+	Assert(p > 0);
+	return url.substr(0, p) + "/" + location;
 }
 
-void Http::Response::clear(void)
+// Parses "bytes first-last/complete", complete is -1 if unknown
+static bool ParseContentRange(String value, int64_t &begin, int64_t &end, int64_t &total)
 {
-	code = 200;
-	version = "1.0";
-	message.clear();
-	cookies.clear();
+	value.trim();
+	if(String(value.substr(0, 6)).toLower() == "bytes ") value = value.substr(6);
+
+	String complete = value.cut('/');
+	String last = value.cut('-');
+	complete.trim();
+
+	if(!value.read(begin) || !last.read(end) || end < begin) return false;
+	if(complete == "*") total = -1;
+	else if(!complete.read(total) || total <= end) return false;
+	return true;
 }
 
-Http::Server::Server(int port, int threads) :
-	mSock(port),
-	mPool(threads)
+// Receives the body of a range, refusing more than expected
+class RangeBuffer : public Stream
 {
-	mPool.enqueue([this]()
+public:
+	RangeBuffer(BinaryString *data, int64_t limit) : mData(data), mLimit(limit) {}
+
+	size_t readData(char *buffer, size_t size)
 	{
-		this->run();
-	});
-}
+		throw Unsupported("Reading from a range buffer");
+	}
 
-Http::Server::~Server(void)
+	void writeData(const char *data, size_t size)
+	{
+		if(int64_t(mData->size() + size) > mLimit)
+			throw Exception("Range response is larger than requested");
+
+		mData->append(data, size);
+	}
+
+private:
+	BinaryString *mData;
+	int64_t mLimit;
+};
+
+Http::Downloader::Downloader(const String &url, int connections, bool noproxy) :
+	mUrl(url),
+	mConnections(std::max(connections, 1)),
+	mRangeSize(0),
+	mRetries(MaxRetries),
+	mNoProxy(noproxy),
+	mSize(-1)
 {
-	mSock.close();
-	mPool.join();
+
 }
 
-void Http::Server::generate(Stream &out, int code, const String &message)
+Http::Downloader::~Downloader(void)
 {
-	out<<"<!DOCTYPE html>\n";
-	out<<"<html>\n";
-	out<<"<head><title>"<<message<<"</title></head>\n";
-	out<<"<body><h1>"<<code<<" "<<message<<"</h1></body>\n";
-	out<<"</html>\n";
+
 }
 
-void Http::Server::handle(Stream *stream, const Address &remote)
+void Http::Downloader::setConnections(int connections)
 {
-	Request request;
-	try {
-		try {
-			request.recv(stream);
-			request.remoteAddress = remote;
-			process(request);
-		}
-		catch(const Timeout &e)
-		{
-			throw 408;
-		}
-		catch(const NetException &e)
-		{
-			LogDebug("Http::Server::Handler", e.what());
-		}
- 		catch(const std::exception &e)
-		{
-			LogWarn("Http::Server::Handler", e.what());
-			throw 500;
-		}
-	}
-	catch(int code)
-	{
-		try {
-			Response response(request, code);
-			response.headers["Content-Type"] = "text/html; charset=UTF-8";
-			response.send();
+	mConnections = std::max(connections, 1);
+}
 
-			if(request.method != "HEAD")
-				generate(*response.stream, response.code, response.message);
-		}
-		catch(...)
-		{
+void Http::Downloader::setRangeSize(int64_t size)
+{
+	mRangeSize = std::max(size, int64_t(0));
+}
 
-		}
-	}
+void Http::Downloader::setRetries(int retries)
+{
+	mRetries = std::max(retries, 0);
 }
 
-void Http::Server::respondWithFile(const Request &request, const String &fileName)
+int Http::Downloader::download(Stream *output)
 {
-	int code = 200;
-	File file;
+	Assert(output);
 
-	if(!File::Exist(fileName)) code = 404;
-	else {
-		if(request.method != "GET" && request.method != "HEAD") code = 405;
-		else {
-			String ifModifiedSince;
-			if(request.headers.get("If-Modified-Since", ifModifiedSince))
-			{
-				try {
-					Time time(ifModifiedSince);
-					if(time >= File::Time(fileName))
-					{
-						Response response(request, 304);
-						response.send();
-						return;
-					}
-				}
-				catch(const Exception &e)
-				{
-					LogWarn("Http::respondWithFile", e.what());
-				}
-			}
+	int code = probe();
+	if(code != 200) return code;
 
-			try {
-				file.open(fileName, File::Read);
-			}
-			catch(...)
-			{
-				code = 403;
-			}
-		}
-	}
+	if(mRanges.empty())
+		return Get(mUrl, output, NULL, 5, mNoProxy);
 
-	int64_t rangeBegin = 0;
-	int64_t rangeEnd = 0;
-	bool hasRange = request.extractRange(rangeBegin, rangeEnd, file.size());
-	if(rangeBegin >= file.size() || rangeEnd >= file.size())
-		code = 406;
+	// Only the calling thread writes to output, in order
+	run([output](const Range &range, BinaryString &data) {
+		output->writeData(data.data(), data.size());
+	}, true);
 
-	if(code != 200)
-	{
-		Response response(request, code);
-		response.headers["Content-Type"] = "text/html; charset=UTF-8";
-		response.send();
+	return 200;
+}
 
-		if(request.method != "HEAD")
-			generate(*response.stream, response.code, response.message);
+int Http::Downloader::download(const String &fileName)
+{
+	int code = probe();
+	if(code != 200) return code;
 
-		return;
+	if(mRanges.empty())
+	{
+		File file(fileName, File::Truncate);
+		code = Get(mUrl, &file, NULL, 5, mNoProxy);
+		file.close();
+		return code;
 	}
 
-	if(hasRange) code = 206;
-	Response response(request, code);
+	File file(fileName, File::Truncate);
+	std::mutex mutex;
+	run([&file, &mutex](const Range &range, BinaryString &data) {
+		std::unique_lock<std::mutex> lock(mutex);
+		file.seekWrite(range.begin);
+		file.writeData(data.data(), data.size());
+	}, false);
 
-	String name = fileName.afterLast(Directory::Separator);
-	if(name != request.url.afterLast('/'))
-	{
-		response.headers["Content-Name"] = name;
-		response.headers["Content-Disposition"] = "inline; filename=\"" + name + "\"";
-	}
+	file.close();
+	return 200;
+}
 
-	if(hasRange)
+int64_t Http::Downloader::size(void) const
+{
+	return mSize;
+}
+
+int Http::Downloader::probe(void)
+{
+	mRanges.clear();
+	mValidator.clear();
+	mSize = -1;
+
+	// Follow redirections here so ranges are requested from the final location
+	StringMap headers;
+	StringMap responseHeaders;
+	int code = 0;
+	for(int i = 0; i <= 5; ++i)
 	{
-		response.headers["Content-Length"] << (rangeEnd - rangeBegin + 1);
-		response.headers["Content-Range"] << rangeBegin << "-" << rangeEnd << "/" << file.size();
-	}
-	else {
-		response.headers["Content-Length"] << file.size();
+		responseHeaders.clear();
+		code = Action("HEAD", mUrl, "", headers, NULL, &responseHeaders, NULL, 0, mNoProxy);
+
+		String location;
+		if(code/100 != 3 || !responseHeaders.get("Location", location) || location.empty()) break;
+		mUrl = ResolveLocation(mUrl, location);
 	}
 
-	response.headers["Accept-Ranges"] = "bytes";
-	response.headers["Content-Type"] = Mime::GetType(fileName);
-	response.headers["Last-Modified"] = File::Time(fileName).toHttpDate();
+	String value;
+	if(code == 200 && responseHeaders.get("Content-Length", value))
+		value.extract(mSize);
 
-	response.send();
+	bool acceptRanges = (responseHeaders.get("Accept-Ranges", value) && value.toLower().contains("bytes"));
 
-	if(request.method != "HEAD")
+	if(code == 405 || code == 501 || (code == 200 && (mSize < 0 || !acceptRanges)))
 	{
-		if(hasRange)
-		{
-			file.seekRead(rangeBegin);
-			file.read(*response.stream, rangeEnd - rangeBegin + 1);
+		// HEAD is not conclusive, probe with a one-byte range
+		StringMap rangeHeaders;
+		rangeHeaders["Range"] = "bytes=0-0";
+		BinaryString data;
+		RangeBuffer buffer(&data, 1);
+
+		responseHeaders.clear();
+		try {
+			code = Action("GET", mUrl, "", rangeHeaders, &buffer, &responseHeaders, NULL, 0, mNoProxy);
 		}
-		else {
-			file.read(*response.stream);
+		catch(const Exception &e)
+		{
+			// The server ignored the range and sent the whole resource
+			LogDebug("Http::Downloader", String("Range probe failed: ") + e.what());
+			return 200;
 		}
-		file.close();
+
+		int64_t begin, end, total;
+		if(code != 206) return (code == 416 ? 200 : code);
+		if(!responseHeaders.get("Content-Range", value) || !ParseContentRange(value, begin, end, total) || total < 0)
+			return 200;
+
+		mSize = total;
+		acceptRanges = true;
+		code = 200;
 	}
-}
 
-void Http::Server::run(void)
-{
-	Socket *sock = NULL;
-	try {
-		while(true)
-		{
-			sock = new Socket;
-			mSock.accept(*sock);
-			sock->setReadTimeout(RequestTimeout);
+	if(code != 200 || !acceptRanges || mSize < 0)
+		return code;
 
-			mPool.enqueue([this, sock]()
-			{
-				this->handle(sock, sock->getRemoteAddress());
-				delete sock;
-			});
+	if(responseHeaders.get("ETag", value) && !value.empty() && value.substr(0, 2) != "W/")
+		mValidator = value;
+	else if(responseHeaders.get("Last-Modified", value))
+		mValidator = value;
 
-			sock = NULL;
-		}
-	}
-	catch(const NetException &e)
-	{
-		delete sock;
-		return;
-	}
-	catch(...)
+	int64_t rangeSize = mRangeSize;
+	if(!rangeSize) rangeSize = bounds(mSize/(mConnections*4), MinRangeSize, MaxRangeSize);
+	if(mConnections == 1 || mSize < 2*rangeSize)
+		return 200;	// a single request is enough
+
+	for(int64_t begin = 0; begin < mSize; begin+= rangeSize)
 	{
-		delete sock;
-		throw;
+		Range range;
+		range.begin = begin;
+		range.end = std::min(begin + rangeSize, mSize) - 1;
+		range.attempts = 0;
+		mRanges.push_back(range);
 	}
+
+	LogDebug("Http::Downloader", "Fetching " + String::number(mSize) + " bytes as " + String::number(mRanges.size()) + " ranges over " + String::number(mConnections) + " connections");
+	return 200;
 }
 
-Http::SecureServer::SecureServer(SecureTransportServer::Credentials *credentials, int port) :
-	Server(port),
-	mCredentials(credentials)
+void Http::Downloader::fetch(const Range &range, BinaryString &data) const
 {
+	StringMap headers;
+	headers["Range"] << "bytes=" << range.begin << "-" << range.end;
+	if(!mValidator.empty()) headers["If-Range"] = mValidator;
 
-}
+	int64_t length = range.end - range.begin + 1;
+	RangeBuffer buffer(&data, length);
+	StringMap responseHeaders;
+	int code = Action("GET", mUrl, "", headers, &buffer, &responseHeaders, NULL, 0, mNoProxy);
 
-Http::SecureServer::~SecureServer(void)
-{
-	delete mCredentials;
+	if(code == 200)
+		throw Exception("Resource changed during download");
+
+	if(code/100 == 5)
+		throw NetException("HTTP error " + String::number(code) + " on range");
+
+	String value;
+	int64_t begin, end, total;
+	if(code != 206 || !responseHeaders.get("Content-Range", value) || !ParseContentRange(value, begin, end, total))
+		throw Exception("Unexpected response to range request: " + String::number(code));
+
+	if(begin != range.begin || end != range.end || (total >= 0 && total != mSize))
+		throw Exception("Server returned a different range than requested");
+
+	if(int64_t(data.size()) != length)
+		throw NetException("Range transfer interrupted");
 }
 
-void Http::SecureServer::handle(Stream *stream, const Address &remote)
+void Http::Downloader::run(std::function<void(const Range &range, BinaryString &data)> deliver, bool ordered)
 {
-	SecureTransportServer *transport = NULL;
-	try {
-		transport = new SecureTransportServer(stream);
-		transport->addCredentials(mCredentials);
-		transport->handshake();
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<size_t> pending;
+	std::map<size_t, BinaryString> completed;	// only if ordered
+	size_t next = 0;							// next range to deliver, if ordered
+	size_t window = 2*mConnections;				// ranges buffered ahead of next, if ordered
+	std::exception_ptr error;
+
+	for(size_t i = 0; i < mRanges.size(); ++i)
+		pending.push_back(i);
+
+	auto fail = [&](std::exception_ptr e) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if(!error) error = e;
+		condition.notify_all();
+	};
+
+	auto worker = [&]() {
+		while(true)
+		{
+			size_t index;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&]() {
+					return error || pending.empty() || !ordered || pending.front() < next + window;
+				});
+
+				if(error || pending.empty()) break;
+				index = pending.front();
+				pending.pop_front();
+			}
 
-		Server::handle(transport, remote);
-	}
-	catch(const std::exception &e)
+			Range &range = mRanges[index];
+			BinaryString data;
+			std::exception_ptr retryError;
+			try {
+				fetch(range, data);
+			}
+			catch(const NetException &e)
+			{
+				retryError = std::current_exception();
+			}
+			catch(const Timeout &e)
+			{
+				retryError = std::current_exception();
+			}
+			catch(...)
+			{
+				fail(std::current_exception());
+				break;
+			}
+
+			if(retryError)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if(++range.attempts > mRetries)
+				{
+					if(!error) error = retryError;
+					condition.notify_all();
+					break;
+				}
+
+				LogDebug("Http::Downloader", "Retrying range " + String::number(range.begin) + "-" + String::number(range.end) + ", attempt " + String::number(range.attempts));
+				pending.push_front(index);	// retried first so the ordered window keeps moving
+				continue;
+			}
+
+			if(ordered)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				completed[index].swap(data);
+				condition.notify_all();
+			}
+			else {
+				try {
+					deliver(range, data);
+				}
+				catch(...)
+				{
+					fail(std::current_exception());
+					break;
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(int i = 0; i < std::min(mConnections, int(mRanges.size())); ++i)
+		threads.emplace_back(worker);
+
+	if(ordered)
 	{
-		LogDebug("Http::SecureServer::Handler", e.what());
+		try {
+			std::unique_lock<std::mutex> lock(mutex);
+			while(next < mRanges.size())
+			{
+				condition.wait(lock, [&]() {
+					return error || completed.find(next) != completed.end();
+				});
+
+				if(error) break;
+
+				BinaryString data;
+				data.swap(completed[next]);
+				completed.erase(next);
+
+				lock.unlock();
+				deliver(mRanges[next], data);
+				lock.lock();
+
+				++next;
+				condition.notify_all();
+			}
+		}
+		catch(...)
+		{
+			fail(std::current_exception());
+		}
 	}
 
-	delete transport;
+	for(auto &t : threads)
+		t.join();
+
+	if(error) std::rethrow_exception(error);
 }
 
 int Http::Action(const String &method, const String &url, const String &data, const StringMap &headers, Stream *output, StringMap *responseHeaders, StringMap *cookies, int maxRedirections, bool noproxy)
@@ -933,49 +3845,67 @@ int Http::Action(const String &method, const String &url, const String &data, co
 	}
 
 	Stream *stream = sock;
+	sptr<Http2::Client> client;
+	sptr<Http2::Channel> channel;
 	try {
 		if(request.protocol == "HTTPS")
-			stream = new SecureTransportClient(sock, new SecureTransportClient::Certificate, host);
+		{
+			SecureTransportClient *transport = new SecureTransportClient(sock, NULL, host);
+			stream = transport;	// sock is now owned by transport
+
+			if(EnableHttp2)
+			{
+				List<String> protocols;
+				protocols.push_back("h2");
+				protocols.push_back("http/1.1");
+				transport->setProtocols(protocols);
+			}
 
-		request.send(stream);
+			transport->addCredentials(new SecureTransportClient::Certificate, true);
+			transport->handshake();
+
+			if(transport->getProtocol() == "h2")
+			{
+				client = std::make_shared<Http2::Client>(stream);	// stream is now owned by client
+				stream = NULL;
+				channel = client->open();
+			}
+			else {
+				transport->setWriteCoalescing(true);	// flushed when reading the response
+			}
+		}
+
+		Stream *target = (channel ? channel.get() : stream);
+		request.send(target);
 		if(!data.empty())
-			stream->write(data);
+			target->write(data);
+		if(channel)
+			channel->close();
 
 		Response response;
-		response.recv(stream);
+		response.recv(target);
 
 		if(cookies)
 			cookies->insertAll(response.cookies);
 
 		if(maxRedirections && response.code/100 == 3 && response.headers.contains("Location"))
 		{
-			stream->discard();
+			response.stream->discard();
 			delete stream;
 			stream = NULL;
+			channel.reset();
+			client.reset();
 
 			String location(response.headers["Location"]);
 			if(!location.empty())
-			{
-				// Handle relative location even if not RFC-compliant
-				if(!location.contains(":/"))
-				{
-					if(location[0] == '/') location = request.protocol.toLower() + "://" + host + location;
-					else {
-						int p = url.lastIndexOf('/');
-						Assert(p > 0);
-						location = url.substr(0, p) + "/" + location;
-					}
-				}
-
-				return Get(location, output, cookies, maxRedirections-1, noproxy);
-			}
+				return Get(ResolveLocation(url, location), output, cookies, maxRedirections-1, noproxy);
 		}
 
 		if(responseHeaders)
 			*responseHeaders = response.headers;
 
-		if(output) stream->read(*output);
-		else stream->discard();
+		if(output) response.stream->read(*output);
+		else response.stream->discard();
 		delete stream;
 		stream = NULL;
 		return response.code;
@@ -1016,6 +3946,23 @@ int Http::Post(const String &url, const String &data, const String &type, Stream
 	return Action("POST", url, data, headers, output, NULL, cookies, maxRedirections, noproxy);
 }
 
+bool Http::IsCompressible(const String &contentType)
+{
+	String type = contentType;
+	type.cut(';');
+	type.trim();
+	type = type.toLower();
+
+	if(type.empty()) return false;
+	if(type.substr(0, 5) == "text/") return true;
+	if(type.substr(type.size() - std::min(type.size(), size_t(4))) == "+xml") return true;
+	if(type.substr(type.size() - std::min(type.size(), size_t(5))) == "+json") return true;
+	return type == "application/json"
+		|| type == "application/javascript"
+		|| type == "application/xml"
+		|| type == "image/svg+xml";
+}
+
 String Http::AppendParam(const String &url, const String &name, const String &value)
 {
 	char separator = '?';
@@ -28,8 +28,11 @@
 #include "pla/serversocket.hpp"
 #include "pla/threadpool.hpp"
 #include "pla/securetransport.hpp"
+#include "pla/eventloop.hpp"
+#include "pla/deflate.hpp"
 #include "pla/file.hpp"
 #include "pla/map.hpp"
+#include "pla/histogram.hpp"
 
 namespace pla
 {
@@ -40,6 +43,151 @@ public:
 	static String UserAgent;
 	static duration ConnectTimeout;
 	static duration RequestTimeout;
+	static duration KeepAliveTimeout;	// idle time before a persistent connection is closed
+	static int KeepAliveMaxRequests;	// requests served on a persistent connection, 0 means unlimited
+	static int CompressionLevel;		// for responses compressed on the fly, 0 disables it
+	static size_t CompressionMinSize;	// smaller bodies are not worth compressing
+	static int64_t MaxFieldSize;		// for posted multipart fields kept in memory, 0 means unlimited
+	static int64_t MaxFileSize;			// for uploaded files, 0 means unlimited
+	static bool EnableHttp2;			// negotiated with ALPN over TLS, and accepted with prior knowledge in clear
+
+	static bool IsCompressible(const String &contentType);
+
+	class Server;
+
+	// Chunked transfer encoding, reading decodes and writing encodes
+	// close() terminates the written body with trailers but leaves the underlying stream open
+	class ChunkedStream : public Stream
+	{
+	public:
+		static size_t ChunkSize;	// written data is buffered up to this size, flush() sends it immediately
+		static const size_t MaxTrailers = 64;	// received trailer lines
+		static size_t MaxTrailersSize;			// received trailer bytes
+
+		ChunkedStream(Stream *stream, bool mustDelete = false);
+		~ChunkedStream(void);
+
+		StringMap &trailers(void);	// received at the end of the body, or sent on close
+		const StringMap &trailers(void) const;
+
+		// Stream
+		size_t readData(char *buffer, size_t size);
+		void writeData(const char *data, size_t size);
+		void flush(void);
+		void close(void);
+
+	private:
+		static const size_t HeaderSize;
+
+		void writeBuffer(void);
+
+		Stream *mStream;
+		bool mMustDelete;
+		StringMap mTrailers;
+
+		uint64_t mReadLeft;
+		bool mReadChunk, mReadEnd;
+
+		char *mWriteBuffer;	// space for the chunk header is reserved before data
+		size_t mWriteSize;
+		bool mWriteEnd;
+	};
+
+	// Incremental parser for request heads, producing views into the caller's buffer
+	// It does not allocate, headers are kept in a fixed array and parameters are decoded on demand
+	class RequestParser
+	{
+	public:
+		static const size_t MaxHeaders = 64;
+		static size_t MaxHeadSize;
+
+		struct View
+		{
+			const char *data;
+			size_t size;
+
+			View(void) : data(NULL), size(0) {}
+			View(const char *d, size_t s) : data(d), size(s) {}
+
+			bool empty(void) const { return size == 0; }
+			bool equals(const char *str) const;
+			bool equalsNoCase(const char *str) const;
+			String toString(void) const;
+			String urlDecode(void) const;
+		};
+
+		struct Header
+		{
+			View name;
+			View value;
+		};
+
+		RequestParser(void);
+		void reset(void);
+
+		// data must start with the bytes passed to previous calls, it may have moved
+		// Returns the size of the head once complete, 0 if more data is needed
+		// Throws the HTTP error code on invalid requests
+		size_t parse(const char *data, size_t size);
+
+		// Views are valid once the head is complete and while the buffer is unchanged
+		View method(void) const;
+		View target(void) const;	// path with query
+		View path(void) const;
+		View query(void) const;
+		View version(void) const;	// 1.0 or 1.1
+
+		size_t headersCount(void) const;
+		const Header &header(size_t i) const;
+		bool getHeader(const char *name, View &value) const;	// case-insensitive
+
+		bool getParam(const char *name, String &value) const;	// URL parameter, decoded
+		bool getCookie(const char *name, String &value) const;
+		void getParams(StringMap &params) const;
+		void getCookies(StringMap &cookies) const;
+
+	private:
+		void parseHead(const char *data, size_t size);
+
+		size_t mLineStart;	// line being scanned
+		size_t mHeadStart;	// after leading empty lines
+		size_t mHeadSize;
+		View mMethod, mTarget, mPath, mQuery, mVersion;
+		Header mHeaders[MaxHeaders];
+		size_t mHeadersCount;
+	};
+
+	// Streaming parser for multipart/form-data bodies
+	// The body is read in large blocks, and each part is written to the stream returned by the handler
+	class MultipartParser
+	{
+	public:
+		struct Part
+		{
+			StringMap headers;
+			String name;
+			String fileName;	// empty if the part is not a file
+			String contentType;
+		};
+
+		typedef std::function<Stream*(const Part &part)> handler_t;	// returns NULL to skip the part
+
+		static size_t BlockSize;	// also bounds the headers of a part
+
+		MultipartParser(const String &boundary);	// as in the Content-Type parameter
+		~MultipartParser(void);
+
+		void setLimits(int64_t maxFieldSize, int64_t maxFileSize);	// throws 413 when exceeded, 0 means unlimited
+		int64_t parse(Stream *stream, int64_t length, handler_t handler);	// returns the size read
+
+	private:
+		const char *find(const char *begin, const char *end) const;	// delimiter search
+		void parseHeaders(const char *begin, const char *end, Part &part) const;
+
+		String mDelimiter;		// line break, dashes and boundary
+		size_t mSkip[256];		// Horspool shift table for mDelimiter
+		int64_t mMaxFieldSize, mMaxFileSize;
+	};
 
 	struct Request
 	{
@@ -48,9 +196,11 @@ public:
 		virtual ~Request(void);
 
 		void send(Stream *stream);
-		void recv(Stream *stream, bool parsePost = true);
+		void recv(Stream *stream, bool parsePost = true);	// chunked bodies are only decoded if parsePost is true
+		void recv(Stream *stream, const RequestParser &head, bool parsePost = true);	// head already parsed, the body is read from stream
 		void clear(void);
 		bool extractRange(int64_t &rangeBegin, int64_t &rangeEnd, int64_t contentLength = -1) const;
+		String acceptedEncoding(void) const;	// gzip or deflate from Accept-Encoding, empty for identity
 
 		String protocol;		// HTTP or HTTPS
 		String method;			// GET, POST, HEAD...
@@ -60,23 +210,31 @@ public:
 		StringMap cookies;		// Cookies
 		StringMap get;			// URL parameters
 		StringMap post;			// POST parameters
+		StringMap params;		// Route parameters, set by Router
 		Map<String, TempFile*> files;	// Files posted with POST
 		Address remoteAddress;			// Remote address, set by Server
+		Server *server;					// Server handling the request, set by Server
+		bool keepAlive;					// Persistent connection requested, set by recv
 
 		String fullUrl;		// URL with parameters
 		Stream *stream;		// Internal use for Response construction
+		mutable bool persistent;	// Internal use, set when the response allows to reuse the connection
+		bool upgraded;				// Internal use, set by Server::upgrade()
 	};
 
 	struct Response
 	{
 		Response(int code = 200);
 		Response(const Request &request, int code = 200);
+		~Response(void);	// terminates a compressed or chunked body
 
 		void send(void);
 		void send(Stream *stream);
 		void recv(Stream *stream);
 		void clear(void);
 
+		static String StatusMessage(int code);
+
 		int code;			// Response code
 		String version;		// 1.0 or 1.1
 		String message;		// Message
@@ -84,26 +242,187 @@ public:
 		StringMap cookies;	// Cookies
 
 		Stream *stream;		// Stream where to send/receive data
+		const Request *request;	// Request being answered, if any
+
+		sptr<ChunkedStream> encoder;	// Internal use, set by send if the body is chunked
+		sptr<ChunkedStream> decoder;	// Internal use, set by recv if the body is chunked
+		sptr<Deflate> compressor;		// Internal use, set by send if the body is compressed on the fly
+	};
+
+	// FileCache keeps small files in memory with their response headers precomputed.
+	// Files are checked on disk at most once per RevalidationPeriod.
+	class FileCache
+	{
+	public:
+		struct Entry
+		{
+			String data;
+			String contentType;
+			String lastModified;	// HTTP date
+			String etag;			// strong, from the content hash
+			Time time;
+			uint64_t size;
+		};
+
+		static duration RevalidationPeriod;
+
+		FileCache(size_t capacity = 64*1024*1024, size_t maxFileSize = 1024*1024);	// in bytes
+		~FileCache(void);
+
+		sptr<const Entry> get(const String &fileName);	// null if the file can't be cached
+		sptr<const Entry> getVariant(const Entry &entry, const String &encoding);	// compressed with gzip or deflate
+		void setCapacity(size_t capacity, size_t maxFileSize);
+		void clear(void);
+		size_t size(void) const;
+
+	private:
+		struct Item
+		{
+			sptr<const Entry> entry;
+			std::chrono::steady_clock::time_point checked;
+			std::list<String>::iterator lru;
+		};
+
+		sptr<const Entry> load(const String &fileName) const;
+		void insert(const String &fileName, sptr<const Entry> entry);
+		void erase(const String &fileName);
+		void evict(void);
+
+		std::map<String, Item> mItems;
+		std::list<String> mLru;	// most recently used first
+		size_t mCapacity, mMaxFileSize;
+		size_t mSize;
+		mutable std::mutex mMutex;
+	};
+
+	// Dispatches requests to handlers by method and path, with a radix tree per method
+	// Patterns are paths where a segment can be ":name", matching one segment, or a final "*name",
+	// matching the rest of the path. Literal matches take precedence over parameters, then wildcards.
+	class Router
+	{
+	public:
+		typedef std::function<void(Request &request)> handler_t;	// route parameters are in request.params
+
+		Router(void);
+		~Router(void);
+
+		void add(const String &method, const String &pattern, handler_t handler);	// method "*" matches any method
+		bool route(Request &request) const;	// returns false if no route matches, throws 405 if only the method differs
+		void clear(void);
+
+	private:
+		struct Node
+		{
+			String prefix;		// literal characters, empty for parameters
+			String indices;		// first character of each literal child
+			std::vector<sptr<Node> > children;
+			sptr<Node> param;
+			sptr<Node> wildcard;
+			handler_t handler;
+			std::vector<String> names;	// parameter names of the route ending here, in order
+		};
+
+		typedef std::vector<std::pair<const char*, size_t> > values_t;
+
+		static void Insert(Node *node, const String &pattern, handler_t handler);
+		static const Node *Match(const Node *node, const char *path, const char *end, values_t &values);
+		const Node *find(const String &method, const String &path, values_t &values) const;
+
+		std::map<String, sptr<Node> > mTrees;	// by method
 	};
 
 	class Server
 	{
 	public:
+		// Transport metrics aggregated over connections, sampled when they end
+		struct ConnectionStats
+		{
+			Histogram rtt;				// milliseconds
+			Histogram rttVar;			// milliseconds
+			Histogram congestionWindow;	// segments
+			Histogram retransmits;
+			Histogram bytesInFlight;
+			Histogram deliveryRate;		// bytes per second
+		};
+
+		// Connections are served by an event loop where available, only process() runs on the threads
+		// HTTP/2 requires the event loop, the thread-per-connection fallback serves HTTP/1 only
 		Server(int port = 80, int threads = 8);
 		virtual ~Server(void);
 
 		virtual void process(Http::Request &request) = 0;
 		virtual void generate(Stream &out, int code, const String &message);
 
+		const ConnectionStats &connectionStats(void) const;
+
+		// Admission control, requests are shed with 503 and Retry-After before their body is read
+		struct AdmissionStats
+		{
+			uint64_t admitted = 0;
+			uint64_t rateLimited = 0;	// remote address exceeded its rate
+			uint64_t overloaded = 0;	// concurrency limit reached
+			uint64_t expired = 0;		// waited too long for a worker
+		};
+
+		void setRateLimit(double rate, double burst = 0.);	// requests per second per remote host, 0 disables it
+		void setConcurrencyLimit(int limit);				// requests processed at once, 0 disables it
+		void setMaxQueueTime(duration timeout);				// time waiting for a worker, 0 disables it
+		AdmissionStats admissionStats(void) const;
+
+		// Protocol upgrades, like WebSocket, keep the connection and its thread until process() returns
+		// Reads on an upgraded connection do not time out, the new protocol is expected to handle it
+		void setUpgradeLimit(int limit);	// upgraded connections at once, negative means unlimited, defaults to threads - 1
+		bool upgrade(Request &request);		// called from process(), returns false if the limit is reached
+
 	protected:
-		virtual void handle(Stream *stream, const Address &remote);
-		virtual void respondWithFile(const Request &request, const String &fileName);
+		Server(int port, int threads, SecureTransportServer::Credentials *credentials);	// credentials will be deleted
+
+		virtual void handle(Stream *stream, const Address &remote);	// stream will be deleted
+		virtual void respondWithFile(const Request &request, const String &fileName);	// small files are served from mFileCache
+		void handleRequests(Stream *stream, const Address &remote);	// serves requests until the connection is closed
+		bool handleRequest(Stream *stream, const Address &remote, int count, const RequestParser *head = NULL, std::chrono::steady_clock::time_point queued = std::chrono::steady_clock::time_point());	// returns true if the connection persists
+		void recordStats(const Socket &sock);
 
 		ServerSocket mSock;
 		ThreadPool mPool;
+		ConnectionStats mConnectionStats;
+		FileCache mFileCache;	// used by respondWithFile()
+		SecureTransportServer::Credentials *mCredentials;	// TLS is used if set
 
 	private:
-		void run(void);
+		class Connection;
+
+		struct Bucket
+		{
+			double tokens;
+			std::chrono::steady_clock::time_point last;
+		};
+
+		bool respondWithEntry(const Request &request, const String &fileName, const FileCache::Entry &entry, const String &encoding = "");
+		void start(void);
+		void run(void);		// thread-per-connection, if there is no event loop
+		void accept(void);
+		void sweep(void);	// closes connections past their deadline
+		int admit(const Address &remote, std::chrono::steady_clock::time_point queued);	// returns 0 if admitted, else the delay to retry in seconds
+		void release(void);	// ends an admitted request
+
+		sptr<EventLoop> mLoop;
+		std::map<Connection*, sptr<Connection> > mConnections;	// accessed from the loop thread
+
+		std::map<String, Bucket> mBuckets;	// token buckets by remote host
+		std::chrono::steady_clock::time_point mBucketsSweep;
+		double mRateLimit, mRateBurst;
+		int mConcurrencyLimit;
+		int mActiveRequests;
+		duration mMaxQueueTime;
+		int mUpgradeLimit;
+		int mUpgraded;
+		AdmissionStats mAdmissionStats;
+		mutable std::mutex mAdmissionMutex;
+
+		int mHandshakeSteps;	// submitted and not done, they use the credentials
+		std::mutex mHandshakeMutex;
+		std::condition_variable mHandshakeCondition;
 	};
 
 	class SecureServer : public Server
@@ -113,10 +432,51 @@ public:
 		virtual ~SecureServer(void);
 
 	protected:
-		virtual void handle(Stream *stream, const Address &remote);
+		virtual void handle(Stream *stream, const Address &remote);	// stream will be deleted
+	};
+
+	// Fetches a resource as byte ranges over several connections if the server allows it
+	class Downloader
+	{
+	public:
+		static int DefaultConnections;
+		static int64_t MinRangeSize;	// resources smaller than two ranges are fetched in one request
+		static int64_t MaxRangeSize;	// bounds the memory buffered per range
+		static int MaxRetries;			// per range, on network errors
+
+		Downloader(const String &url, int connections = DefaultConnections, bool noproxy = false);
+		~Downloader(void);
+
+		void setConnections(int connections);
+		void setRangeSize(int64_t size);	// 0 means automatic
+		void setRetries(int retries);
+
+		// Both return the HTTP status code, 200 on success
+		int download(Stream *output);			// ranges are reassembled in order
+		int download(const String &fileName);	// ranges are written in place as they arrive
+
+		int64_t size(void) const;	// known after download(), -1 if the server did not tell
 
 	private:
-		SecureTransportServer::Credentials *mCredentials;
+		struct Range
+		{
+			int64_t begin;
+			int64_t end;	// inclusive
+			int attempts;
+		};
+
+		int probe(void);	// returns the status code, sets mRanges if ranges can be used
+		void fetch(const Range &range, BinaryString &data) const;
+		void run(std::function<void(const Range &range, BinaryString &data)> deliver, bool ordered);
+
+		String mUrl;
+		String mValidator;	// strong ETag or Last-Modified, sent as If-Range
+		int mConnections;
+		int64_t mRangeSize;
+		int mRetries;
+		bool mNoProxy;
+		int64_t mSize;
+		std::vector<Range> mRanges;
 	};
 
 	static int Action(const String &method, const String &url, const String &data, const StringMap &headers, Stream *output = NULL, StringMap *responseHeaders = NULL, StringMap *cookies = NULL, int maxRedirections = 5, bool noproxy = false);
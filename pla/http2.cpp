@@ -0,0 +1,1973 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#include "pla/http2.hpp"
+#include "pla/http.hpp"
+#include "pla/exception.hpp"
+#include "pla/socket.hpp"
+#include "pla/securetransport.hpp"
+
+namespace pla
+{
+
+const char Http2::Preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t Http2::PrefaceSize;
+
+uint32_t Http2::MaxConcurrentStreams = 100;
+uint32_t Http2::InitialWindowSize = 256*1024;
+uint32_t Http2::ConnectionWindowSize = 1024*1024;
+size_t Http2::MaxHeaderListSize = 64*1024;
+size_t Http2::WriteBufferSize = 64*1024;
+
+const size_t Http2::Hpack::DefaultTableSize;
+
+static const uint32_t DefaultWindowSize = 65535;
+static const uint32_t DefaultMaxFrameSize = 16384;	// also the largest frame accepted, as it is not raised
+static const uint32_t MaxWindowSize = 0x7FFFFFFF;
+static const int DefaultWeight = 16;
+
+enum FrameFlag { EndStream = 0x1, Ack = 0x1, EndHeaders = 0x4, Padded = 0x8, PriorityFlag = 0x20 };
+enum Setting { HeaderTableSize = 0x1, EnablePush = 0x2, MaxConcurrentStreamsSetting = 0x3,
+	InitialWindowSizeSetting = 0x4, MaxFrameSize = 0x5, MaxHeaderListSizeSetting = 0x6 };
+
+struct StaticEntry
+{
+	const char *name;
+	const char *value;
+};
+
+// RFC 7541 Appendix A
+static const StaticEntry StaticTable[] = {
+	{ ":authority", "" }, { ":method", "GET" }, { ":method", "POST" }, { ":path", "/" },
+	{ ":path", "/index.html" }, { ":scheme", "http" }, { ":scheme", "https" }, { ":status", "200" },
+	{ ":status", "204" }, { ":status", "206" }, { ":status", "304" }, { ":status", "400" },
+	{ ":status", "404" }, { ":status", "500" }, { "accept-charset", "" }, { "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" }, { "accept-ranges", "" }, { "accept", "" }, { "access-control-allow-origin", "" },
+	{ "age", "" }, { "allow", "" }, { "authorization", "" }, { "cache-control", "" },
+	{ "content-disposition", "" }, { "content-encoding", "" }, { "content-language", "" }, { "content-length", "" },
+	{ "content-location", "" }, { "content-range", "" }, { "content-type", "" }, { "cookie", "" },
+	{ "date", "" }, { "etag", "" }, { "expect", "" }, { "expires", "" },
+	{ "from", "" }, { "host", "" }, { "if-match", "" }, { "if-modified-since", "" },
+	{ "if-none-match", "" }, { "if-range", "" }, { "if-unmodified-since", "" }, { "last-modified", "" },
+	{ "link", "" }, { "location", "" }, { "max-forwards", "" }, { "proxy-authenticate", "" },
+	{ "proxy-authorization", "" }, { "range", "" }, { "referer", "" }, { "refresh", "" },
+	{ "retry-after", "" }, { "server", "" }, { "set-cookie", "" }, { "strict-transport-security", "" },
+	{ "transfer-encoding", "" }, { "user-agent", "" }, { "vary", "" }, { "via", "" },
+	{ "www-authenticate", "" }
+};
+
+static const size_t StaticTableSize = sizeof(StaticTable)/sizeof(StaticTable[0]);
+
+struct HuffmanCode
+{
+	uint32_t code;
+	uint8_t bits;
+};
+
+// RFC 7541 Appendix B, EOS is all ones over 30 bits
+static const HuffmanCode HuffmanCodes[256] = {
+	{ 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+	{ 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+	{ 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+	{ 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+	{ 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+	{ 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+	{ 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+	{ 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+	{ 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+	{ 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+	{ 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+	{ 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+	{ 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+	{ 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+	{ 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+	{ 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+	{ 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+	{ 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+	{ 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+	{ 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+	{ 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+	{ 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+	{ 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+	{ 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+	{ 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+	{ 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+	{ 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+	{ 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+	{ 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+	{ 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+	{ 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+	{ 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+	{ 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+	{ 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+	{ 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+	{ 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+	{ 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+	{ 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+	{ 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+	{ 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+	{ 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+	{ 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+	{ 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+	{ 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+	{ 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+	{ 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+	{ 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+	{ 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+	{ 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+	{ 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+	{ 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+	{ 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+	{ 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+	{ 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+	{ 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+	{ 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+	{ 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+	{ 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+	{ 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+	{ 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+	{ 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+	{ 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+	{ 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+	{ 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+};
+
+// Decodes a nibble at a time with an automaton built from the code tree
+// States are the internal nodes, no code is shorter than 5 bits so a nibble emits at most one symbol
+class HuffmanDecoder
+{
+public:
+	HuffmanDecoder(void)
+	{
+		// Build the tree, node 0 is the root
+		std::vector<Node> tree(1);
+		for(int symbol = 0; symbol <= 256; ++symbol)
+		{
+			uint32_t code = (symbol < 256 ? HuffmanCodes[symbol].code : 0x3FFFFFFF);
+			int bits = (symbol < 256 ? HuffmanCodes[symbol].bits : 30);
+			size_t node = 0;
+			for(int i = bits - 1; i >= 0; --i)
+			{
+				int bit = (code >> i) & 1;
+				if(!tree[node].children[bit])
+				{
+					tree[node].children[bit] = int(tree.size());
+					tree.push_back(Node());
+				}
+				node = tree[node].children[bit];
+			}
+			tree[node].symbol = symbol;
+		}
+
+		// Number internal nodes as states
+		std::vector<int> states(tree.size(), -1);
+		std::vector<size_t> nodes;
+		for(size_t i = 0; i < tree.size(); ++i)
+			if(tree[i].symbol < 0)
+			{
+				states[i] = int(nodes.size());
+				nodes.push_back(i);
+			}
+
+		mTransitions.resize(nodes.size()*16);
+		mAccepting.resize(nodes.size(), false);
+		markAccepting(tree, states, 0, 0);
+
+		for(size_t s = 0; s < nodes.size(); ++s)
+			for(int nibble = 0; nibble < 16; ++nibble)
+			{
+				Transition &t = mTransitions[s*16 + nibble];
+				t.symbol = -1;
+				t.fail = false;
+
+				size_t node = nodes[s];
+				for(int i = 3; i >= 0; --i)
+				{
+					node = tree[node].children[(nibble >> i) & 1];
+					if(tree[node].symbol >= 0)
+					{
+						if(tree[node].symbol == 256) t.fail = true;	// EOS must not be decoded
+						t.symbol = int16_t(tree[node].symbol);
+						node = 0;
+					}
+				}
+
+				t.state = uint16_t(states[node]);
+			}
+	}
+
+	bool decode(const uint8_t *data, size_t size, String &output) const
+	{
+		uint16_t state = 0;
+		for(size_t i = 0; i < size; ++i)
+		{
+			for(int shift = 4; shift >= 0; shift-= 4)
+			{
+				const Transition &t = mTransitions[state*16 + ((data[i] >> shift) & 0x0F)];
+				if(t.fail) return false;
+				if(t.symbol >= 0) output+= char(t.symbol);
+				state = t.state;
+			}
+		}
+
+		// Padding is a prefix of EOS shorter than a byte
+		return mAccepting[state];
+	}
+
+private:
+	struct Node
+	{
+		int children[2] = { 0, 0 };
+		int symbol = -1;
+	};
+
+	struct Transition
+	{
+		uint16_t state;
+		int16_t symbol;
+		bool fail;
+	};
+
+	void markAccepting(const std::vector<Node> &tree, const std::vector<int> &states, size_t node, int depth)
+	{
+		if(tree[node].symbol >= 0 || depth > 7) return;
+		mAccepting[states[node]] = true;
+		markAccepting(tree, states, tree[node].children[1], depth + 1);	// ones only
+	}
+
+	std::vector<Transition> mTransitions;	// by state and nibble
+	std::vector<bool> mAccepting;
+};
+
+static const HuffmanDecoder &GetHuffmanDecoder(void)
+{
+	static const HuffmanDecoder decoder;
+	return decoder;
+}
+
+static size_t HuffmanSize(const String &str)
+{
+	size_t bits = 0;
+	for(size_t i = 0; i < str.size(); ++i)
+		bits+= HuffmanCodes[uint8_t(str[i])].bits;
+	return (bits + 7)/8;
+}
+
+static void HuffmanEncode(const String &str, String &output)
+{
+	uint64_t bits = 0;
+	int count = 0;
+	for(size_t i = 0; i < str.size(); ++i)
+	{
+		const HuffmanCode &c = HuffmanCodes[uint8_t(str[i])];
+		bits = (bits << c.bits) | c.code;
+		count+= c.bits;
+		while(count >= 8)
+		{
+			count-= 8;
+			output+= char(bits >> count);
+		}
+
+		bits&= (uint64_t(1) << count) - 1;
+	}
+
+	if(count) output+= char((bits << (8 - count)) | (0xFF >> count));	// padded with the EOS prefix
+}
+
+// Fields with a value specific to each message are not worth a table entry
+static bool IsIndexable(const String &name)
+{
+	static const char *names[] = { ":path", "content-length", "content-range", "date", "etag", "last-modified",
+		"if-modified-since", "if-none-match", "location", "age", "expires", NULL };
+
+	for(int i = 0; names[i]; ++i)
+		if(name == names[i]) return false;
+	return true;
+}
+
+static bool IsSensitive(const String &name, const String &value)
+{
+	return name == "authorization" || name == "proxy-authorization" || name == "set-cookie"
+		|| (name == "cookie" && value.size() < 20);	// short cookies are easy to guess
+}
+
+Http2::Hpack::Hpack(void) :
+	mTableSize(0),
+	mCapacity(DefaultTableSize),
+	mMaxCapacity(DefaultTableSize),
+	mMinCapacity(DefaultTableSize),
+	mUpdatePending(false)
+{
+
+}
+
+Http2::Hpack::~Hpack(void)
+{
+
+}
+
+void Http2::Hpack::setMaxTableSize(size_t size)
+{
+	// The encoder does not need a larger table than the default
+	mMaxCapacity = size;
+	size_t capacity = std::min(size, DefaultTableSize);
+	if(capacity != mCapacity)
+	{
+		mMinCapacity = std::min(mMinCapacity, capacity);
+		mCapacity = capacity;
+		mUpdatePending = true;
+		evict(mCapacity);
+	}
+}
+
+void Http2::Hpack::encode(const headers_t &headers, String &output)
+{
+	if(mUpdatePending)
+	{
+		// The smallest size must be signaled so the peer evicts the same entries
+		if(mMinCapacity < mCapacity) EncodeInteger(uint32_t(mMinCapacity), 5, 0x20, output);
+		EncodeInteger(uint32_t(mCapacity), 5, 0x20, output);
+		mMinCapacity = mCapacity;
+		mUpdatePending = false;
+	}
+
+	for(headers_t::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		const String &name = it->first;
+		const String &value = it->second;
+
+		bool exact = false;
+		size_t index = find(name, value, exact);
+		if(exact)
+		{
+			EncodeInteger(uint32_t(index), 7, 0x80, output);
+			continue;
+		}
+
+		if(IsSensitive(name, value))
+		{
+			EncodeInteger(uint32_t(index), 4, 0x10, output);	// never indexed
+		}
+		else if(IsIndexable(name))
+		{
+			EncodeInteger(uint32_t(index), 6, 0x40, output);	// incremental indexing
+			insert(name, value);
+		}
+		else {
+			EncodeInteger(uint32_t(index), 4, 0x00, output);	// without indexing
+		}
+
+		if(!index) EncodeString(name, output);
+		EncodeString(value, output);
+	}
+}
+
+bool Http2::Hpack::decode(const char *data, size_t size, headers_t &headers, size_t maxListSize)
+{
+	const uint8_t *p = reinterpret_cast<const uint8_t*>(data);
+	const uint8_t *end = p + size;
+	size_t listSize = 0;
+	bool fields = false;
+	while(p != end)
+	{
+		uint8_t b = *p;
+		String name, value;
+		if(b & 0x80)	// indexed
+		{
+			uint32_t index = DecodeInteger(p, end, 7);
+			if(!index) throw Exception("Invalid HPACK index");
+			entry(index, name, value);
+		}
+		else if(b & 0x40)	// incremental indexing
+		{
+			uint32_t index = DecodeInteger(p, end, 6);
+			if(index) entry(index, name, value);
+			else name = DecodeString(p, end);
+			value = DecodeString(p, end);
+			insert(name, value);
+		}
+		else if(b & 0x20)	// dynamic table size update
+		{
+			uint32_t capacity = DecodeInteger(p, end, 5);
+			if(fields || capacity > mMaxCapacity) throw Exception("Invalid HPACK table size update");
+			mCapacity = capacity;
+			evict(mCapacity);
+			continue;
+		}
+		else {	// without indexing or never indexed
+			uint32_t index = DecodeInteger(p, end, 4);
+			if(index) entry(index, name, value);
+			else name = DecodeString(p, end);
+			value = DecodeString(p, end);
+		}
+
+		fields = true;
+		listSize+= name.size() + value.size() + 32;
+		if(!maxListSize || listSize <= maxListSize)
+			headers.push_back(std::make_pair(name, value));
+	}
+
+	return !maxListSize || listSize <= maxListSize;
+}
+
+void Http2::Hpack::EncodeInteger(uint32_t value, int prefix, uint8_t flags, String &output)
+{
+	uint32_t max = (uint32_t(1) << prefix) - 1;
+	if(value < max)
+	{
+		output+= char(flags | value);
+		return;
+	}
+
+	output+= char(flags | max);
+	value-= max;
+	while(value >= 0x80)
+	{
+		output+= char((value & 0x7F) | 0x80);
+		value>>= 7;
+	}
+
+	output+= char(value);
+}
+
+uint32_t Http2::Hpack::DecodeInteger(const uint8_t *&p, const uint8_t *end, int prefix)
+{
+	if(p == end) throw Exception("Truncated HPACK integer");
+
+	uint32_t max = (uint32_t(1) << prefix) - 1;
+	uint64_t value = *p++ & max;
+	if(value < max) return uint32_t(value);
+
+	int shift = 0;
+	while(true)
+	{
+		if(p == end) throw Exception("Truncated HPACK integer");
+		uint8_t b = *p++;
+		value+= uint64_t(b & 0x7F) << shift;
+		if(value > 0xFFFFFFFF) throw Exception("HPACK integer overflow");
+		if(!(b & 0x80)) break;
+		shift+= 7;
+		if(shift > 28) throw Exception("HPACK integer overflow");
+	}
+
+	return uint32_t(value);
+}
+
+void Http2::Hpack::EncodeString(const String &str, String &output)
+{
+	size_t size = HuffmanSize(str);
+	if(size < str.size())
+	{
+		EncodeInteger(uint32_t(size), 7, 0x80, output);
+		HuffmanEncode(str, output);
+	}
+	else {
+		EncodeInteger(uint32_t(str.size()), 7, 0x00, output);
+		output+= str;
+	}
+}
+
+String Http2::Hpack::DecodeString(const uint8_t *&p, const uint8_t *end)
+{
+	if(p == end) throw Exception("Truncated HPACK string");
+
+	bool huffman = (*p & 0x80) != 0;
+	uint32_t size = DecodeInteger(p, end, 7);
+	if(size > size_t(end - p)) throw Exception("Truncated HPACK string");
+
+	String str;
+	if(huffman)
+	{
+		str.reserve(size*8/5);
+		if(!GetHuffmanDecoder().decode(p, size, str))
+			throw Exception("Invalid Huffman code");
+	}
+	else {
+		str.assign(reinterpret_cast<const char*>(p), size);
+	}
+
+	p+= size;
+	return str;
+}
+
+size_t Http2::Hpack::find(const String &name, const String &value, bool &exact) const
+{
+	size_t index = 0;
+	exact = false;
+	for(size_t i = 0; i < StaticTableSize; ++i)
+	{
+		if(name != StaticTable[i].name) continue;
+		if(value == StaticTable[i].value)
+		{
+			exact = true;
+			return i + 1;
+		}
+
+		if(!index) index = i + 1;
+	}
+
+	for(size_t i = 0; i < mTable.size(); ++i)
+	{
+		if(mTable[i].name != name) continue;
+		if(mTable[i].value == value)
+		{
+			exact = true;
+			return StaticTableSize + i + 1;
+		}
+
+		if(!index) index = StaticTableSize + i + 1;
+	}
+
+	return index;
+}
+
+void Http2::Hpack::entry(size_t index, String &name, String &value) const
+{
+	if(index <= StaticTableSize)
+	{
+		name = StaticTable[index - 1].name;
+		value = StaticTable[index - 1].value;
+		return;
+	}
+
+	index-= StaticTableSize + 1;
+	if(index >= mTable.size()) throw Exception("Invalid HPACK index");
+	name = mTable[index].name;
+	value = mTable[index].value;
+}
+
+void Http2::Hpack::insert(const String &name, const String &value)
+{
+	// An entry larger than the table empties it
+	size_t size = name.size() + value.size() + 32;
+	if(size > mCapacity)
+	{
+		evict(0);
+		return;
+	}
+
+	evict(mCapacity - size);
+	Entry entry;
+	entry.name = name;
+	entry.value = value;
+	mTable.push_front(entry);
+	mTableSize+= size;
+}
+
+void Http2::Hpack::evict(size_t maxSize)
+{
+	while(mTableSize > maxSize)
+	{
+		const Entry &entry = mTable.back();
+		mTableSize-= entry.name.size() + entry.value.size() + 32;
+		mTable.pop_back();
+	}
+}
+
+static void AppendFrameHeader(String &output, size_t size, uint8_t type, uint8_t flags, uint32_t id)
+{
+	char header[9] = { char(size >> 16), char(size >> 8), char(size), char(type), char(flags),
+		char((id >> 24) & 0x7F), char(id >> 16), char(id >> 8), char(id) };
+	output.append(header, 9);
+}
+
+static uint32_t ReadUint32(const char *p)
+{
+	const uint8_t *u = reinterpret_cast<const uint8_t*>(p);
+	return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+static void AppendUint32(String &output, uint32_t value)
+{
+	char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+	output.append(bytes, 4);
+}
+
+Http2::Channel::Channel(sptr<Session> session, uint32_t id) :
+	mSession(session),
+	mId(id),
+	mHeadersReceived(false),
+	mInputClosed(false),
+	mRecvWindow(InitialWindowSize),
+	mRecvConsumed(0),
+	mOutputClosed(false),
+	mHeadersSent(false),
+	mEndSent(false),
+	mSendWindow(session->mPeerInitialWindow),
+	mError(NoError),
+	mReset(false),
+	mParent(0),
+	mWeight(DefaultWeight),
+	mPass(0)
+{
+
+}
+
+Http2::Channel::~Channel(void)
+{
+
+}
+
+uint32_t Http2::Channel::id(void) const
+{
+	return mId;
+}
+
+void Http2::Channel::sendHeaders(const headers_t &headers, bool end)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(mReset) throw NetException("HTTP/2 stream reset");
+	if(mHeadersSent) throw Exception("HTTP/2 trailers are not supported");
+
+	// Interim responses are followed by the final one
+	bool interim = (mSession->mServer && !headers.empty() && headers[0].first == ":status" && headers[0].second[0] == '1');
+	if(interim) end = false;
+
+	if(!mSession->mServer && !mId)
+	{
+		// Streams must be opened in order, so identifiers are assigned as headers are queued
+		if(!mSession->mCondition.wait_for(lock, Http::RequestTimeout, [this]()
+		{
+			return mSession->mClosed || mSession->mGoAwayReceived
+				|| mSession->mChannels.size() < mSession->mPeerMaxStreams;
+		}))
+			throw Timeout();
+
+		if(mSession->mClosed || mSession->mGoAwayReceived)
+			throw NetException("HTTP/2 connection is closing");
+
+		mId = mSession->mNextStreamId;
+		mSession->mNextStreamId+= 2;
+		mSession->mChannels[mId] = shared_from_this();
+	}
+
+	mSession->queueHeaders(this, headers, end);
+	if(!interim) mHeadersSent = true;
+	mSession->notify(lock);
+}
+
+const Http2::headers_t &Http2::Channel::headers(void)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(!mSession->mCondition.wait_for(lock, Http::RequestTimeout, [this]()
+	{
+		return mHeadersReceived || mReset;
+	}))
+		throw Timeout();
+
+	if(!mHeadersReceived) throw NetException("HTTP/2 stream reset");
+	return mHeaders;
+}
+
+void Http2::Channel::reset(uint32_t error)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(mReset) return;
+
+	if(mId) mSession->resetStream(mId, error);
+	mReset = true;
+	mError = error;
+	mSession->notify(lock);
+}
+
+size_t Http2::Channel::readData(char *buffer, size_t size)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(!mSession->mCondition.wait_for(lock, Http::RequestTimeout, [this]()
+	{
+		return !mInput.empty() || mInputClosed || mReset;
+	}))
+		throw Timeout();
+
+	if(mInput.empty())
+	{
+		if(!mInputClosed) throw NetException("HTTP/2 stream reset");
+		return 0;
+	}
+
+	size = mInput.readData(buffer, size);
+
+	// The window is reopened as the application consumes data
+	if(mSession->consumed(this, size)) mSession->notify(lock);
+	return size;
+}
+
+void Http2::Channel::writeData(const char *data, size_t size)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(!mHeadersSent) throw Exception("HTTP/2 data written before headers");
+
+	while(size)
+	{
+		if(!mSession->mCondition.wait_for(lock, Http::RequestTimeout, [this]()
+		{
+			return mReset || mOutputClosed || mOutput.size() < WriteBufferSize;
+		}))
+			throw Timeout();
+
+		if(mReset) throw NetException("HTTP/2 stream reset");
+		if(mOutputClosed) return;	// e.g. the response to a HEAD request
+
+		size_t len = std::min(size, WriteBufferSize - mOutput.size());
+		mOutput.append(data, len);
+		data+= len;
+		size-= len;
+
+		// Writes are coalesced until a frame is full or the stream is flushed
+		if(mOutput.size() >= DefaultMaxFrameSize)
+		{
+			mSession->notify(lock);
+			lock.lock();
+		}
+	}
+}
+
+bool Http2::Channel::waitData(duration timeout)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	mSession->mCondition.wait_for(lock, timeout, [this]()
+	{
+		return !mInput.empty() || mInputClosed || mReset;
+	});
+
+	return !mInput.empty();
+}
+
+void Http2::Channel::flush(void)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	mSession->notify(lock);
+}
+
+void Http2::Channel::close(void)
+{
+	std::unique_lock<std::mutex> lock(mSession->mMutex);
+	if(mReset || mOutputClosed) return;
+
+	if(!mHeadersSent)
+	{
+		// A request without response, or a request never sent
+		if(mId) mSession->resetStream(mId, mSession->mServer ? InternalError : Cancel);
+		mReset = true;
+		mSession->notify(lock);
+		return;
+	}
+
+	mOutputClosed = true;
+	mSession->notify(lock);
+}
+
+bool Http2::Channel::isReady(bool windowOpen) const
+{
+	if(!mHeadersSent || mEndSent || mReset) return false;
+	if(!mOutput.empty()) return windowOpen && mSendWindow > 0;
+	return mOutputClosed;	// an empty frame ends the stream
+}
+
+bool Http2::Channel::isOver(void) const
+{
+	return mReset || (mInputClosed && mEndSent);
+}
+
+Http2::Session::Session(bool server) :
+	mServer(server),
+	mNextStreamId(server ? 2 : 1),
+	mLastStreamId(0),
+	mOpenedStreams(0),
+	mPrefaceReceived(!server),
+	mHeaderStream(0),
+	mHeaderFlags(0),
+	mHeaderParent(0),
+	mHeaderWeight(0),
+	mHeaderExclusive(false),
+	mSendWindow(DefaultWindowSize),
+	mRecvConsumed(0),
+	mPeerInitialWindow(DefaultWindowSize),
+	mPeerMaxFrameSize(DefaultMaxFrameSize),
+	mPeerMaxStreams(MaxConcurrentStreams),	// until the peer tells
+	mPass(0),
+	mGoAwaySent(false),
+	mGoAwayReceived(false),
+	mClosed(false)
+{
+	if(!mServer) mOutput.append(Preface, PrefaceSize);
+
+	std::vector<std::pair<uint16_t, uint32_t> > values;
+	values.push_back(std::make_pair(uint16_t(MaxConcurrentStreamsSetting), MaxConcurrentStreams));
+	values.push_back(std::make_pair(uint16_t(InitialWindowSizeSetting), InitialWindowSize));
+	values.push_back(std::make_pair(uint16_t(MaxHeaderListSizeSetting), uint32_t(MaxHeaderListSize)));
+	if(!mServer) values.push_back(std::make_pair(uint16_t(EnablePush), uint32_t(0)));
+
+	String settings;
+	for(size_t i = 0; i < values.size(); ++i)
+	{
+		settings+= char(values[i].first >> 8);
+		settings+= char(values[i].first);
+		AppendUint32(settings, values[i].second);
+	}
+
+	queueFrame(Settings, 0, 0, settings.data(), settings.size());
+
+	// The connection window can only be enlarged with an update
+	if(ConnectionWindowSize > DefaultWindowSize)
+		queueWindowUpdate(0, ConnectionWindowSize - DefaultWindowSize);
+}
+
+Http2::Session::~Session(void)
+{
+
+}
+
+void Http2::Session::setRequestHandler(handler_t handler)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mRequestHandler = handler;
+}
+
+void Http2::Session::setOutputHandler(std::function<void()> handler)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mOutputHandler = handler;
+}
+
+sptr<Http2::Channel> Http2::Session::open(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mServer) throw Exception("HTTP/2 server push is not supported");
+	if(mClosed || mGoAwayReceived) throw NetException("HTTP/2 connection is closing");
+
+	return sptr<Channel>(new Channel(shared_from_this(), 0));	// the identifier is assigned when sending headers
+}
+
+void Http2::Session::receive(const char *data, size_t size)
+{
+	std::vector<sptr<Channel> > requests;
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mClosed) return;
+
+	// Frames are parsed in place unless a partial one is buffered
+	if(!mInput.empty())
+	{
+		mInput.append(data, size);
+		data = mInput.data();
+		size = mInput.size();
+	}
+
+	size_t offset = 0;
+	if(!mPrefaceReceived)
+	{
+		size_t len = std::min(size, PrefaceSize);
+		if(std::memcmp(data, Preface, len) != 0)
+		{
+			fail(ProtocolError, "Invalid connection preface");
+			notify(lock);
+			return;
+		}
+
+		if(len == PrefaceSize)
+		{
+			mPrefaceReceived = true;
+			offset = PrefaceSize;
+		}
+		else {
+			if(data != mInput.data()) mInput.assign(data, size);
+			notify(lock);
+			return;
+		}
+	}
+
+	while(!mClosed && size - offset >= 9)
+	{
+		const char *header = data + offset;
+		size_t len = (size_t(uint8_t(header[0])) << 16) | (size_t(uint8_t(header[1])) << 8) | size_t(uint8_t(header[2]));
+		if(len > DefaultMaxFrameSize)
+		{
+			fail(FrameSizeError, "Frame too large");
+			break;
+		}
+
+		if(size - offset < 9 + len) break;
+
+		uint8_t type = uint8_t(header[3]);
+		uint8_t flags = uint8_t(header[4]);
+		uint32_t id = ReadUint32(header + 5) & 0x7FFFFFFF;
+		processFrame(type, flags, id, header + 9, len, requests);
+		offset+= 9 + len;
+	}
+
+	if(mClosed) mInput.clear();
+	else if(data == mInput.data()) mInput.erase(0, offset);
+	else mInput.assign(data + offset, size - offset);
+
+	handler_t handler = mRequestHandler;
+	notify(lock);
+
+	if(handler)
+		for(size_t i = 0; i < requests.size(); ++i)
+			handler(requests[i]);
+}
+
+bool Http2::Session::pull(String &output, size_t limit)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	bool any = !mOutput.empty();
+	output+= mOutput;
+	mOutput.clear();
+
+	while(!mClosed && output.size() < limit)
+	{
+		Channel *channel = pick();
+		if(!channel) break;
+
+		size_t available = channel->mOutput.size();
+		size_t len = std::min(available, size_t(mPeerMaxFrameSize));
+		if(len)
+		{
+			len = std::min(len, size_t(channel->mSendWindow));
+			len = std::min(len, size_t(mSendWindow));
+		}
+
+		bool end = (channel->mOutputClosed && len == available);
+		AppendFrameHeader(output, len, Data, end ? EndStream : 0, channel->mId);
+		output.append(channel->mOutput.data(), len);
+		channel->mOutput.consume(len);
+		channel->mSendWindow-= len;
+		mSendWindow-= len;
+
+		// Stride scheduling, streams advance in proportion to the inverse of their weight
+		mPass = std::max(mPass, channel->mPass);
+		channel->mPass = mPass + (uint64_t(len) + 9)*256/uint64_t(channel->mWeight);
+
+		if(end)
+		{
+			channel->mEndSent = true;
+
+			// The rest of an unread request body is refused once the response is complete
+			if(mServer && !channel->mInputClosed)
+				resetStream(channel->mId, NoError);
+			else if(channel->isOver())
+				remove(channel->mId);
+		}
+
+		any = true;
+	}
+
+	// Resets queued when responses ended
+	output+= mOutput;
+	mOutput.clear();
+
+	if(any) mCondition.notify_all();	// writers might wait for buffer space
+	return any;
+}
+
+void Http2::Session::close(uint32_t error)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if(mClosed) return;
+
+	if(!mGoAwaySent)
+	{
+		String payload;
+		AppendUint32(payload, mLastStreamId);
+		AppendUint32(payload, error);
+		queueFrame(GoAway, 0, 0, payload.data(), payload.size());
+		mGoAwaySent = true;
+	}
+
+	mClosed = true;
+	for(auto it = mChannels.begin(); it != mChannels.end(); ++it)
+	{
+		Channel *channel = it->second.get();
+		if(!channel->isOver())
+		{
+			channel->mReset = true;
+			channel->mError = Cancel;
+		}
+	}
+
+	mChannels.clear();
+	mCondition.notify_all();
+	notify(lock);
+}
+
+bool Http2::Session::isClosed(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mClosed;
+}
+
+bool Http2::Session::isIdle(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mChannels.empty();
+}
+
+bool Http2::Session::hasOutput(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return !mOutput.empty() || (!mClosed && pick());
+}
+
+void Http2::Session::processFrame(uint8_t type, uint8_t flags, uint32_t id, const char *payload, size_t size, std::vector<sptr<Channel> > &requests)
+{
+	// A header block can't be interleaved with other frames
+	if(mHeaderStream && (type != Continuation || id != mHeaderStream))
+	{
+		fail(ProtocolError, "Expected CONTINUATION frame");
+		return;
+	}
+
+	// Streams are idle until opened, identifiers are odd for clients and even for servers
+	bool local = ((id % 2 == 0) == mServer);
+	bool idle = (local ? id >= mNextStreamId : id > mLastStreamId);
+
+	auto it = mChannels.find(id);
+	Channel *channel = (it != mChannels.end() ? it->second.get() : NULL);
+
+	switch(type)
+	{
+	case Data:
+	{
+		if(!id || idle)
+		{
+			fail(ProtocolError, "DATA frame on idle stream");
+			return;
+		}
+
+		// The whole frame counts for flow control, including padding
+		if(size > ConnectionWindowSize - mRecvConsumed)
+		{
+			fail(FlowControlError, "Connection window exceeded");
+			return;
+		}
+
+		mRecvConsumed+= uint32_t(size);
+		if(mRecvConsumed >= ConnectionWindowSize/2)
+		{
+			queueWindowUpdate(0, mRecvConsumed);
+			mRecvConsumed = 0;
+		}
+
+		size_t padding = 0;
+		if(flags & Padded)
+		{
+			if(size < 1 || uint8_t(payload[0]) >= size)
+			{
+				fail(ProtocolError, "Invalid padding");
+				return;
+			}
+
+			padding = uint8_t(payload[0]) + 1;
+		}
+
+		if(!channel || channel->mInputClosed)
+		{
+			if(!channel || !channel->mReset) resetStream(id, StreamClosed);
+			return;
+		}
+
+		if(size > channel->mRecvWindow)
+		{
+			resetStream(id, FlowControlError);
+			return;
+		}
+
+		channel->mRecvWindow-= uint32_t(size);
+		channel->mInput.append(payload + (padding ? 1 : 0), size - padding);
+		channel->mRecvConsumed+= uint32_t(padding);
+		if(flags & EndStream) channel->mInputClosed = true;
+
+		mCondition.notify_all();
+		if(channel->isOver()) remove(id);
+		break;
+	}
+
+	case Headers:
+	{
+		if(!id)
+		{
+			fail(ProtocolError, "HEADERS frame on stream 0");
+			return;
+		}
+
+		size_t offset = 0;
+		size_t padding = 0;
+		if(flags & Padded)
+		{
+			if(size < 1)
+			{
+				fail(ProtocolError, "Invalid padding");
+				return;
+			}
+
+			padding = uint8_t(payload[0]);
+			offset = 1;
+		}
+
+		mHeaderWeight = 0;
+		if(flags & PriorityFlag)
+		{
+			if(size < offset + 5)
+			{
+				fail(FrameSizeError, "Invalid HEADERS frame");
+				return;
+			}
+
+			uint32_t dependency = ReadUint32(payload + offset);
+			mHeaderExclusive = (dependency & 0x80000000) != 0;
+			mHeaderParent = dependency & 0x7FFFFFFF;
+			mHeaderWeight = int(uint8_t(payload[offset + 4])) + 1;
+			offset+= 5;
+		}
+
+		if(offset + padding > size)
+		{
+			fail(ProtocolError, "Invalid padding");
+			return;
+		}
+
+		mHeaderBlock.assign(payload + offset, size - offset - padding);
+		mHeaderStream = id;
+		mHeaderFlags = flags;
+		if(flags & EndHeaders) processHeaders(id, flags, requests);
+		break;
+	}
+
+	case Continuation:
+	{
+		if(!mHeaderStream)
+		{
+			fail(ProtocolError, "Unexpected CONTINUATION frame");
+			return;
+		}
+
+		// Bounds the memory held by a block, as it must be decoded entirely
+		if(mHeaderBlock.size() + size > 2*MaxHeaderListSize + DefaultMaxFrameSize)
+		{
+			fail(EnhanceYourCalm, "Header block too large");
+			return;
+		}
+
+		mHeaderBlock.append(payload, size);
+		if(flags & EndHeaders) processHeaders(id, mHeaderFlags, requests);
+		break;
+	}
+
+	case Priority:
+	{
+		if(!id)
+		{
+			fail(ProtocolError, "PRIORITY frame on stream 0");
+			return;
+		}
+
+		if(size != 5)
+		{
+			resetStream(id, FrameSizeError);
+			return;
+		}
+
+		uint32_t dependency = ReadUint32(payload);
+		if((dependency & 0x7FFFFFFF) == id)
+		{
+			resetStream(id, ProtocolError);
+			return;
+		}
+
+		if(channel) setPriority(channel, dependency & 0x7FFFFFFF, int(uint8_t(payload[4])) + 1, (dependency & 0x80000000) != 0);
+		break;
+	}
+
+	case RstStream:
+	{
+		if(!id || idle)
+		{
+			fail(ProtocolError, "RST_STREAM frame on idle stream");
+			return;
+		}
+
+		if(size != 4)
+		{
+			fail(FrameSizeError, "Invalid RST_STREAM frame");
+			return;
+		}
+
+		if(channel)
+		{
+			channel->mReset = true;
+			channel->mError = ReadUint32(payload);
+			mCondition.notify_all();
+			remove(id);
+		}
+		break;
+	}
+
+	case Settings:
+	{
+		if(id)
+		{
+			fail(ProtocolError, "SETTINGS frame on a stream");
+			return;
+		}
+
+		processSettings(flags, payload, size);
+		break;
+	}
+
+	case PushPromise:
+	{
+		fail(ProtocolError, "Server push is disabled");
+		break;
+	}
+
+	case Ping:
+	{
+		if(id)
+		{
+			fail(ProtocolError, "PING frame on a stream");
+			return;
+		}
+
+		if(size != 8)
+		{
+			fail(FrameSizeError, "Invalid PING frame");
+			return;
+		}
+
+		if(!(flags & Ack)) queueFrame(Ping, Ack, 0, payload, size);
+		break;
+	}
+
+	case GoAway:
+	{
+		if(id)
+		{
+			fail(ProtocolError, "GOAWAY frame on a stream");
+			return;
+		}
+
+		if(size < 8)
+		{
+			fail(FrameSizeError, "Invalid GOAWAY frame");
+			return;
+		}
+
+		// Streams above the last one processed by the peer can be retried elsewhere
+		uint32_t last = ReadUint32(payload) & 0x7FFFFFFF;
+		mGoAwayReceived = true;
+
+		std::vector<uint32_t> refused;
+		for(auto jt = mChannels.begin(); jt != mChannels.end(); ++jt)
+			if(jt->first > last && (jt->first % 2 == 0) == mServer)
+				refused.push_back(jt->first);
+
+		for(size_t i = 0; i < refused.size(); ++i)
+		{
+			Channel *c = mChannels[refused[i]].get();
+			c->mReset = true;
+			c->mError = RefusedStream;
+			remove(refused[i]);
+		}
+
+		mCondition.notify_all();
+		break;
+	}
+
+	case WindowUpdate:
+	{
+		if(size != 4)
+		{
+			fail(FrameSizeError, "Invalid WINDOW_UPDATE frame");
+			return;
+		}
+
+		uint32_t increment = ReadUint32(payload) & 0x7FFFFFFF;
+		if(!id)
+		{
+			if(!increment || mSendWindow + increment > MaxWindowSize)
+			{
+				fail(increment ? FlowControlError : ProtocolError, "Invalid connection window update");
+				return;
+			}
+
+			mSendWindow+= increment;
+		}
+		else if(idle)
+		{
+			fail(ProtocolError, "WINDOW_UPDATE frame on idle stream");
+			return;
+		}
+		else if(channel)
+		{
+			if(!increment || channel->mSendWindow + increment > MaxWindowSize)
+			{
+				resetStream(id, increment ? FlowControlError : ProtocolError);
+				return;
+			}
+
+			channel->mSendWindow+= increment;
+		}
+		break;
+	}
+
+	default:
+		break;	// unknown frames are ignored
+	}
+}
+
+void Http2::Session::processHeaders(uint32_t id, uint8_t flags, std::vector<sptr<Channel> > &requests)
+{
+	headers_t headers;
+	bool complete;
+	try {
+		complete = mDecoder.decode(mHeaderBlock.data(), mHeaderBlock.size(), headers, MaxHeaderListSize);
+	}
+	catch(const Exception &e)
+	{
+		fail(CompressionError, e.what());
+		return;
+	}
+
+	mHeaderBlock.clear();
+	mHeaderStream = 0;
+
+	bool end = (flags & EndStream) != 0;
+	auto it = mChannels.find(id);
+	if(it == mChannels.end())
+	{
+		bool local = ((id % 2 == 0) == mServer);
+		if(!mServer || local || id <= mLastStreamId)
+		{
+			// Frames of a stream closed or reset recently are ignored
+			if(local ? id >= mNextStreamId : id > mLastStreamId)
+				fail(ProtocolError, "HEADERS frame on idle stream");
+			return;
+		}
+
+		mLastStreamId = id;
+		if(mGoAwaySent) return;
+
+		if(mHeaderWeight && mHeaderParent == id)
+		{
+			resetStream(id, ProtocolError);
+			return;
+		}
+
+		if(mOpenedStreams >= MaxConcurrentStreams)
+		{
+			resetStream(id, RefusedStream);
+			return;
+		}
+
+		if(!complete || !validate(headers, true))
+		{
+			resetStream(id, ProtocolError);
+			return;
+		}
+
+		sptr<Channel> channel(new Channel(shared_from_this(), id));
+		channel->mHeaders.swap(headers);
+		channel->mHeadersReceived = true;
+		channel->mInputClosed = end;
+		mChannels[id] = channel;
+		++mOpenedStreams;
+
+		if(mHeaderWeight)
+		{
+			setPriority(channel.get(), mHeaderParent, mHeaderWeight, mHeaderExclusive);
+		}
+		else {
+			// Extensible priorities (RFC 9218), urgency from 0 to 7 maps to weights from 256 to 2
+			for(size_t i = 0; i < channel->mHeaders.size(); ++i)
+			{
+				if(channel->mHeaders[i].first != "priority") continue;
+				String value = channel->mHeaders[i].second;
+				int p = value.find("u=");
+				if(p != String::NotFound && p + 2 < int(value.size()) && value[p+2] >= '0' && value[p+2] <= '7')
+					channel->mWeight = 256 >> (value[p+2] - '0');
+			}
+		}
+
+		requests.push_back(channel);
+		return;
+	}
+
+	Channel *channel = it->second.get();
+	if(channel->mInputClosed)
+	{
+		resetStream(id, StreamClosed);
+		return;
+	}
+
+	if(!channel->mHeadersReceived)
+	{
+		if(!complete || !validate(headers, false))
+		{
+			resetStream(id, ProtocolError);
+			return;
+		}
+
+		// Interim responses are ignored
+		if(headers[0].second[0] != '1')
+		{
+			channel->mHeaders.swap(headers);
+			channel->mHeadersReceived = true;
+		}
+		else if(end)
+		{
+			resetStream(id, ProtocolError);
+			return;
+		}
+	}
+	else if(!end)
+	{
+		resetStream(id, ProtocolError);	// trailers must end the stream
+		return;
+	}
+
+	if(mHeaderWeight) setPriority(channel, mHeaderParent, mHeaderWeight, mHeaderExclusive);
+	if(end) channel->mInputClosed = true;
+
+	mCondition.notify_all();
+	if(channel->isOver()) remove(id);
+}
+
+void Http2::Session::processSettings(uint8_t flags, const char *payload, size_t size)
+{
+	if(flags & Ack)
+	{
+		if(size) fail(FrameSizeError, "Invalid SETTINGS acknowledgement");
+		return;
+	}
+
+	if(size % 6)
+	{
+		fail(FrameSizeError, "Invalid SETTINGS frame");
+		return;
+	}
+
+	for(size_t i = 0; i < size; i+= 6)
+	{
+		uint16_t setting = uint16_t((uint8_t(payload[i]) << 8) | uint8_t(payload[i+1]));
+		uint32_t value = ReadUint32(payload + i + 2);
+		switch(setting)
+		{
+		case HeaderTableSize:
+			mEncoder.setMaxTableSize(value);
+			break;
+
+		case EnablePush:
+			if(value > 1 || (!mServer && value))
+			{
+				fail(ProtocolError, "Invalid SETTINGS_ENABLE_PUSH");
+				return;
+			}
+			break;
+
+		case MaxConcurrentStreamsSetting:
+			mPeerMaxStreams = value;
+			mCondition.notify_all();
+			break;
+
+		case InitialWindowSizeSetting:
+		{
+			if(value > MaxWindowSize)
+			{
+				fail(FlowControlError, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+				return;
+			}
+
+			// Open streams are adjusted by the difference
+			int64_t delta = int64_t(value) - int64_t(mPeerInitialWindow);
+			for(auto it = mChannels.begin(); it != mChannels.end(); ++it)
+			{
+				it->second->mSendWindow+= delta;
+				if(it->second->mSendWindow > MaxWindowSize)
+				{
+					fail(FlowControlError, "Stream window overflow");
+					return;
+				}
+			}
+
+			mPeerInitialWindow = value;
+			break;
+		}
+
+		case MaxFrameSize:
+			if(value < DefaultMaxFrameSize || value > 0xFFFFFF)
+			{
+				fail(ProtocolError, "Invalid SETTINGS_MAX_FRAME_SIZE");
+				return;
+			}
+
+			mPeerMaxFrameSize = value;
+			break;
+
+		default:
+			break;	// SETTINGS_MAX_HEADER_LIST_SIZE is advisory, unknown settings are ignored
+		}
+	}
+
+	queueFrame(Settings, Ack, 0);
+}
+
+void Http2::Session::setPriority(Channel *channel, uint32_t parent, int weight, bool exclusive)
+{
+	// A stream depending on one of its descendants moves the descendant up first
+	uint32_t ancestor = parent;
+	for(int depth = 0; ancestor && depth < 256; ++depth)
+	{
+		auto it = mChannels.find(ancestor);
+		if(it == mChannels.end()) break;
+		if(it->second->mParent == channel->mId)
+		{
+			it->second->mParent = channel->mParent;
+			break;
+		}
+
+		ancestor = it->second->mParent;
+	}
+
+	if(exclusive)
+	{
+		for(auto it = mChannels.begin(); it != mChannels.end(); ++it)
+			if(it->second.get() != channel && it->second->mParent == parent)
+				it->second->mParent = channel->mId;
+	}
+
+	channel->mParent = parent;
+	channel->mWeight = weight;
+}
+
+bool Http2::Session::validate(const headers_t &headers, bool request) const
+{
+	bool regular = false;
+	int method = 0, scheme = 0, path = 0, authority = 0, status = 0;
+	for(headers_t::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		const String &name = it->first;
+		const String &value = it->second;
+		if(name.empty()) return false;
+
+		// Values must not smuggle other fields when converted to HTTP/1
+		for(size_t i = 0; i < value.size(); ++i)
+			if(value[i] == '\0' || value[i] == '\r' || value[i] == '\n')
+				return false;
+
+		if(name[0] == ':')
+		{
+			if(regular) return false;	// pseudo-headers come first
+			if(request)
+			{
+				if(name == ":method") ++method;
+				else if(name == ":scheme") ++scheme;
+				else if(name == ":path") { ++path; if(value.empty()) return false; }
+				else if(name == ":authority") ++authority;
+				else return false;
+			}
+			else {
+				if(name != ":status" || value.size() != 3 || value[0] < '1' || value[0] > '5') return false;
+				++status;
+			}
+			continue;
+		}
+
+		regular = true;
+		for(size_t i = 0; i < name.size(); ++i)
+		{
+			char c = name[i];
+			if((c >= 'A' && c <= 'Z') || c <= ' ' || c == ':' || c == 0x7F)
+				return false;
+		}
+
+		if(name == "connection" || name == "keep-alive" || name == "proxy-connection"
+			|| name == "transfer-encoding" || name == "upgrade")
+			return false;
+
+		if(name == "te" && value != "trailers")
+			return false;
+	}
+
+	if(request) return method == 1 && scheme == 1 && path == 1 && authority <= 1;
+	else return status == 1;
+}
+
+void Http2::Session::queueFrame(uint8_t type, uint8_t flags, uint32_t id, const char *payload, size_t size)
+{
+	AppendFrameHeader(mOutput, size, type, flags, id);
+	if(size) mOutput.append(payload, size);
+}
+
+void Http2::Session::queueHeaders(Channel *channel, const headers_t &headers, bool end)
+{
+	// Blocks are encoded in the order they are sent, as the compression context depends on it
+	String block;
+	mEncoder.encode(headers, block);
+
+	size_t offset = 0;
+	do {
+		size_t len = std::min(block.size() - offset, size_t(mPeerMaxFrameSize));
+		bool last = (offset + len == block.size());
+		uint8_t flags = (last ? EndHeaders : 0);
+		if(offset == 0 && end) flags|= EndStream;
+		queueFrame(offset == 0 ? Headers : Continuation, flags, channel->mId, block.data() + offset, len);
+		offset+= len;
+	}
+	while(offset < block.size());
+
+	if(end)
+	{
+		channel->mOutputClosed = true;
+		channel->mEndSent = true;
+
+		if(mServer && !channel->mInputClosed)
+			resetStream(channel->mId, NoError);
+		else if(channel->isOver())
+			remove(channel->mId);
+	}
+}
+
+void Http2::Session::queueWindowUpdate(uint32_t id, uint32_t increment)
+{
+	String payload;
+	AppendUint32(payload, increment);
+	queueFrame(WindowUpdate, 0, id, payload.data(), payload.size());
+}
+
+void Http2::Session::resetStream(uint32_t id, uint32_t error)
+{
+	String payload;
+	AppendUint32(payload, error);
+	queueFrame(RstStream, 0, id, payload.data(), payload.size());
+
+	auto it = mChannels.find(id);
+	if(it != mChannels.end())
+	{
+		Channel *channel = it->second.get();
+		if(!channel->isOver())
+		{
+			channel->mReset = true;
+			channel->mError = error;
+		}
+
+		channel->mOutput.clear();
+		mCondition.notify_all();
+		remove(id);
+	}
+}
+
+void Http2::Session::fail(uint32_t error, const String &reason)
+{
+	LogDebug("Http2::Session", "Connection error: " + reason);
+
+	String payload;
+	AppendUint32(payload, mLastStreamId);
+	AppendUint32(payload, error);
+	payload+= reason;
+	queueFrame(GoAway, 0, 0, payload.data(), payload.size());
+	mGoAwaySent = true;
+	mClosed = true;
+
+	for(auto it = mChannels.begin(); it != mChannels.end(); ++it)
+	{
+		Channel *channel = it->second.get();
+		if(!channel->isOver())
+		{
+			channel->mReset = true;
+			channel->mError = error;
+		}
+	}
+
+	mChannels.clear();
+	mOpenedStreams = 0;
+	mCondition.notify_all();
+}
+
+bool Http2::Session::consumed(Channel *channel, size_t size)
+{
+	channel->mRecvConsumed+= uint32_t(size);
+	if(channel->mInputClosed || channel->mReset || mClosed) return false;
+	if(channel->mRecvConsumed < InitialWindowSize/2) return false;
+
+	queueWindowUpdate(channel->mId, channel->mRecvConsumed);
+	channel->mRecvWindow+= channel->mRecvConsumed;
+	channel->mRecvConsumed = 0;
+	return true;
+}
+
+void Http2::Session::remove(uint32_t id)
+{
+	auto it = mChannels.find(id);
+	if(it == mChannels.end()) return;
+
+	if((id % 2 == 0) != mServer) --mOpenedStreams;
+	mChannels.erase(it);
+	mCondition.notify_all();	// a local stream might be waiting for the concurrency limit
+}
+
+Http2::Channel *Http2::Session::pick(void) const
+{
+	// A stream can't send while one of its ancestors can, siblings share by weight
+	bool windowOpen = (mSendWindow > 0);
+	Channel *best = NULL;
+	uint64_t bestPass = 0;
+	for(auto it = mChannels.begin(); it != mChannels.end(); ++it)
+	{
+		Channel *channel = it->second.get();
+		if(!channel->isReady(windowOpen)) continue;
+
+		bool blocked = false;
+		uint32_t parent = channel->mParent;
+		for(int depth = 0; parent && depth < 256; ++depth)
+		{
+			auto jt = mChannels.find(parent);
+			if(jt == mChannels.end()) break;
+			if(jt->second->isReady(windowOpen))
+			{
+				blocked = true;
+				break;
+			}
+
+			parent = jt->second->mParent;
+		}
+
+		if(blocked) continue;
+
+		uint64_t pass = std::max(channel->mPass, mPass);	// streams idle for a while start from now
+		if(!best || pass < bestPass)
+		{
+			best = channel;
+			bestPass = pass;
+		}
+	}
+
+	return best;
+}
+
+void Http2::Session::notify(std::unique_lock<std::mutex> &lock)
+{
+	bool pending = !mOutput.empty() || (!mClosed && pick());
+	std::function<void()> handler = mOutputHandler;
+	lock.unlock();
+
+	if(pending && handler) handler();
+}
+
+Http2::Client::Client(const String &host, bool secure) :
+	mStream(NULL),
+	mOutputPending(false),
+	mStopping(false)
+{
+	List<Address> addrs;
+	if(!Address::Resolve(host, addrs, secure ? "https" : "http"))
+		throw NetException("Unable to resolve: " + host);
+
+	Socket *sock = new Socket;
+	try {
+		sock->setConnectTimeout(Http::ConnectTimeout);
+		for(List<Address>::iterator it = addrs.begin(); it != addrs.end(); ++it)
+		{
+			try {
+				sock->connect(*it, true);
+				break;
+			}
+			catch(const NetException &e)
+			{
+				// Connection failed for this address
+			}
+		}
+
+		if(!sock->isConnected())
+			throw NetException("Connection to " + host + " failed");
+
+		sock->setNoDelay(true);
+		mStream = sock;
+
+		if(secure)
+		{
+			SecureTransportClient *transport = new SecureTransportClient(sock, NULL, host);
+			mStream = transport;	// sock is now owned by transport
+
+			List<String> protocols;
+			protocols.push_back("h2");
+			transport->setProtocols(protocols);
+			transport->setHandshakeTimeout(Http::ConnectTimeout);
+			transport->addCredentials(new SecureTransportClient::Certificate, true);
+			transport->handshake();
+
+			if(transport->getProtocol() != "h2")
+				throw NetException("HTTP/2 is not supported by " + host);
+		}
+	}
+	catch(...)
+	{
+		if(mStream) delete mStream;
+		else delete sock;
+		throw;
+	}
+
+	start();
+}
+
+Http2::Client::Client(Stream *stream) :
+	mStream(stream),
+	mOutputPending(false),
+	mStopping(false)
+{
+	Assert(mStream);
+	start();
+}
+
+Http2::Client::~Client(void)
+{
+	// Pending output, including GOAWAY, is written before the writer stops
+	mSession->close();
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mStopping = true;
+		mCondition.notify_all();
+	}
+
+	mWriter.join();
+	mReader.join();
+	delete mStream;
+}
+
+sptr<Http2::Channel> Http2::Client::open(void)
+{
+	return mSession->open();
+}
+
+int Http2::Client::request(const String &method, const String &url, const String &data, const StringMap &headers, Stream *output, StringMap *responseHeaders)
+{
+	Http::Request request(url, method);
+	request.headers.insert(headers);
+	if(!data.empty())
+		request.headers["Content-Length"] = String::number(data.size());
+
+	sptr<Channel> channel = open();
+	request.send(channel.get());
+	if(!data.empty()) channel->write(data);
+	channel->close();
+
+	Http::Response response;
+	response.recv(channel.get());
+
+	if(responseHeaders)
+		*responseHeaders = response.headers;
+
+	if(output) response.stream->read(*output);
+	else response.stream->discard();
+	return response.code;
+}
+
+bool Http2::Client::isClosed(void) const
+{
+	return mSession->isClosed();
+}
+
+void Http2::Client::start(void)
+{
+	mSession = std::make_shared<Session>(false);
+	mSession->setOutputHandler([this]()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mOutputPending = true;
+		mCondition.notify_all();
+	});
+
+	mOutputPending = true;	// preface and settings
+	mWriter = std::thread([this]()
+	{
+		write();
+	});
+
+	mReader = std::thread([this]()
+	{
+		read();
+	});
+}
+
+void Http2::Client::read(void)
+{
+	char buffer[DefaultMaxFrameSize];
+	try {
+		while(true)
+		{
+			// Waiting with a timeout allows to notice the client stopping
+			if(!mStream->waitData(milliseconds(100.)))
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				if(mStopping) break;
+				continue;
+			}
+
+			size_t size = mStream->readData(buffer, sizeof(buffer));
+			if(!size) break;
+
+			mSession->receive(buffer, size);
+			if(mSession->isClosed()) break;
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http2::Client", e.what());
+	}
+
+	mSession->close();
+}
+
+void Http2::Client::write(void)
+{
+	try {
+		String output;
+		while(true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this]()
+				{
+					return mOutputPending || mStopping;
+				});
+
+				if(!mOutputPending && mStopping) break;
+				mOutputPending = false;
+			}
+
+			output.clear();
+			while(mSession->pull(output, WriteBufferSize))
+			{
+				mStream->writeData(output.data(), output.size());
+				output.clear();
+			}
+
+			mStream->flush();
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("Http2::Client", e.what());
+		mSession->close();
+	}
+}
+
+}
@@ -0,0 +1,255 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#ifndef PLA_HTTP2_H
+#define PLA_HTTP2_H
+
+#include "pla/include.hpp"
+#include "pla/stream.hpp"
+#include "pla/string.hpp"
+#include "pla/map.hpp"
+#include "pla/bytequeue.hpp"
+
+#include <deque>
+
+namespace pla
+{
+
+// HTTP/2 (RFC 9113) framing, header compression, multiplexing, flow control and priorities
+// Http::Server accepts it with ALPN over TLS or with prior knowledge in clear, Http::Action negotiates it
+// over TLS. Requests and responses on a Channel are sent and received with Http::Request and Http::Response.
+class Http2
+{
+public:
+	typedef std::vector<std::pair<String, String> > headers_t;	// lowercase names, pseudo-headers first
+
+	enum Error { NoError = 0x0, ProtocolError = 0x1, InternalError = 0x2, FlowControlError = 0x3, SettingsTimeout = 0x4,
+		StreamClosed = 0x5, FrameSizeError = 0x6, RefusedStream = 0x7, Cancel = 0x8, CompressionError = 0x9,
+		ConnectError = 0xA, EnhanceYourCalm = 0xB, InadequateSecurity = 0xC, Http11Required = 0xD };
+
+	static const char Preface[];		// sent first by clients
+	static const size_t PrefaceSize = 24;
+
+	static uint32_t MaxConcurrentStreams;	// opened by the peer
+	static uint32_t InitialWindowSize;		// received data buffered per stream
+	static uint32_t ConnectionWindowSize;	// received data in flight on the connection
+	static size_t MaxHeaderListSize;		// decoded header fields, larger requests are refused
+	static size_t WriteBufferSize;			// data buffered per stream before writers block
+
+	// Header compression (RFC 7541), one context per direction
+	class Hpack
+	{
+	public:
+		static const size_t DefaultTableSize = 4096;
+
+		Hpack(void);
+		~Hpack(void);
+
+		void setMaxTableSize(size_t size);	// from SETTINGS_HEADER_TABLE_SIZE, for the encoder or the decoder
+		void encode(const headers_t &headers, String &output);
+		// Returns false if the list is larger than maxListSize, the block is still decoded to keep the context
+		bool decode(const char *data, size_t size, headers_t &headers, size_t maxListSize = 0);	// throws Exception on compression error
+
+	private:
+		struct Entry
+		{
+			String name;
+			String value;
+		};
+
+		static void EncodeInteger(uint32_t value, int prefix, uint8_t flags, String &output);
+		static uint32_t DecodeInteger(const uint8_t *&p, const uint8_t *end, int prefix);
+		static void EncodeString(const String &str, String &output);	// Huffman coded if shorter
+		static String DecodeString(const uint8_t *&p, const uint8_t *end);
+
+		size_t find(const String &name, const String &value, bool &exact) const;	// 0 if not found
+		void entry(size_t index, String &name, String &value) const;	// over the static then the dynamic table
+		void insert(const String &name, const String &value);
+		void evict(size_t maxSize);
+
+		std::deque<Entry> mTable;	// dynamic table, newest first
+		size_t mTableSize;		// as defined by the RFC, with 32 bytes of overhead per entry
+		size_t mCapacity;		// current maximum size of the dynamic table
+		size_t mMaxCapacity;	// allowed by the settings
+		size_t mMinCapacity;	// encoder: smallest capacity since the last signaled update
+		bool mUpdatePending;
+	};
+
+	class Session;
+
+	// Stream of a request and its response, headers are sent and received as blocks and bodies as data
+	class Channel : public Stream, public std::enable_shared_from_this<Channel>
+	{
+	public:
+		~Channel(void);
+
+		uint32_t id(void) const;
+		void sendHeaders(const headers_t &headers, bool end = false);	// end closes the stream after the headers
+		const headers_t &headers(void);	// waits for the request or final response head, throws if reset
+		void reset(uint32_t error = Cancel);
+
+		// Stream
+		size_t readData(char *buffer, size_t size);
+		void writeData(const char *data, size_t size);
+		bool waitData(duration timeout);
+		void flush(void);
+		void close(void);	// ends the stream, or resets it if no headers were sent, later writes are discarded
+
+	private:
+		Channel(sptr<Session> session, uint32_t id);
+
+		bool isReady(bool windowOpen) const;	// has something to send
+		bool isOver(void) const;	// closed on both sides
+
+		sptr<Session> mSession;
+		uint32_t mId;
+
+		headers_t mHeaders;
+		bool mHeadersReceived;
+		ByteQueue mInput;
+		bool mInputClosed;
+		uint32_t mRecvWindow;
+		uint32_t mRecvConsumed;	// not yet acknowledged with WINDOW_UPDATE
+
+		ByteQueue mOutput;
+		bool mOutputClosed;	// close() was called
+		bool mHeadersSent, mEndSent;
+		int64_t mSendWindow;
+		uint32_t mError;	// reset code
+		bool mReset;
+
+		// Priority, with weights shared by stride scheduling
+		uint32_t mParent;
+		int mWeight;
+		uint64_t mPass;
+
+		friend class Session;
+	};
+
+	// Connection state for either side, independent of the transport
+	// The transport passes received bytes to receive() and sends the frames returned by pull()
+	class Session : public std::enable_shared_from_this<Session>
+	{
+	public:
+		typedef std::function<void(sptr<Channel> channel)> handler_t;
+
+		Session(bool server);
+		~Session(void);
+
+		void setRequestHandler(handler_t handler);			// server side, called when the head of a request is received
+		void setOutputHandler(std::function<void()> handler);	// called from any thread when pull() has frames to send
+
+		sptr<Channel> open(void);	// client side, throws if the connection is closing
+		void receive(const char *data, size_t size);
+		bool pull(String &output, size_t limit);	// appends frames up to about limit bytes, returns false if there is nothing to send
+		void close(uint32_t error = 0);	// sends GOAWAY, remaining streams are reset
+
+		bool isClosed(void) const;	// no more frames are processed
+		bool isIdle(void) const;	// no open stream
+		bool hasOutput(void) const;
+
+	private:
+		enum FrameType { Data = 0x0, Headers = 0x1, Priority = 0x2, RstStream = 0x3, Settings = 0x4,
+			PushPromise = 0x5, Ping = 0x6, GoAway = 0x7, WindowUpdate = 0x8, Continuation = 0x9 };
+
+		void processFrame(uint8_t type, uint8_t flags, uint32_t id, const char *payload, size_t size, std::vector<sptr<Channel> > &requests);
+		void processHeaders(uint32_t id, uint8_t flags, std::vector<sptr<Channel> > &requests);	// complete block in mHeaderBlock
+		void processSettings(uint8_t flags, const char *payload, size_t size);
+		void setPriority(Channel *channel, uint32_t parent, int weight, bool exclusive);
+		bool validate(const headers_t &headers, bool request) const;	// malformed messages are reset
+
+		void queueFrame(uint8_t type, uint8_t flags, uint32_t id, const char *payload = NULL, size_t size = 0);
+		void queueHeaders(Channel *channel, const headers_t &headers, bool end);
+		void queueWindowUpdate(uint32_t id, uint32_t increment);
+		void resetStream(uint32_t id, uint32_t error);
+		void fail(uint32_t error, const String &reason);	// connection error, sends GOAWAY
+		bool consumed(Channel *channel, size_t size);	// read by the application, returns true if the window was updated
+		void remove(uint32_t id);
+		Channel *pick(void) const;	// next stream allowed to send data
+		void notify(std::unique_lock<std::mutex> &lock);	// unlocks and calls the output handler
+
+		bool mServer;
+		Hpack mEncoder, mDecoder;
+		std::map<uint32_t, sptr<Channel> > mChannels;	// open streams
+		uint32_t mNextStreamId;	// for streams opened locally
+		uint32_t mLastStreamId;	// highest stream opened by the peer
+		uint32_t mOpenedStreams;	// by the peer and still open
+
+		String mInput;	// partial frame
+		bool mPrefaceReceived;
+		String mHeaderBlock;	// waiting for CONTINUATION frames
+		uint32_t mHeaderStream;
+		uint8_t mHeaderFlags;
+		uint32_t mHeaderParent;	// priority of the HEADERS frame, if mHeaderWeight is set
+		int mHeaderWeight;
+		bool mHeaderExclusive;
+		String mOutput;	// control frames, sent before data
+
+		int64_t mSendWindow;
+		uint32_t mRecvConsumed;	// received on the connection, not yet acknowledged
+		uint32_t mPeerInitialWindow, mPeerMaxFrameSize, mPeerMaxStreams;
+		uint64_t mPass;	// virtual time of the data scheduler
+
+		bool mGoAwaySent, mGoAwayReceived, mClosed;
+		handler_t mRequestHandler;
+		std::function<void()> mOutputHandler;
+		mutable std::mutex mMutex;
+		std::condition_variable mCondition;	// channels wait for data, window or buffer space
+
+		friend class Channel;
+	};
+
+	// Client connection multiplexing concurrent requests, usable from several threads
+	class Client
+	{
+	public:
+		Client(const String &host, bool secure = true);	// prior knowledge in clear, or ALPN over TLS
+		Client(Stream *stream);	// connected with HTTP/2 already negotiated, stream will be deleted
+		~Client(void);
+
+		// Send the request on the channel with Http::Request::send(), write the body if any and close()
+		// the channel, then read the response with Http::Response::recv()
+		sptr<Channel> open(void);
+
+		int request(const String &method, const String &url, const String &data = "", const StringMap &headers = StringMap(), Stream *output = NULL, StringMap *responseHeaders = NULL);
+		bool isClosed(void) const;
+
+	private:
+		void start(void);
+		void read(void);	// reader thread
+		void write(void);	// writer thread
+
+		Stream *mStream;
+		sptr<Session> mSession;
+		std::thread mReader, mWriter;
+		bool mOutputPending, mStopping;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+	};
+
+private:
+	Http2(void);
+};
+
+}
+
+#endif
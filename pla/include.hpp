@@ -105,8 +105,11 @@ typedef u_long ctl_t;
 #define SEAGAIN		WSAEWOULDBLOCK
 #define SEADDRINUSE	WSAEADDRINUSE
 #define IP_DONTFRAG	IP_DONTFRAGMENT
+#define SHUT_WR		SD_SEND
 #define SOCK_TO_INT(x) 0
 
+struct iovec { void *iov_base; size_t iov_len; };	// for vectored socket writes
+
 #define mkdirmod(d,m) mkdir(d)
 
 #ifdef MINGW
@@ -131,6 +134,7 @@ typedef u_long ctl_t;
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -0,0 +1,373 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/iobuf.hpp"
+#include "pla/exception.hpp"
+
+#include <atomic>
+
+namespace pla
+{
+
+namespace
+{
+
+std::atomic<uint64_t> Copies(0);
+std::atomic<uint64_t> CopiedBytes(0);
+std::atomic<uint64_t> Allocations(0);
+std::atomic<uint64_t> Reuses(0);
+
+std::vector<char*> FreeBlocks;
+std::mutex FreeBlocksMutex;
+
+}
+
+size_t IOBuf::MaxPooledBlocks = 1024;
+const size_t IOBuf::BlockSize;
+
+class IOBuf::Block
+{
+public:
+	Block(size_t size) :
+		data(NULL),
+		capacity(std::max(size, BlockSize)),
+		used(0)
+	{
+		if(capacity == BlockSize)
+		{
+			std::unique_lock<std::mutex> lock(FreeBlocksMutex);
+			if(!FreeBlocks.empty())
+			{
+				data = FreeBlocks.back();
+				FreeBlocks.pop_back();
+				++Reuses;
+				return;
+			}
+		}
+
+		data = new char[capacity];
+		++Allocations;
+	}
+
+	~Block(void)
+	{
+		if(capacity == BlockSize)
+		{
+			std::unique_lock<std::mutex> lock(FreeBlocksMutex);
+			if(FreeBlocks.size() < MaxPooledBlocks)
+			{
+				FreeBlocks.push_back(data);
+				return;
+			}
+		}
+
+		delete[] data;
+	}
+
+	char *data;
+	size_t capacity;
+	size_t used;	// bytes committed by any buffer
+};
+
+IOBuf::Stats IOBuf::GetStats(void)
+{
+	Stats stats;
+	stats.copies = Copies;
+	stats.copiedBytes = CopiedBytes;
+	stats.allocations = Allocations;
+	stats.reuses = Reuses;
+	return stats;
+}
+
+void IOBuf::ResetStats(void)
+{
+	Copies = 0;
+	CopiedBytes = 0;
+	Allocations = 0;
+	Reuses = 0;
+}
+
+void IOBuf::Copy(char *destination, const char *source, size_t size)
+{
+	if(!size) return;
+	std::memcpy(destination, source, size);
+	++Copies;
+	CopiedBytes+= size;
+}
+
+IOBuf::IOBuf(void) :
+	mOffset(0),
+	mSize(0),
+	mOwner(false)
+{
+
+}
+
+IOBuf::IOBuf(size_t capacity) :
+	mBlock(std::make_shared<Block>(capacity)),
+	mOffset(0),
+	mSize(0),
+	mOwner(true)
+{
+
+}
+
+IOBuf::IOBuf(const char *data, size_t size) :
+	IOBuf(size)
+{
+	Copy(tail(), data, size);
+	commit(size);
+}
+
+IOBuf::IOBuf(const IOBuf &buf) :
+	mBlock(buf.mBlock),
+	mOffset(buf.mOffset),
+	mSize(buf.mSize),
+	mOwner(false)
+{
+
+}
+
+IOBuf::IOBuf(IOBuf &&buf) :
+	mBlock(std::move(buf.mBlock)),
+	mOffset(buf.mOffset),
+	mSize(buf.mSize),
+	mOwner(buf.mOwner)
+{
+	buf.mOffset = 0;
+	buf.mSize = 0;
+	buf.mOwner = false;
+}
+
+IOBuf::~IOBuf(void)
+{
+
+}
+
+IOBuf &IOBuf::operator=(const IOBuf &buf)
+{
+	if(&buf == this) return *this;
+	mBlock = buf.mBlock;
+	mOffset = buf.mOffset;
+	mSize = buf.mSize;
+	mOwner = false;
+	return *this;
+}
+
+IOBuf &IOBuf::operator=(IOBuf &&buf)
+{
+	if(&buf == this) return *this;
+	mBlock = std::move(buf.mBlock);
+	mOffset = buf.mOffset;
+	mSize = buf.mSize;
+	mOwner = buf.mOwner;
+	buf.mOffset = 0;
+	buf.mSize = 0;
+	buf.mOwner = false;
+	return *this;
+}
+
+const char *IOBuf::data(void) const
+{
+	return (mBlock ? mBlock->data + mOffset : NULL);
+}
+
+size_t IOBuf::size(void) const
+{
+	return mSize;
+}
+
+bool IOBuf::empty(void) const
+{
+	return mSize == 0;
+}
+
+char *IOBuf::tail(void)
+{
+	return (mBlock ? mBlock->data + mOffset + mSize : NULL);
+}
+
+size_t IOBuf::tailroom(void) const
+{
+	// Shared buffers must not write where the owner fills the block next
+	if(!mBlock || (!mOwner && mBlock.use_count() != 1)) return 0;
+
+	// Bytes after the end of this buffer might belong to another one
+	if(mOffset + mSize != mBlock->used) return 0;
+	return mBlock->capacity - mBlock->used;
+}
+
+void IOBuf::commit(size_t size)
+{
+	Assert(size <= tailroom());
+	mSize+= size;
+	mBlock->used+= size;
+}
+
+IOBuf IOBuf::slice(size_t offset, size_t size) const
+{
+	Assert(offset + size <= mSize);
+	IOBuf buf(*this);
+	buf.mOffset+= offset;
+	buf.mSize = size;
+	return buf;
+}
+
+void IOBuf::trimFront(size_t size)
+{
+	size = std::min(size, mSize);
+	mOffset+= size;
+	mSize-= size;
+}
+
+void IOBuf::trimBack(size_t size)
+{
+	mSize-= std::min(size, mSize);
+}
+
+IOBufChain::IOBufChain(void) :
+	mSize(0)
+{
+
+}
+
+IOBufChain::~IOBufChain(void)
+{
+
+}
+
+size_t IOBufChain::size(void) const
+{
+	return mSize;
+}
+
+bool IOBufChain::empty(void) const
+{
+	return mSize == 0;
+}
+
+size_t IOBufChain::count(void) const
+{
+	return mBuffers.size();
+}
+
+IOBufChain::const_iterator IOBufChain::begin(void) const
+{
+	return mBuffers.begin();
+}
+
+IOBufChain::const_iterator IOBufChain::end(void) const
+{
+	return mBuffers.end();
+}
+
+void IOBufChain::append(const IOBuf &buf)
+{
+	if(buf.empty()) return;
+	mBuffers.push_back(buf);
+	mSize+= buf.size();
+}
+
+void IOBufChain::append(IOBufChain &chain)
+{
+	if(&chain == this) return;
+	for(auto it = chain.mBuffers.begin(); it != chain.mBuffers.end(); ++it)
+		mBuffers.push_back(std::move(*it));
+
+	mSize+= chain.mSize;
+	chain.clear();
+}
+
+void IOBufChain::append(const char *data, size_t size)
+{
+	while(size)
+	{
+		if(mBuffers.empty() || !mBuffers.back().tailroom())
+			mBuffers.push_back(IOBuf(IOBuf::BlockSize));
+
+		IOBuf &buf = mBuffers.back();
+		size_t len = std::min(size, buf.tailroom());
+		IOBuf::Copy(buf.tail(), data, len);
+		buf.commit(len);
+		mSize+= len;
+		data+= len;
+		size-= len;
+	}
+}
+
+IOBufChain IOBufChain::split(size_t size)
+{
+	IOBufChain head;
+	while(size && !mBuffers.empty())
+	{
+		IOBuf &buf = mBuffers.front();
+		if(buf.size() <= size)
+		{
+			size-= buf.size();
+			mSize-= buf.size();
+			head.mSize+= buf.size();
+			head.mBuffers.push_back(std::move(buf));	// keeps the right to fill the block
+			mBuffers.pop_front();
+		}
+		else {
+			head.append(buf.slice(0, size));
+			buf.trimFront(size);
+			mSize-= size;
+			size = 0;
+		}
+	}
+
+	return head;
+}
+
+void IOBufChain::trimFront(size_t size)
+{
+	while(size && !mBuffers.empty())
+	{
+		IOBuf &buf = mBuffers.front();
+		size_t len = std::min(size, buf.size());
+		buf.trimFront(len);
+		mSize-= len;
+		size-= len;
+		if(buf.empty()) mBuffers.pop_front();
+	}
+}
+
+size_t IOBufChain::copyTo(char *buffer, size_t size) const
+{
+	size_t total = 0;
+	for(auto it = mBuffers.begin(); it != mBuffers.end() && total < size; ++it)
+	{
+		size_t len = std::min(size - total, it->size());
+		IOBuf::Copy(buffer + total, it->data(), len);
+		total+= len;
+	}
+
+	return total;
+}
+
+void IOBufChain::clear(void)
+{
+	mBuffers.clear();
+	mSize = 0;
+}
+
+}
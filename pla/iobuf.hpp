@@ -0,0 +1,117 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_IOBUF_H
+#define PLA_IOBUF_H
+
+#include "pla/include.hpp"
+
+#include <deque>
+
+namespace pla
+{
+
+// Reference-counted slice of a memory block, copying an IOBuf shares the block
+// Blocks of BlockSize bytes are recycled through a shared pool
+// Only the buffer which allocated the block, or one holding the last reference, fills it in place,
+// so copies and slices handed to other threads never write into it
+class IOBuf
+{
+public:
+	static const size_t BlockSize = 16*1024;
+	static size_t MaxPooledBlocks;	// free blocks kept for reuse
+
+	// Process-wide counters, copies are the ones made with Copy()
+	struct Stats
+	{
+		uint64_t copies = 0;
+		uint64_t copiedBytes = 0;
+		uint64_t allocations = 0;	// blocks allocated from the heap
+		uint64_t reuses = 0;		// blocks taken from the pool
+	};
+
+	static Stats GetStats(void);
+	static void ResetStats(void);
+	static void Copy(char *destination, const char *source, size_t size);	// counted memcpy
+
+	IOBuf(void);
+	explicit IOBuf(size_t capacity);		// empty, with room for capacity bytes
+	IOBuf(const char *data, size_t size);	// copies data
+	IOBuf(const IOBuf &buf);	// shares the block, not the right to fill it
+	IOBuf(IOBuf &&buf);
+	~IOBuf(void);
+
+	IOBuf &operator=(const IOBuf &buf);
+	IOBuf &operator=(IOBuf &&buf);
+
+	const char *data(void) const;
+	size_t size(void) const;
+	bool empty(void) const;
+
+	// Filling in place, there is room only if this buffer may fill the block and no other buffer ends after it
+	char *tail(void);
+	size_t tailroom(void) const;
+	void commit(size_t size);	// appends size bytes written at tail()
+
+	IOBuf slice(size_t offset, size_t size) const;	// shares the block
+	void trimFront(size_t size);
+	void trimBack(size_t size);
+
+private:
+	class Block;
+
+	sptr<Block> mBlock;
+	size_t mOffset, mSize;
+	bool mOwner;	// allocated the block
+};
+
+// Sequence of buffers passed between streams without copy
+class IOBufChain
+{
+public:
+	typedef std::deque<IOBuf>::const_iterator const_iterator;
+
+	IOBufChain(void);
+	~IOBufChain(void);
+
+	size_t size(void) const;	// bytes
+	bool empty(void) const;
+	size_t count(void) const;	// buffers
+	const_iterator begin(void) const;
+	const_iterator end(void) const;
+
+	void append(const IOBuf &buf);			// shares buf
+	void append(IOBufChain &chain);			// moves the buffers of chain
+	void append(const char *data, size_t size);	// copies data, filling the last buffer first
+
+	IOBufChain split(size_t size);	// removes and returns the first size bytes, the boundary buffer is sliced
+	void trimFront(size_t size);
+	size_t copyTo(char *buffer, size_t size) const;	// copies the first bytes, returns the count
+	void clear(void);
+
+private:
+	std::deque<IOBuf> mBuffers;	// none is empty
+	size_t mSize;
+};
+
+}
+
+#endif
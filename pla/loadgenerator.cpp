@@ -0,0 +1,662 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#include "pla/loadgenerator.hpp"
+#include "pla/exception.hpp"
+
+#include <random>
+
+namespace pla
+{
+
+static const size_t ReadSize = 64*1024;
+
+class LoadGenerator::Worker
+{
+public:
+	Worker(LoadGenerator *generator);
+	~Worker(void);
+
+	void start(int first, int count, std::chrono::steady_clock::time_point origin);	// connections first to first+count-1
+	void stop(void);	// from the caller, joins the loop
+
+	const Request &pick(void);
+	void record(const Request *request, int status, std::chrono::steady_clock::time_point issued, size_t bytes);
+	void error(void);
+
+	LoadGenerator *mGenerator;
+	EventLoop mLoop;
+	Results mResults;
+
+private:
+	void tick(void);	// constant-rate mode, issues requests which are due
+
+	std::vector<sptr<Connection> > mConnections;
+	std::mt19937 mRandom;
+	double mTotalWeight;
+};
+
+class LoadGenerator::Connection
+{
+public:
+	Connection(Worker *worker);
+	~Connection(void);
+
+	void connect(void);
+	void disconnect(void);
+	void issue(std::chrono::steady_clock::time_point time);	// queues a request
+	void fill(void);	// closed-loop mode, queues requests up to the pipelining depth
+
+	std::chrono::steady_clock::time_point mNext;	// next request due, in constant-rate mode
+
+private:
+	struct Pending
+	{
+		const Request *request;
+		std::chrono::steady_clock::time_point issued;	// latency is measured from there
+	};
+
+	enum State { Head, Body, ChunkSize, ChunkData, Trailers, UntilClose };
+
+	void onEvents(int events);
+	void send(void);
+	void receive(void);
+	bool parse(void);	// returns false if more data is needed
+	void complete(void);
+	void fail(void);
+	void watch(void);
+
+	Worker *mWorker;
+	Socket *mSock;
+	std::deque<Pending> mBacklog;	// not sent yet
+	std::deque<Pending> mInFlight;
+	String mOutput, mInput;
+	size_t mOutputOffset, mInputOffset;
+	int mEvents;
+
+	State mState;
+	int mStatus;
+	int64_t mLeft;
+	bool mClose;	// the server closes after the response
+	size_t mBytes;
+};
+
+LoadGenerator::LoadGenerator(const Address &address, const String &host) :
+	mAddress(address),
+	mHost(host),
+	mConnections(10),
+	mThreads(1),
+	mPipelining(1),
+	mRate(0.)
+{
+	if(mHost.empty()) mHost = mAddress.toString();
+}
+
+LoadGenerator::~LoadGenerator(void)
+{
+
+}
+
+void LoadGenerator::addRequest(const String &method, const String &path, const BinaryString &body, const StringMap &headers, double weight)
+{
+	String upperMethod = method.toUpper();
+
+	Request request;
+	request.raw<<upperMethod<<" "<<path<<" HTTP/1.1\r\n";
+	request.raw<<"Host: "<<mHost<<"\r\n";
+	for(StringMap::const_iterator it = headers.begin(); it != headers.end(); ++it)
+		request.raw<<it->first<<": "<<it->second<<"\r\n";
+	if(!body.empty() || upperMethod == "POST")
+		request.raw<<"Content-Length: "<<String::number(body.size())<<"\r\n";
+	request.raw<<"\r\n";
+	request.raw.append(body.data(), body.size());
+
+	request.head = (upperMethod == "HEAD");
+	request.weight = std::max(weight, 0.);
+	mRequests.push_back(request);
+}
+
+void LoadGenerator::setConnections(int connections)
+{
+	mConnections = std::max(connections, 1);
+}
+
+void LoadGenerator::setThreads(int threads)
+{
+	mThreads = std::max(threads, 1);
+}
+
+void LoadGenerator::setPipelining(int depth)
+{
+	mPipelining = std::max(depth, 1);
+}
+
+void LoadGenerator::setRate(double rate)
+{
+	mRate = std::max(rate, 0.);
+}
+
+LoadGenerator::Results LoadGenerator::run(duration d)
+{
+	if(mRequests.empty())
+		addRequest("GET", "/");
+
+	int threads = std::min(mThreads, mConnections);
+	std::vector<sptr<Worker> > workers;
+	for(int i = 0; i < threads; ++i)
+		workers.push_back(std::make_shared<Worker>(this));
+
+	auto origin = std::chrono::steady_clock::now();
+	try {
+		int first = 0;
+		for(int i = 0; i < threads; ++i)
+		{
+			int count = mConnections/threads + (i < mConnections%threads ? 1 : 0);
+			workers[i]->start(first, count, origin);
+			first+= count;
+		}
+
+		std::this_thread::sleep_for(d);
+	}
+	catch(...)
+	{
+		for(auto &w : workers) w->stop();
+		throw;
+	}
+
+	Results results;
+	for(auto &w : workers)
+	{
+		w->stop();
+
+		const Results &r = w->mResults;
+		results.requests+= r.requests;
+		results.failures+= r.failures;
+		results.errors+= r.errors;
+		results.bytes+= r.bytes;
+		results.latency.merge(r.latency);
+		for(auto it = r.statuses.begin(); it != r.statuses.end(); ++it)
+			results.statuses[it->first]+= it->second;
+	}
+
+	results.elapsed = std::chrono::duration_cast<duration>(std::chrono::steady_clock::now() - origin);
+	return results;
+}
+
+double LoadGenerator::Results::rate(void) const
+{
+	if(elapsed <= duration::zero()) return 0.;
+	return double(requests)/elapsed.count();
+}
+
+String LoadGenerator::Results::toString(void) const
+{
+	String str;
+	str<<String::number64(requests)<<" requests in "<<String::number(elapsed.count())<<" s, "<<String::number64(bytes)<<" bytes read\n";
+	str<<"Requests/s: "<<String::number(rate())<<"\n";
+	str<<"Latency (ms): "<<latency.toString()<<"\n";
+	str<<"Status:";
+	for(auto it = statuses.begin(); it != statuses.end(); ++it)
+		str<<" "<<String::number(it->first)<<"="<<String::number64(it->second);
+	str<<"\n";
+	str<<"Failures: "<<String::number64(failures)<<", errors: "<<String::number64(errors)<<"\n";
+	return str;
+}
+
+LoadGenerator::Worker::Worker(LoadGenerator *generator) :
+	mGenerator(generator),
+	mRandom(std::random_device()()),
+	mTotalWeight(0.)
+{
+	for(auto it = mGenerator->mRequests.begin(); it != mGenerator->mRequests.end(); ++it)
+		mTotalWeight+= it->weight;
+}
+
+LoadGenerator::Worker::~Worker(void)
+{
+	stop();
+}
+
+void LoadGenerator::Worker::start(int first, int count, std::chrono::steady_clock::time_point origin)
+{
+	// Connections are spread over the request interval so they do not fire together
+	duration interval = (mGenerator->mRate > 0. ? seconds(mGenerator->mConnections/mGenerator->mRate) : duration::zero());
+
+	for(int i = 0; i < count; ++i)
+	{
+		auto connection = std::make_shared<Connection>(this);
+		connection->mNext = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval*(double(first + i)/mGenerator->mConnections));
+		mConnections.push_back(connection);
+	}
+
+	mLoop.post([this]()
+	{
+		for(auto &c : mConnections)
+		{
+			c->connect();
+			if(mGenerator->mRate <= 0.) c->fill();
+		}
+
+		if(mGenerator->mRate > 0.) tick();
+	});
+}
+
+void LoadGenerator::Worker::stop(void)
+{
+	mLoop.join();	// handlers are not called anymore
+	for(auto &c : mConnections) c->disconnect();
+	mConnections.clear();
+}
+
+const LoadGenerator::Request &LoadGenerator::Worker::pick(void)
+{
+	const std::vector<Request> &requests = mGenerator->mRequests;
+	if(requests.size() == 1 || mTotalWeight <= 0.) return requests.front();
+
+	double r = std::uniform_real_distribution<double>(0., mTotalWeight)(mRandom);
+	for(auto it = requests.begin(); it != requests.end(); ++it)
+	{
+		if(r < it->weight) return *it;
+		r-= it->weight;
+	}
+
+	return requests.back();
+}
+
+void LoadGenerator::Worker::record(const Request *request, int status, std::chrono::steady_clock::time_point issued, size_t bytes)
+{
+	auto now = std::chrono::steady_clock::now();
+	++mResults.requests;
+	if(status >= 400) ++mResults.failures;
+	mResults.bytes+= bytes;
+	mResults.statuses[status]++;
+	mResults.latency.add(std::chrono::duration_cast<milliseconds>(now - issued).count());
+}
+
+void LoadGenerator::Worker::error(void)
+{
+	++mResults.errors;
+}
+
+void LoadGenerator::Worker::tick(void)
+{
+	auto now = std::chrono::steady_clock::now();
+	auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(seconds(mGenerator->mConnections/mGenerator->mRate));
+
+	// Requests are due at fixed times whether or not the server kept up
+	auto next = std::chrono::steady_clock::time_point::max();
+	for(auto &c : mConnections)
+	{
+		while(c->mNext <= now)
+		{
+			c->issue(c->mNext);
+			c->mNext+= interval;
+		}
+
+		next = std::min(next, c->mNext);
+	}
+
+	mLoop.schedule(std::chrono::duration_cast<duration>(next - now), [this]()
+	{
+		this->tick();
+	});
+}
+
+LoadGenerator::Connection::Connection(Worker *worker) :
+	mWorker(worker),
+	mSock(NULL),
+	mOutputOffset(0),
+	mInputOffset(0),
+	mEvents(0),
+	mState(Head),
+	mStatus(0),
+	mLeft(0),
+	mClose(false),
+	mBytes(0)
+{
+
+}
+
+LoadGenerator::Connection::~Connection(void)
+{
+	delete mSock;
+}
+
+void LoadGenerator::Connection::connect(void)
+{
+	Assert(!mSock);
+
+	try {
+		mSock = new Socket;
+		mSock->setNoDelay(true);
+		mSock->connect(mWorker->mGenerator->mAddress, true);
+		mEvents = EventLoop::Readable;
+		mWorker->mLoop.add(mSock, mEvents, [this](int events)
+		{
+			this->onEvents(events);
+		});
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("LoadGenerator::Connection", e.what());
+		mWorker->error();
+		delete mSock;
+		mSock = NULL;
+
+		// Retry later, queued requests are kept
+		mWorker->mLoop.schedule(seconds(0.1), [this]()
+		{
+			this->connect();
+			this->send();
+		});
+		return;
+	}
+
+	mOutput.clear();
+	mInput.clear();
+	mOutputOffset = mInputOffset = 0;
+	mState = Head;
+	mClose = false;
+	mBytes = 0;
+}
+
+void LoadGenerator::Connection::disconnect(void)
+{
+	if(!mSock) return;
+	NOEXCEPTION(mWorker->mLoop.remove(mSock));
+	delete mSock;
+	mSock = NULL;
+}
+
+void LoadGenerator::Connection::issue(std::chrono::steady_clock::time_point time)
+{
+	Pending pending;
+	pending.request = &mWorker->pick();
+	pending.issued = time;
+	mBacklog.push_back(pending);
+	send();
+}
+
+void LoadGenerator::Connection::fill(void)
+{
+	int depth = mWorker->mGenerator->mPipelining;
+	while(int(mBacklog.size() + mInFlight.size()) < depth)
+	{
+		Pending pending;
+		pending.request = &mWorker->pick();
+		pending.issued = std::chrono::steady_clock::now();
+		mBacklog.push_back(pending);
+	}
+
+	send();
+}
+
+void LoadGenerator::Connection::onEvents(int events)
+{
+	try {
+		if(events & EventLoop::Readable) receive();
+		if(mSock && (events & EventLoop::Writable)) send();
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("LoadGenerator::Connection", e.what());
+		fail();
+	}
+}
+
+void LoadGenerator::Connection::send(void)
+{
+	if(!mSock) return;
+
+	// Requests are pipelined up to the depth, the server answers in order
+	int depth = mWorker->mGenerator->mPipelining;
+	while(!mBacklog.empty() && int(mInFlight.size()) < depth)
+	{
+		const Pending &pending = mBacklog.front();
+		mOutput+= pending.request->raw;
+		mInFlight.push_back(pending);
+		mBacklog.pop_front();
+	}
+
+	try {
+		while(mOutputOffset < mOutput.size())
+		{
+			struct iovec iov;
+			iov.iov_base = const_cast<char*>(mOutput.data() + mOutputOffset);
+			iov.iov_len = mOutput.size() - mOutputOffset;
+			ssize_t ret = mSock->tryWriteData(&iov, 1);
+			if(ret < 0) break;
+			mOutputOffset+= size_t(ret);
+		}
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("LoadGenerator::Connection", e.what());
+		fail();
+		return;
+	}
+
+	if(mOutputOffset == mOutput.size())
+	{
+		mOutput.clear();
+		mOutputOffset = 0;
+	}
+
+	watch();
+}
+
+void LoadGenerator::Connection::receive(void)
+{
+	char buffer[ReadSize];
+	while(mSock)
+	{
+		ssize_t ret = mSock->tryReadData(buffer, ReadSize);
+		if(ret < 0) break;
+		if(ret == 0)
+		{
+			// A body delimited by the connection end is complete
+			if(mState == UntilClose && !mInFlight.empty()) complete();
+			else if(!mInFlight.empty() || !mBacklog.empty()) fail();
+			else {
+				disconnect();
+				connect();
+			}
+			return;
+		}
+
+		mInput.append(buffer, size_t(ret));
+		mBytes+= size_t(ret);
+		while(mSock && parse());
+
+		if(mInputOffset == mInput.size())
+		{
+			mInput.clear();
+			mInputOffset = 0;
+		}
+	}
+}
+
+bool LoadGenerator::Connection::parse(void)
+{
+	const size_t available = mInput.size() - mInputOffset;
+	const char *data = mInput.data() + mInputOffset;
+
+	switch(mState)
+	{
+	case Head:
+	{
+		const char *end = static_cast<const char*>(memmem(data, available, "\r\n\r\n", 4));
+		if(!end)
+		{
+			if(available > 64*1024) throw Exception("Response head too large");
+			return false;
+		}
+
+		String head(data, end + 2 - data);
+		mInputOffset+= (end + 4 - data);
+		if(mInFlight.empty()) throw Exception("Unexpected response");
+
+		String line;
+		head.readLine(line);
+		String protocol;
+		line.readString(protocol);
+		if(protocol.substr(0, 5) != "HTTP/" || !line.read(mStatus))
+			throw Exception("Invalid response status line");
+
+		int64_t contentLength = -1;
+		bool chunked = false;
+		mClose = (protocol == "HTTP/1.0");
+		while(head.readLine(line))
+		{
+			String value = line.cut(':');
+			line = line.toLower();
+			line.trim();
+			value = value.toLower();
+			value.trim();
+
+			if(line == "content-length") value.extract(contentLength);
+			else if(line == "transfer-encoding") chunked = value.contains("chunked");
+			else if(line == "connection")
+			{
+				if(value.contains("close")) mClose = true;
+				else if(value.contains("keep-alive")) mClose = false;
+			}
+		}
+
+		if(mStatus >= 100 && mStatus < 200) return true;	// interim response
+
+		if(mInFlight.front().request->head || mStatus == 204 || mStatus == 304) complete();
+		else if(chunked) mState = ChunkSize;
+		else if(contentLength >= 0)
+		{
+			mLeft = contentLength;
+			mState = Body;
+			if(!mLeft) complete();
+		}
+		else mState = UntilClose;
+		return true;
+	}
+
+	case Body:
+	case ChunkData:
+	{
+		size_t size = size_t(std::min(int64_t(available), mLeft));
+		mInputOffset+= size;
+		mLeft-= size;
+		if(mLeft) return false;
+
+		if(mState == Body) complete();
+		else mState = ChunkSize;
+		return true;
+	}
+
+	case ChunkSize:
+	case Trailers:
+	{
+		const char *end = static_cast<const char*>(memchr(data, '\n', available));
+		if(!end) return false;
+
+		String line(data, end - data);
+		mInputOffset+= (end + 1 - data);
+		line.trim();
+
+		if(mState == Trailers)
+		{
+			if(line.empty()) complete();
+			return true;
+		}
+
+		if(line.empty()) return true;	// line break after chunk data
+		line.cut(';');
+		mLeft = std::strtoll(line.c_str(), NULL, 16);
+		if(mLeft) mState = ChunkData;
+		else mState = Trailers;
+		return true;
+	}
+
+	case UntilClose:
+		mInputOffset = mInput.size();
+		return false;
+	}
+
+	return false;
+}
+
+void LoadGenerator::Connection::complete(void)
+{
+	Assert(!mInFlight.empty());
+	Pending pending = mInFlight.front();
+	mInFlight.pop_front();
+	mWorker->record(pending.request, mStatus, pending.issued, mBytes);
+	mBytes = 0;
+
+	bool close = (mClose || mState == UntilClose);
+	mState = Head;
+	if(close)
+	{
+		// Requests pipelined after this one will not be answered, send them again
+		while(!mInFlight.empty())
+		{
+			mBacklog.push_front(mInFlight.back());
+			mInFlight.pop_back();
+		}
+
+		disconnect();
+		connect();
+	}
+
+	if(mWorker->mGenerator->mRate <= 0.) fill();
+	else send();
+}
+
+void LoadGenerator::Connection::fail(void)
+{
+	// The request being answered is dropped, the ones pipelined after it are sent again
+	mWorker->error();
+	if(!mInFlight.empty()) mInFlight.pop_front();
+	while(!mInFlight.empty())
+	{
+		mBacklog.push_front(mInFlight.back());
+		mInFlight.pop_back();
+	}
+
+	disconnect();
+	connect();
+
+	if(mWorker->mGenerator->mRate <= 0.) fill();
+	else send();
+}
+
+void LoadGenerator::Connection::watch(void)
+{
+	if(!mSock) return;
+
+	int events = EventLoop::Readable;
+	if(mOutputOffset < mOutput.size()) events|= EventLoop::Writable;
+	if(events != mEvents)
+	{
+		mWorker->mLoop.modify(mSock, events);
+		mEvents = events;
+	}
+}
+
+}
@@ -0,0 +1,94 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#ifndef PLA_LOADGENERATOR_H
+#define PLA_LOADGENERATOR_H
+
+#include "pla/include.hpp"
+#include "pla/string.hpp"
+#include "pla/binarystring.hpp"
+#include "pla/address.hpp"
+#include "pla/socket.hpp"
+#include "pla/eventloop.hpp"
+#include "pla/histogram.hpp"
+#include "pla/map.hpp"
+
+namespace pla
+{
+
+// HTTP load generator over persistent connections, driven by event loops
+// In closed-loop mode each connection keeps its pipeline full. In constant-rate mode, requests
+// are issued on a fixed schedule and latency is measured from the scheduled time, so a stalled
+// server is not hidden by requests that were never sent (coordinated omission).
+class LoadGenerator
+{
+public:
+	struct Results
+	{
+		uint64_t requests = 0;		// completed responses
+		uint64_t failures = 0;		// responses with status 400 or more
+		uint64_t errors = 0;		// connection errors and invalid responses
+		uint64_t bytes = 0;			// received
+		duration elapsed = duration::zero();
+		Histogram latency;			// milliseconds
+		std::map<int, uint64_t> statuses;
+
+		double rate(void) const;	// completed requests per second
+		String toString(void) const;
+	};
+
+	LoadGenerator(const Address &address, const String &host = "");	// host defaults to the address
+	~LoadGenerator(void);
+
+	// The mix defaults to GET / and requests are picked at random according to their weight
+	void addRequest(const String &method, const String &path, const BinaryString &body = "", const StringMap &headers = StringMap(), double weight = 1.);
+
+	void setConnections(int connections);
+	void setThreads(int threads);		// event loops sharing the connections
+	void setPipelining(int depth);		// requests in flight per connection
+	void setRate(double rate);			// total requests per second, 0 means as fast as possible
+
+	Results run(duration d);	// blocks for d
+
+private:
+	struct Request
+	{
+		String raw;		// serialized head and body
+		bool head;		// response has no body
+		double weight;
+	};
+
+	class Connection;
+	class Worker;
+
+	Address mAddress;
+	String mHost;
+	std::vector<Request> mRequests;
+	int mConnections;
+	int mThreads;
+	int mPipelining;
+	double mRate;
+};
+
+}
+
+#endif
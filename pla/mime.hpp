@@ -35,13 +35,9 @@ public:
 	static bool IsAudio(const String &fileName);
 	static bool IsVideo(const String &fileName);
 	static String GetType(const String &fileName);
+	static const char *GetType(const char *fileName, size_t size);	// case-insensitive, without locking or allocation
 
 private:
-	static void Init(void);
-
-	static StringMap Types;
-	static std::mutex TypesMutex;
-
 	Mime(void);
 	~Mime(void);
 };
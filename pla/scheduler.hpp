@@ -82,7 +82,7 @@ inline Scheduler::Scheduler(size_t threads) :
 	thread = std::thread([this]()
 	{
 		std::unique_lock<std::mutex> lock(mutex);
-		while(true)
+		while(!joining)
 		{
 			if(scheduling.empty())
 			{
@@ -108,7 +108,11 @@ inline Scheduler::Scheduler(size_t threads) :
 
 inline Scheduler::~Scheduler(void)
 {
-	joining = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		joining = true;
+	}
+
 	clear();
 	join();
 }
@@ -245,8 +249,12 @@ inline void Scheduler::clear(void)
 
 inline void Scheduler::join(void)
 {
-	joining = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		joining = true;
+	}
 
+	schedulingCondition.notify_all();	// wake up the scheduling thread
 	if(thread.joinable()) thread.join();
 	ThreadPool::join();
 }
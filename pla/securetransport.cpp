@@ -23,8 +23,12 @@
 #include "pla/exception.hpp"
 #include "pla/random.hpp"
 #include "pla/datagramsocket.hpp"
+#include "pla/file.hpp"
 
-#include <gnutls/dtls.h>
+
+#ifdef LINUX
+#include <pthread.h>
+#endif
 
 namespace pla
 {
@@ -33,46 +37,262 @@ duration SecureTransport::DefaultTimeout = seconds(10.);	// Defaults to 10 secs
 
 // Force 128+ bits cipher, disable SSL3.0 and TLS1.0, disable RC4
 String SecureTransport::DefaultPriorities = "SECURE128:-VERS-SSL3.0:-VERS-TLS1.0:-ARCFOUR-128";
-gnutls_dh_params_t SecureTransport::Params;
+
+size_t SecureTransport::DefaultMaxRecordSize = 0;
+size_t SecureTransport::ReadAheadSize = 16*1024 + 512;	// a full record with its overhead
+size_t SecureTransport::CoalescingSize = 64*1024;
+
+bool SecureTransport::PredefinedGroups = false;
+String SecureTransport::ParamsFile = "";
+duration SecureTransport::ParamsRotation = seconds(24*3600.);	// Defaults to 1 day
+unsigned SecureTransport::ParamsBits = 4096;
+
+sptr<gnutls_dh_params_int> SecureTransport::Params;
 std::mutex SecureTransport::ParamsMutex;
+std::thread SecureTransport::ParamsThread;
+std::mutex SecureTransport::ParamsThreadMutex;
+std::condition_variable SecureTransport::ParamsCondition;
+bool SecureTransport::ParamsStopping = false;
+SecureTransport::ParamsThreadGuard SecureTransport::ParamsGuard;	// destroyed before the members above
+
+bool SecureTransport::SessionTickets = true;
+duration SecureTransport::TicketKeyRotation = seconds(3600.);	// Defaults to 1 hour
+gnutls_datum_t SecureTransport::TicketKey = { NULL, 0 };
+std::mutex SecureTransport::TicketKeyMutex;
+
+sptr<SecureTransport::HandshakeExecutor> SecureTransport::Executor;
+sptr<SecureTransport::SessionCache> SecureTransport::ServerSessions;
+sptr<SecureTransport::SessionCache> SecureTransport::ClientSessions = std::make_shared<SecureTransport::SessionCache>(1024);
+std::mutex SecureTransport::SessionsMutex;
+std::atomic<uint64_t> SecureTransport::FullHandshakes[2];
+std::atomic<uint64_t> SecureTransport::ResumedHandshakes[2];
 
 void SecureTransport::Init(void)
 {
 	Assert(gnutls_global_init() == GNUTLS_E_SUCCESS);
-	Assert(gnutls_dh_params_init(&Params) == GNUTLS_E_SUCCESS);
+
+	if(!PredefinedGroups)
+	{
+		if(!ParamsFile.empty() && File::Exist(ParamsFile))
+		{
+			try {
+				LoadParams();
+			}
+			catch(const std::exception &e)
+			{
+				LogWarn("SecureTransport::Init", String("Unable to load DH parameters: ") + e.what());
+			}
+		}
+
+		StopParams();
+
+		{
+			std::unique_lock<std::mutex> lock(ParamsThreadMutex);
+			ParamsStopping = false;
+		}
+
+		ParamsThread = std::thread(RunParams);
+	}
 }
 
 void SecureTransport::Cleanup(void)
 {
+	StopParams();
+	std::atomic_store(&Params, sptr<gnutls_dh_params_int>());
+
+	{
+		std::unique_lock<std::mutex> lock(TicketKeyMutex);
+		if(TicketKey.data)
+		{
+			gnutls_memset(TicketKey.data, 0, TicketKey.size);
+			gnutls_free(TicketKey.data);
+			TicketKey.data = NULL;
+			TicketKey.size = 0;
+		}
+	}
+
 	gnutls_global_deinit();
-	gnutls_dh_params_deinit(Params);
 }
 
-void SecureTransport::GenerateParams(void)
+void SecureTransport::SetServerSessionCache(size_t capacity)
+{
+	std::unique_lock<std::mutex> lock(SessionsMutex);
+	if(capacity) ServerSessions = std::make_shared<SessionCache>(capacity);
+	else ServerSessions.reset();
+}
+
+void SecureTransport::SetClientSessionCache(size_t capacity)
+{
+	std::unique_lock<std::mutex> lock(SessionsMutex);
+	if(capacity) ClientSessions = std::make_shared<SessionCache>(capacity);
+	else ClientSessions.reset();
+}
+
+SecureTransport::ResumptionStats SecureTransport::GetResumptionStats(bool isClient)
+{
+	ResumptionStats stats;
+	stats.full = FullHandshakes[isClient ? 1 : 0].load();
+	stats.resumed = ResumedHandshakes[isClient ? 1 : 0].load();
+	return stats;
+}
+
+void SecureTransport::SetHandshakeExecutor(sptr<HandshakeExecutor> executor)
+{
+	std::atomic_store(&Executor, executor);
+}
+
+sptr<SecureTransport::HandshakeExecutor> SecureTransport::GetHandshakeExecutor(void)
 {
-	const int bits = 4096;
+	return std::atomic_load(&Executor);
+}
 
+void SecureTransport::GenerateParams(void)
+{
 	std::unique_lock<std::mutex> lock(ParamsMutex);
+
+	gnutls_dh_params_t params;
+	Assert(gnutls_dh_params_init(&params) == GNUTLS_E_SUCCESS);
+	sptr<gnutls_dh_params_int> ptr(params, gnutls_dh_params_deinit);
+
 	LogDebug("SecureTransport::GenerateParams", "Generating DH parameters");
-	int ret = gnutls_dh_params_generate2(Params, bits);
+	int ret = gnutls_dh_params_generate2(params, ParamsBits);
 	if (ret < 0) throw Exception(String("Failed to generate DH parameters: ") + ErrorString(ret));
+
+	if(!ParamsFile.empty())
+	{
+		gnutls_datum_t datum;
+		ret = gnutls_dh_params_export2_pkcs3(params, GNUTLS_X509_FMT_PEM, &datum);
+		if(ret == GNUTLS_E_SUCCESS)
+		{
+			try {
+				SafeWriteFile file(ParamsFile);
+				file.writeData(reinterpret_cast<const char*>(datum.data), datum.size);
+				file.close();
+			}
+			catch(const std::exception &e)
+			{
+				LogWarn("SecureTransport::GenerateParams", String("Unable to save DH parameters: ") + e.what());
+			}
+
+			gnutls_free(datum.data);
+		}
+	}
+
+	// New sessions pick up the parameters through ParamsCallback
+	std::atomic_store(&Params, ptr);
+	LogDebug("SecureTransport::GenerateParams", "DH parameters updated");
+}
+
+sptr<gnutls_dh_params_int> SecureTransport::GetParams(void)
+{
+	return std::atomic_load(&Params);
+}
+
+void SecureTransport::LoadParams(void)
+{
+	BinaryString data;
+	File file(ParamsFile, File::Read);
+	file.read(static_cast<Stream&>(data));	// whole file
+	file.close();
+
+	gnutls_dh_params_t params;
+	Assert(gnutls_dh_params_init(&params) == GNUTLS_E_SUCCESS);
+	sptr<gnutls_dh_params_int> ptr(params, gnutls_dh_params_deinit);
+
+	gnutls_datum_t datum;
+	datum.data = reinterpret_cast<unsigned char*>(const_cast<char*>(data.data()));
+	datum.size = data.size();
+	int ret = gnutls_dh_params_import_pkcs3(params, &datum, GNUTLS_X509_FMT_PEM);
+	if(ret != GNUTLS_E_SUCCESS) throw Exception(String("Invalid DH parameters file: ") + ErrorString(ret));
+
+	std::atomic_store(&Params, ptr);
+}
+
+void SecureTransport::RunParams(void)
+{
+#ifdef LINUX
+	// Generation is CPU-intensive, only use idle time
+	struct sched_param param;
+	param.sched_priority = 0;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	std::unique_lock<std::mutex> lock(ParamsThreadMutex);
+	bool wait = bool(GetParams());	// generate immediately if nothing was loaded
+	while(!ParamsStopping)
+	{
+		if(wait && ParamsCondition.wait_for(lock, ParamsRotation, []() { return ParamsStopping; }))
+			break;
+
+		wait = true;
+		lock.unlock();
+		try {
+			GenerateParams();
+		}
+		catch(const std::exception &e)
+		{
+			LogWarn("SecureTransport::RunParams", e.what());
+		}
+		lock.lock();
+	}
+}
+
+void SecureTransport::StopParams(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(ParamsThreadMutex);
+		ParamsStopping = true;
+	}
+
+	ParamsCondition.notify_all();
+	if(ParamsThread.joinable())
+		ParamsThread.join();	// waits for a running generation
+}
+
+int SecureTransport::ParamsCallback(gnutls_session_t, gnutls_params_type_t type, gnutls_params_st *st)
+{
+	if(type != GNUTLS_PARAMS_DH) return -1;
+
+	sptr<gnutls_dh_params_int> params = GetParams();
+	if(!params) return -1;	// fall back to the predefined group
+
+	// The session owns a copy, so credentials shared between threads are never modified
+	gnutls_dh_params_t copy;
+	if(gnutls_dh_params_init(&copy) != GNUTLS_E_SUCCESS) return -1;
+	if(gnutls_dh_params_cpy(copy, params.get()) != GNUTLS_E_SUCCESS)
+	{
+		gnutls_dh_params_deinit(copy);
+		return -1;
+	}
+
+	st->type = GNUTLS_PARAMS_DH;
+	st->params.dh = copy;
+	st->deinit = 1;
+	return 0;
 }
 
 SecureTransport::SecureTransport(Stream *stream, bool server) :
 	mStream(stream),
 	mVerifier(NULL),
 	mPriorities(DefaultPriorities),
+	mSocket(NULL),
+	mReadAhead(NULL),
+	mReadAheadCapacity(0),
+	mReadAheadSize(0),
+	mReadAheadOffset(0),
+	mWriteCoalescing(false),
+	mCorked(false),
+	mBlocking(true),
 	mBuffer(NULL),
 	mBufferSize(0),
 	mBufferOffset(0),
+	mHandshakeTimeout(DefaultTimeout),
+	mIsHandshakeStarted(false),
 	mIsHandshakeDone(false),
 	mIsByeDone(false)
 {
 	Assert(stream);
 
-	if(server && Random().uniform(0, 1000) == 0)
-		GenerateParams();
-
 	// Init session
 	unsigned int flags = (server ? GNUTLS_SERVER : GNUTLS_CLIENT);
 	if(stream->isDatagram()) flags|= GNUTLS_DATAGRAM;
@@ -90,6 +310,70 @@ SecureTransport::SecureTransport(Stream *stream, bool server) :
 
 		setHandshakeTimeout(DefaultTimeout);
 
+		if(DefaultMaxRecordSize)
+			setMaxRecordSize(DefaultMaxRecordSize);
+
+		if(!stream->isDatagram())
+		{
+			// Records are pushed in a single call when they are flushed together
+			mSocket = dynamic_cast<Socket*>(stream);
+			if(mSocket)
+				gnutls_transport_set_vec_push_function(mSession, WriteVectorCallback);
+
+			if(ReadAheadSize)
+			{
+				mReadAheadCapacity = ReadAheadSize;
+				mReadAhead = new char[mReadAheadCapacity];
+			}
+		}
+
+		if(server)
+		{
+			{
+				std::unique_lock<std::mutex> lock(SessionsMutex);
+				mSessionCache = ServerSessions;
+			}
+
+			// Session ID resumption through the server-side cache
+			if(mSessionCache)
+			{
+				gnutls_db_set_ptr(mSession, mSessionCache.get());
+				gnutls_db_set_store_function(mSession, StoreSessionCallback);
+				gnutls_db_set_retrieve_function(mSession, RetrieveSessionCallback);
+				gnutls_db_set_remove_function(mSession, RemoveSessionCallback);
+			}
+
+			// Session tickets, the master key is generated once
+			if(SessionTickets)
+			{
+				std::unique_lock<std::mutex> lock(TicketKeyMutex);
+				if(!TicketKey.data)
+				{
+					int ret = gnutls_session_ticket_key_generate(&TicketKey);
+					if(ret != GNUTLS_E_SUCCESS) throw Exception(String("Unable to generate session ticket key: ") + ErrorString(ret));
+				}
+
+				// The key is copied into the session
+				int ret = gnutls_session_ticket_enable_server(mSession, &TicketKey);
+				if(ret != GNUTLS_E_SUCCESS) throw Exception(String("Unable to enable session tickets: ") + ErrorString(ret));
+
+				// gnutls rotates the keys derived from the master key every three ticket lifetimes and still decrypts
+				// with the previous one, so outstanding tickets remain valid across a rotation instead of all failing
+				int lifetime = int(std::max(seconds(TicketKeyRotation).count()/3., 1.));
+				gnutls_db_set_cache_expiration(mSession, lifetime);
+			}
+		}
+		else {
+			{
+				std::unique_lock<std::mutex> lock(SessionsMutex);
+				mSessionCache = ClientSessions;
+			}
+
+			// Tickets may be received after the handshake with TLS 1.3
+			if(mSessionCache)
+				gnutls_handshake_set_hook_function(mSession, GNUTLS_HANDSHAKE_NEW_SESSION_TICKET, GNUTLS_HOOK_POST, SessionTicketCallback);
+		}
+
 		if(stream->isDatagram())
 		{
 			mBuffer = new char[DatagramSocket::MaxDatagramSize];
@@ -99,6 +383,7 @@ SecureTransport::SecureTransport(Stream *stream, bool server) :
 	catch(...)
 	{
 		gnutls_deinit(mSession);
+		delete[] mReadAhead;
 		throw;
 	}
 }
@@ -111,6 +396,7 @@ SecureTransport::~SecureTransport(void)
 
 	delete mStream;
 	delete[] mBuffer;
+	delete[] mReadAhead;
 
 	for(auto c : mCredsToDelete)
 		delete c;
@@ -125,10 +411,18 @@ void SecureTransport::addCredentials(Credentials *creds, bool mustDelete)
 		mCredsToDelete.push_back(creds);
 }
 
+void SecureTransport::addCredentials(sptr<Credentials> creds)
+{
+	Assert(creds);
+	creds->install(this);
+	mSharedCreds.push_back(creds);
+}
+
 void SecureTransport::setHandshakeTimeout(duration timeout)
 {
 	if(!isHandshakeDone())
 	{
+		mHandshakeTimeout = timeout;
 		gnutls_handshake_set_timeout(mSession,
 			std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
 		setDatagramTimeout(timeout, seconds(1.));
@@ -151,21 +445,80 @@ void SecureTransport::setDatagramTimeout(duration timeout, duration retransTimeo
 	}
 }
 
+void SecureTransport::setMaxRecordSize(size_t size)
+{
+	if(isHandshakeDone())
+		throw Exception("Unable to set maximum record size: handshake is done");
+
+	ssize_t ret = gnutls_record_set_max_size(mSession, size);
+	if(ret < 0) throw Exception(String("Unable to set maximum record size: ") + ErrorString(int(ret)));
+}
+
+void SecureTransport::setWriteCoalescing(bool enabled)
+{
+	if(!enabled) uncork();
+	mWriteCoalescing = enabled && mBlocking && !isDatagram();
+}
+
 void SecureTransport::handshake(void)
 {
-	// Set priorities
-	//LogDebug("SecureTransport::handshake", "Setting priorities: " + mPriorities);
-	const char *err_pos = NULL;
-	if(gnutls_priority_set_direct(mSession, mPriorities.c_str(), &err_pos))
-			throw Exception("Unable to set TLS priorities: " + mPriorities);
+	if(!mBlocking)
+		throw Exception("Blocking handshake on non-blocking secure transport");
 
-	if(isClient())
+	// Only server handshakes are offloaded, clients run inline
+	sptr<HandshakeExecutor> executor;
+	if(!isClient()) executor = GetHandshakeExecutor();
+	if(!executor)
 	{
-		 // Set server name
-		if(!mHostname.empty())
-			gnutls_server_name_set(mSession, GNUTLS_NAME_DNS, mHostname.data(), mHostname.size());
+		performHandshake();
+		return;
 	}
 
+	// Steps run non-blocking on the executor while waiting for the peer happens here,
+	// the flag is changed directly so write coalescing is kept for after the handshake
+	using clock = std::chrono::steady_clock;
+	const clock::time_point start = clock::now();
+	mBlocking = false;
+	try {
+		Status status;
+		while((status = executor->step(this)) != Success)
+		{
+			duration timeout = duration(-1.);
+			if(mHandshakeTimeout >= duration::zero())
+			{
+				timeout = mHandshakeTimeout - (clock::now() - start);
+				if(timeout <= duration::zero()) throw Timeout();
+			}
+
+			if(isDatagram())
+			{
+				// The next step retransmits if nothing was received
+				duration next = nextTimeout();
+				if(next >= duration::zero() && (timeout < duration::zero() || next < timeout)) timeout = next;
+				mStream->waitData(timeout);
+			}
+			else if(status == WantWrite && mSocket)
+			{
+				if(!mSocket->waitWriteable(timeout)) throw Timeout();
+			}
+			else {
+				if(!mStream->waitData(timeout)) throw Timeout();
+			}
+		}
+	}
+	catch(...)
+	{
+		mBlocking = true;
+		throw;
+	}
+
+	mBlocking = true;
+}
+
+void SecureTransport::performHandshake(void)
+{
+	prepareHandshake();
+
 	// Perform the TLS handshake
 	//LogDebug("SecureTransport::handshake", "Performing handshake...");
 	int ret;
@@ -180,19 +533,80 @@ void SecureTransport::handshake(void)
 		else throw Exception(String("TLS handshake failed: ") + ErrorString(ret));
 	}
 
+	finishHandshake();
+}
+
+void SecureTransport::prepareHandshake(void)
+{
+	if(mIsHandshakeStarted) return;
+	mIsHandshakeStarted = true;
+
+	// Set priorities
+	//LogDebug("SecureTransport::handshake", "Setting priorities: " + mPriorities);
+	const char *err_pos = NULL;
+	if(gnutls_priority_set_direct(mSession, mPriorities.c_str(), &err_pos))
+			throw Exception("Unable to set TLS priorities: " + mPriorities);
+
+	if(isClient())
+	{
+		 // Set server name
+		if(!mHostname.empty())
+			gnutls_server_name_set(mSession, GNUTLS_NAME_DNS, mHostname.data(), mHostname.size());
+
+		// Try to resume a previous session
+		if(mSessionCache)
+		{
+			BinaryString key = clientSessionKey();
+			BinaryString data;
+			if(!key.empty() && mSessionCache->get(key, data))
+				gnutls_session_set_data(mSession, data.data(), data.size());
+		}
+	}
+}
+
+void SecureTransport::finishHandshake(void)
+{
 	mIsHandshakeDone = true;
 	mIsByeDone = false;
+
+	int index = (isClient() ? 1 : 0);
+	if(isResumed()) ++ResumedHandshakes[index];
+	else {
+		++FullHandshakes[index];
+
+		// With TLS 1.3, session data is only usable once a ticket is received
+		if(isClient() && mSessionCache && gnutls_protocol_get_version(mSession) != GNUTLS_TLS1_3)
+			storeClientSession();
+	}
 }
 
 void SecureTransport::close(void)
 {
+	if(!mBlocking)
+	{
+		// Do not wait, the close notification is best effort
+		if(!mIsByeDone && tryClose() != Success)
+		{
+			mIsByeDone = true;
+			if(mStream)
+				mStream->close();
+		}
+		return;
+	}
+
 	if(!mIsByeDone)
 	{
-		int ret;
-		do {
-			ret = gnutls_bye(mSession, GNUTLS_SHUT_RDWR);
+		// No close notification if the handshake never started (e.g. it was shed)
+		if(mIsHandshakeStarted)
+		{
+			uncork();
+
+			int ret;
+			do {
+				ret = gnutls_bye(mSession, GNUTLS_SHUT_RDWR);
+			}
+			while (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN);
 		}
-		while (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN);
 
 		mIsByeDone = true;
 
@@ -201,6 +615,114 @@ void SecureTransport::close(void)
 	}
 }
 
+void SecureTransport::setBlocking(bool enabled)
+{
+	if(!enabled) setWriteCoalescing(false);
+	mBlocking = enabled;
+}
+
+bool SecureTransport::isBlocking(void) const
+{
+	return mBlocking;
+}
+
+SecureTransport::Status SecureTransport::tryHandshake(void)
+{
+	if(mIsHandshakeDone) return Success;
+	prepareHandshake();
+
+	int ret;
+	do {
+		ret = gnutls_handshake(mSession);
+	}
+	while (ret == GNUTLS_E_INTERRUPTED);
+
+	if(ret == GNUTLS_E_AGAIN) return direction();
+	if(ret < 0)
+	{
+		if(ret == GNUTLS_E_TIMEDOUT) throw Timeout();
+		else throw Exception(String("TLS handshake failed: ") + ErrorString(ret));
+	}
+
+	finishHandshake();
+	return Success;
+}
+
+SecureTransport::Status SecureTransport::tryRead(char *buffer, size_t size, size_t &count)
+{
+	count = 0;
+
+	ssize_t ret;
+	do {
+		ret = gnutls_record_recv(mSession, buffer, size);
+	}
+	while (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_REHANDSHAKE);
+
+	if(ret == GNUTLS_E_AGAIN) return direction();
+	if(ret == 0 || ret == GNUTLS_E_PREMATURE_TERMINATION) return Closed;
+	if(ret < 0) throw Exception(ErrorString(ret));
+
+	count = size_t(ret);
+	return Success;
+}
+
+SecureTransport::Status SecureTransport::tryWrite(const char *data, size_t size, size_t &count)
+{
+	count = 0;
+	if(!size) return Success;
+
+	ssize_t ret;
+	do {
+		ret = gnutls_record_send(mSession, data, size);
+	}
+	while (ret == GNUTLS_E_INTERRUPTED);
+
+	if(ret == GNUTLS_E_AGAIN) return direction();
+	if(ret < 0) throw Exception(ErrorString(ret));
+
+	count = size_t(ret);
+	return Success;
+}
+
+SecureTransport::Status SecureTransport::tryClose(void)
+{
+	if(mIsByeDone) return Success;
+
+	if(!mIsHandshakeStarted)
+	{
+		mIsByeDone = true;
+		if(mStream)
+			mStream->close();
+		return Success;
+	}
+
+	int ret;
+	do {
+		ret = gnutls_bye(mSession, GNUTLS_SHUT_WR);
+	}
+	while (ret == GNUTLS_E_INTERRUPTED);
+
+	if(ret == GNUTLS_E_AGAIN) return direction();
+
+	mIsByeDone = true;
+	if(mStream)
+		mStream->close();
+
+	if(ret < 0) throw Exception(ErrorString(ret));
+	return Success;
+}
+
+duration SecureTransport::nextTimeout(void) const
+{
+	if(!isDatagram()) return duration(-1.);
+	return milliseconds(double(gnutls_dtls_get_timeout(mSession)));
+}
+
+SecureTransport::Status SecureTransport::direction(void) const
+{
+	return gnutls_record_get_direction(mSession) ? WantWrite : WantRead;
+}
+
 void SecureTransport::setHostname(const String &hostname)
 {
 	if(isHandshakeDone())
@@ -209,6 +731,36 @@ void SecureTransport::setHostname(const String &hostname)
 	mHostname = hostname;
 }
 
+void SecureTransport::setProtocols(const List<String> &protocols)
+{
+	if(isHandshakeDone())
+		throw Exception("Unable to set secure transport protocols: handshake is done");
+
+	std::vector<gnutls_datum_t> datums;
+	for(List<String>::const_iterator it = protocols.begin(); it != protocols.end(); ++it)
+	{
+		gnutls_datum_t datum;
+		datum.data = reinterpret_cast<unsigned char*>(const_cast<char*>(it->data()));
+		datum.size = unsigned(it->size());
+		datums.push_back(datum);
+	}
+
+	// The server picks its preferred protocol among the ones offered
+	unsigned flags = (isClient() ? 0 : GNUTLS_ALPN_SERVER_PRECEDENCE);
+	int ret = gnutls_alpn_set_protocols(mSession, datums.data(), unsigned(datums.size()), flags);
+	if(ret != GNUTLS_E_SUCCESS)
+		throw Exception(String("Unable to set secure transport protocols: ") + ErrorString(ret));
+}
+
+String SecureTransport::getProtocol(void) const
+{
+	gnutls_datum_t protocol;
+	if(gnutls_alpn_get_selected_protocol(mSession, &protocol) != GNUTLS_E_SUCCESS)
+		return "";
+
+	return String(reinterpret_cast<const char*>(protocol.data), protocol.size);
+}
+
 bool SecureTransport::isClient(void) const
 {
 	return true;
@@ -219,6 +771,11 @@ bool SecureTransport::isHandshakeDone(void) const
 	return mIsHandshakeDone;
 }
 
+bool SecureTransport::isResumed(void) const
+{
+	return mIsHandshakeDone && gnutls_session_is_resumed(mSession) != 0;
+}
+
 bool SecureTransport::isAnonymous(void) const
 {
 	return gnutls_auth_get_type(mSession) == GNUTLS_CRD_ANON;
@@ -241,8 +798,16 @@ String SecureTransport::getPrivateSharedKeyHint(void) const
 	else return "";
 }
 
+Socket *SecureTransport::socket(void) const
+{
+	return mSocket;
+}
+
 size_t SecureTransport::readData(char *buffer, size_t size)
 {
+	if(!mBlocking)
+		throw Exception("Blocking read on non-blocking secure transport");
+
 	if(isDatagram())
 	{
 		if(!mBuffer) return 0;
@@ -276,6 +841,8 @@ size_t SecureTransport::readData(char *buffer, size_t size)
 		return size;
 	}
 	else {
+		uncork();
+
 		ssize_t ret;
 		do {
 			ret = gnutls_record_recv(mSession, buffer, size);
@@ -294,11 +861,21 @@ void SecureTransport::writeData(const char *data, size_t size)
 {
 	if(!size) return;
 
+	if(!mBlocking)
+		throw Exception("Blocking write on non-blocking secure transport");
+
 	if(isDatagram())
 	{
 		mWriteBuffer.writeBinary(data, size);
 	}
 	else {
+		// While corked, records are buffered by gnutls
+		if(mWriteCoalescing && !mCorked)
+		{
+			gnutls_record_cork(mSession);
+			mCorked = true;
+		}
+
 		do {
 			ssize_t ret;
 			do {
@@ -313,6 +890,9 @@ void SecureTransport::writeData(const char *data, size_t size)
 			size-= ret;
 		}
 		while(size);
+
+		if(mCorked && gnutls_record_check_corked(mSession) >= CoalescingSize)
+			uncork();
 	}
 }
 
@@ -343,6 +923,38 @@ bool SecureTransport::nextWrite(void)
 	return true;
 }
 
+bool SecureTransport::waitData(duration timeout)
+{
+	// Data may already be decrypted or read ahead
+	if(mBufferOffset < mBufferSize) return true;
+	if(gnutls_record_check_pending(mSession) > 0) return true;
+	if(mReadAheadOffset < mReadAheadSize) return true;
+
+	// The peer could be waiting for coalesced data before sending
+	uncork();
+	return mStream->waitData(timeout);
+}
+
+void SecureTransport::flush(void)
+{
+	uncork();
+	if(mStream) mStream->flush();
+}
+
+void SecureTransport::uncork(void)
+{
+	if(!mCorked) return;
+	mCorked = false;
+
+	int ret;
+	do {
+		ret = gnutls_record_uncork(mSession, GNUTLS_RECORD_WAIT);
+	}
+	while (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN);
+
+	if(ret < 0) throw Exception(ErrorString(ret));
+}
+
 bool SecureTransport::isDatagram(void) const
 {
 	return mStream->isDatagram();
@@ -393,18 +1005,72 @@ ssize_t SecureTransport::WriteCallback(gnutls_transport_ptr_t ptr, const void* d
 	return -1;
 }
 
+ssize_t SecureTransport::WriteVectorCallback(gnutls_transport_ptr_t ptr, const giovec_t *iov, int iovcnt)
+{
+	SecureTransport *st = static_cast<SecureTransport*>(ptr);
+	if(!st->mStream || !st->mSocket) return 0;
+
+	try {
+		if(!st->mBlocking)
+		{
+			ssize_t ret = st->mSocket->tryWriteData(iov, iovcnt);
+			gnutls_transport_set_errno(st->mSession, ret < 0 ? EAGAIN : 0);
+			return ret;
+		}
+
+		size_t len = 0;
+		for(int i = 0; i < iovcnt; ++i)
+			len+= iov[i].iov_len;
+
+		st->mSocket->writeData(iov, iovcnt);
+		gnutls_transport_set_errno(st->mSession, 0);
+		return ssize_t(len);
+	}
+	catch(const Timeout &timeout)
+	{
+		LogDebug("SecureTransport::WriteVectorCallback", "Timeout");
+		gnutls_transport_set_errno(st->mSession, ETIMEDOUT);
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("SecureTransport::WriteVectorCallback", e.what());
+		gnutls_transport_set_errno(st->mSession, ECONNRESET);
+	}
+
+	return -1;
+}
+
 ssize_t SecureTransport::ReadCallback(gnutls_transport_ptr_t ptr, void* data, size_t maxlen)
 {
 	SecureTransport *st = static_cast<SecureTransport*>(ptr);
 	if(!st->mStream) return 0;
 
 	try {
-		ssize_t ret;
-		do {
-			ret = st->mStream->readData(static_cast<char*>(data), maxlen);
+		// Read ahead so a single transport read serves several pulls
+		if(st->mReadAhead && (st->mReadAheadOffset < st->mReadAheadSize || maxlen < st->mReadAheadCapacity))
+		{
+			if(st->mReadAheadOffset == st->mReadAheadSize)
+			{
+				ssize_t ret = st->pull(st->mReadAhead, st->mReadAheadCapacity);
+				if(ret < 0)
+				{
+					gnutls_transport_set_errno(st->mSession, EAGAIN);
+					return -1;
+				}
+
+				st->mReadAheadOffset = 0;
+				st->mReadAheadSize = size_t(ret);
+			}
+
+			size_t len = std::min(maxlen, st->mReadAheadSize - st->mReadAheadOffset);
+			std::memcpy(data, st->mReadAhead + st->mReadAheadOffset, len);
+			st->mReadAheadOffset+= len;
+			gnutls_transport_set_errno(st->mSession, 0);
+			return ssize_t(len);
 		}
-		while(st->mStream->nextRead() && ret == 0);
-		gnutls_transport_set_errno(st->mSession, 0);
+
+		ssize_t ret = st->pull(static_cast<char*>(data), maxlen);
+		gnutls_transport_set_errno(st->mSession, ret < 0 ? EAGAIN : 0);
 		return ret;
 	}
 	catch(const Timeout &timeout)
@@ -417,8 +1083,22 @@ ssize_t SecureTransport::ReadCallback(gnutls_transport_ptr_t ptr, void* data, si
 		LogDebug("SecureTransport::ReadCallback", e.what());
 		gnutls_transport_set_errno(st->mSession, ECONNRESET);
 	}
-
-	return -1;
+
+	return -1;
+}
+
+ssize_t SecureTransport::pull(char *buffer, size_t size)
+{
+	if(!mBlocking && mSocket)
+		return mSocket->tryReadData(buffer, size);
+
+	ssize_t ret;
+	do {
+		if(!mBlocking && !mStream->waitData(duration::zero())) return -1;
+		ret = mStream->readData(buffer, size);
+	}
+	while(mStream->nextRead() && ret == 0);
+	return ret;
 }
 
 int SecureTransport::TimeoutCallback(gnutls_transport_ptr_t ptr, unsigned int ms)
@@ -426,6 +1106,14 @@ int SecureTransport::TimeoutCallback(gnutls_transport_ptr_t ptr, unsigned int ms
 	SecureTransport *st = static_cast<SecureTransport*>(ptr);
 	try {
 		gnutls_transport_set_errno(st->mSession, 0);
+		if(st->mReadAheadOffset < st->mReadAheadSize) return 1;
+		if(!st->mBlocking)
+		{
+			// Report would-block instead of timeout
+			if(st->mStream->waitData(duration::zero())) return 1;
+			gnutls_transport_set_errno(st->mSession, EAGAIN);
+			return -1;
+		}
 		if(st->mStream->waitData(milliseconds(ms))) return 1;
 		else return 0;
 	}
@@ -608,6 +1296,90 @@ int SecureTransport::PrivateSharedKeyClientCallback(gnutls_session_t session, ch
 	return 0;
 }
 
+void SecureTransport::storeClientSession(void)
+{
+	BinaryString key = clientSessionKey();
+	if(key.empty()) return;
+
+	gnutls_datum_t data;
+	if(gnutls_session_get_data2(mSession, &data) == GNUTLS_E_SUCCESS)
+	{
+		mSessionCache->set(key, BinaryString(reinterpret_cast<const char*>(data.data), data.size));
+		gnutls_free(data.data);
+	}
+}
+
+BinaryString SecureTransport::clientSessionKey(void) const
+{
+	String key;
+	try {
+		Address remote;
+		if(const Socket *sock = dynamic_cast<const Socket*>(mStream)) remote = sock->getRemoteAddress();
+		else if(const DatagramStream *stream = dynamic_cast<const DatagramStream*>(mStream)) remote = stream->getRemoteAddress();
+
+		if(!remote.isNull()) key = remote.toString();
+	}
+	catch(const NetException &e)
+	{
+		// No address available
+	}
+
+	if(!mHostname.empty())
+		key = mHostname + "@" + key;
+
+	if(key.empty()) return BinaryString();
+	return BinaryString(key + " " + mPriorities);	// priorities depend on credentials
+}
+
+int SecureTransport::SessionTicketCallback(gnutls_session_t session, unsigned int htype, unsigned when, unsigned int incoming, const gnutls_datum_t *msg)
+{
+	SecureTransport *transport = reinterpret_cast<SecureTransport*>(gnutls_session_get_ptr(session));
+	if(!transport || !transport->mSessionCache) return 0;
+
+	try {
+		if(htype == GNUTLS_HANDSHAKE_NEW_SESSION_TICKET && incoming)
+			transport->storeClientSession();
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("SecureTransport::SessionTicketCallback", e.what());
+	}
+
+	return 0;
+}
+
+int SecureTransport::StoreSessionCallback(void *ptr, gnutls_datum_t key, gnutls_datum_t data)
+{
+	SessionCache *cache = static_cast<SessionCache*>(ptr);
+	cache->set(BinaryString(reinterpret_cast<const char*>(key.data), key.size),
+		BinaryString(reinterpret_cast<const char*>(data.data), data.size));
+	return 0;
+}
+
+gnutls_datum_t SecureTransport::RetrieveSessionCallback(void *ptr, gnutls_datum_t key)
+{
+	gnutls_datum_t result = { NULL, 0 };
+
+	SessionCache *cache = static_cast<SessionCache*>(ptr);
+	BinaryString data;
+	if(cache->get(BinaryString(reinterpret_cast<const char*>(key.data), key.size), data))
+	{
+		result.size = data.size();
+		result.data = static_cast<unsigned char *>(gnutls_malloc(result.size));
+		if(!result.data) result.size = 0;
+		else std::memcpy(result.data, data.data(), result.size);
+	}
+
+	return result;
+}
+
+int SecureTransport::RemoveSessionCallback(void *ptr, gnutls_datum_t key)
+{
+	SessionCache *cache = static_cast<SessionCache*>(ptr);
+	cache->remove(BinaryString(reinterpret_cast<const char*>(key.data), key.size));
+	return 0;
+}
+
 String SecureTransport::ErrorString(int code)
 {
 	switch(code)
@@ -618,6 +1390,205 @@ String SecureTransport::ErrorString(int code)
 	}
 }
 
+SecureTransport::SessionCache::SessionCache(size_t capacity) :
+	mCapacity(std::max(capacity, size_t(1)))
+{
+
+}
+
+SecureTransport::SessionCache::~SessionCache(void)
+{
+
+}
+
+bool SecureTransport::SessionCache::get(const BinaryString &key, BinaryString &data)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = mIndex.find(key);
+	if(it == mIndex.end()) return false;
+
+	// Move to front
+	mEntries.splice(mEntries.begin(), mEntries, it->second);
+	data = it->second->second;
+	return true;
+}
+
+void SecureTransport::SessionCache::set(const BinaryString &key, const BinaryString &data)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = mIndex.find(key);
+	if(it != mIndex.end())
+	{
+		it->second->second = data;
+		mEntries.splice(mEntries.begin(), mEntries, it->second);
+		return;
+	}
+
+	mEntries.push_front(std::make_pair(key, data));
+	mIndex[key] = mEntries.begin();
+
+	// Evict least recently used
+	while(mEntries.size() > mCapacity)
+	{
+		mIndex.erase(mEntries.back().first);
+		mEntries.pop_back();
+	}
+}
+
+void SecureTransport::SessionCache::remove(const BinaryString &key)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = mIndex.find(key);
+	if(it != mIndex.end())
+	{
+		mEntries.erase(it->second);
+		mIndex.erase(it);
+	}
+}
+
+void SecureTransport::SessionCache::clear(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIndex.clear();
+	mEntries.clear();
+}
+
+size_t SecureTransport::SessionCache::size(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+SecureTransport::HandshakeExecutor::HandshakeExecutor(size_t concurrency) :
+	mPool(concurrency),
+	mQueueBudget(seconds(-1.)),
+	mMaxQueueDepth(0)
+{
+	Assert(concurrency > 0);
+
+	mStats.completed = 0;
+	mStats.failed = 0;
+	mStats.shed = 0;
+	mStats.queueDepth = 0;
+	mStats.maxQueueDepth = 0;
+}
+
+SecureTransport::HandshakeExecutor::~HandshakeExecutor(void)
+{
+	mPool.join();
+}
+
+void SecureTransport::HandshakeExecutor::setQueueBudget(duration budget)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mQueueBudget = budget;
+}
+
+void SecureTransport::HandshakeExecutor::setMaxQueueDepth(size_t depth)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mMaxQueueDepth = depth;
+}
+
+SecureTransport::HandshakeExecutor::Stats SecureTransport::HandshakeExecutor::stats(void) const
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+SecureTransport::Status SecureTransport::HandshakeExecutor::step(SecureTransport *transport)
+{
+	std::promise<Status> promise;
+	std::future<Status> result = promise.get_future();
+	submit(transport, [&promise](Status status, std::exception_ptr error)
+	{
+		if(error) promise.set_exception(error);
+		else promise.set_value(status);
+	});
+
+	return result.get();	// rethrows handshake exceptions
+}
+
+void SecureTransport::HandshakeExecutor::submit(SecureTransport *transport, Callback done)
+{
+	using clock = std::chrono::steady_clock;
+
+	{
+		// Handshakes in progress are never rejected, their client already paid a round trip
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(!transport->mIsHandshakeStarted && mMaxQueueDepth && mStats.queueDepth >= mMaxQueueDepth)
+		{
+			++mStats.shed;
+			lock.unlock();
+			done(Closed, std::make_exception_ptr(Exception("Handshake rejected: queue is full")));
+			return;
+		}
+
+		++mStats.queueDepth;
+		mStats.maxQueueDepth = std::max(mStats.maxQueueDepth, mStats.queueDepth);
+	}
+
+	const clock::time_point queued = clock::now();
+	try {
+		mPool.enqueue([this, transport, done, queued]()
+		{
+			Status status = Closed;
+			std::exception_ptr error;
+			try {
+				status = run(transport, queued);
+			}
+			catch(...)
+			{
+				error = std::current_exception();
+			}
+
+			done(status, error);
+		});
+	}
+	catch(...)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		--mStats.queueDepth;
+		throw;
+	}
+}
+
+SecureTransport::Status SecureTransport::HandshakeExecutor::run(SecureTransport *transport, std::chrono::steady_clock::time_point queued)
+{
+	using clock = std::chrono::steady_clock;
+
+	const clock::time_point started = clock::now();
+	duration waited = started - queued;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		--mStats.queueDepth;
+		mStats.queueTime.add(milliseconds(waited).count());
+
+		if(!transport->mIsHandshakeStarted && mQueueBudget >= duration::zero() && waited > mQueueBudget)
+		{
+			++mStats.shed;
+			throw Exception("Handshake shed: queue time budget exceeded");
+		}
+	}
+
+	Status status;
+	try {
+		status = transport->tryHandshake();
+	}
+	catch(...)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mStats.stepTime.add(milliseconds(clock::now() - started).count());
+		++mStats.failed;
+		throw;
+	}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mStats.stepTime.add(milliseconds(clock::now() - started).count());
+	if(status == Success) ++mStats.completed;
+	return status;
+}
+
 void SecureTransport::Credentials::install(SecureTransport *st)
 {
 	install(st->mSession, st->mPriorities);
@@ -634,6 +1605,10 @@ SecureTransport::Certificate::Certificate(void)
 
 	gnutls_certificate_set_verify_function(mCreds, SecureTransport::CertificateCallback);
 
+	// Set DH parameters, generated ones are provided per session
+	gnutls_certificate_set_known_dh_params(mCreds, GNUTLS_SEC_PARAM_HIGH);
+	gnutls_certificate_set_params_function(mCreds, SecureTransport::ParamsCallback);
+
 	// Set system CA
 	gnutls_certificate_set_x509_system_trust(mCreds);
 }
@@ -649,15 +1624,13 @@ SecureTransport::Certificate::Certificate(const String &certFilename, const Stri
 
 	gnutls_certificate_set_verify_function(mCreds, SecureTransport::CertificateCallback);
 
+	// Set DH parameters, generated ones are provided per session
+	gnutls_certificate_set_known_dh_params(mCreds, GNUTLS_SEC_PARAM_HIGH);
+	gnutls_certificate_set_params_function(mCreds, SecureTransport::ParamsCallback);
+
 	// Set system CA
 	gnutls_certificate_set_x509_system_trust(mCreds);
 
-	// Set DH parameters
-	{
-		std::unique_lock<std::mutex> lock(ParamsMutex);
-		gnutls_certificate_set_dh_params(mCreds, Params);
-	}
-
 	// Import certificate and private key
 	int ret = gnutls_certificate_set_x509_key_file2(mCreds,
 			certFilename.c_str(), keyFilename.c_str(),
@@ -953,6 +1926,7 @@ SecureTransport *SecureTransportServer::Listen(DatagramSocket &sock, Address *re
 				}
 
 				gnutls_dtls_prestate_set(transport->mSession, &prestate);
+				gnutls_free(cookieKey.data);
 				delete[] buffer;
 				return transport;
 			}
@@ -973,21 +1947,243 @@ SecureTransport *SecureTransportServer::Listen(DatagramSocket &sock, Address *re
 	}
 	catch(...)
 	{
+		gnutls_free(cookieKey.data);
 		delete[] buffer;
 		throw;
 	}
 }
 
+SecureTransportServer::DatagramListener::DatagramListener(DatagramSocket *sock, Credentials *creds, handler_t handler, size_t workers, bool requestClientCertificate) :
+	mSock(sock),
+	mCredentials(creds),
+	mHandler(std::move(handler)),
+	mRequestClientCertificate(requestClientCertificate),
+	mMaxPending(1024),
+	mStreamTimeout(seconds(-1.)),
+	mCookiesSent(0),
+	mHandshakes(0),
+	mFailures(0),
+	mDropped(0),
+	mJoining(false),
+	mPool(workers)
+{
+	Assert(mSock);
+	Assert(mCredentials);
+
+	// The cookie key is kept for the listener lifetime so cookies stay valid
+	Assert(gnutls_key_generate(&mCookieKey, GNUTLS_COOKIE_KEY_SIZE) == GNUTLS_E_SUCCESS);
+
+	mThread = std::thread([this]() {
+		run();
+	});
+}
+
+SecureTransportServer::DatagramListener::~DatagramListener(void)
+{
+	join();
+
+	gnutls_free(mCookieKey.data);
+}
+
+void SecureTransportServer::DatagramListener::setMaxPending(size_t count)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mMaxPending = count;
+}
+
+void SecureTransportServer::DatagramListener::setStreamTimeout(duration timeout)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mStreamTimeout = timeout;
+}
+
+SecureTransportServer::DatagramListener::Stats SecureTransportServer::DatagramListener::stats(void) const
+{
+	Stats s;
+	s.cookiesSent = mCookiesSent;
+	s.handshakes = mHandshakes;
+	s.failures = mFailures;
+	s.dropped = mDropped;
+	return s;
+}
+
+void SecureTransportServer::DatagramListener::join(void)
+{
+	if(mJoining.exchange(true)) return;
+
+	if(mThread.joinable())
+		mThread.join();
+
+	// Pending handshakes can't progress anymore, make them fail
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		for(auto transport : mPending)
+			if(transport->mStream)
+				transport->mStream->close();
+	}
+
+	mPool.join();
+}
+
+ssize_t SecureTransportServer::DatagramListener::CookieCallback(gnutls_transport_ptr_t ptr, const void* data, size_t len)
+{
+	const std::pair<DatagramSocket*, const Address*> *target = static_cast<const std::pair<DatagramSocket*, const Address*>*>(ptr);
+
+	try {
+		target->first->write(static_cast<const char*>(data), len, *target->second);
+		return ssize_t(len);
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("SecureTransportServer::DatagramListener::CookieCallback", e.what());
+		return -1;
+	}
+}
+
+void SecureTransportServer::DatagramListener::run(void)
+{
+	char buffer[DatagramSocket::MaxDatagramSize];
+
+	while(!mJoining)
+	{
+		// Datagrams from peers with a session are dispatched to their stream,
+		// so only datagrams from unknown peers are returned
+		Address sender;
+		int len;
+		try {
+			len = mSock->peek(buffer, DatagramSocket::MaxDatagramSize, sender, milliseconds(100.));
+		}
+		catch(const std::exception &e)
+		{
+			LogWarn("SecureTransportServer::DatagramListener", e.what());
+			break;
+		}
+
+		if(len < 0) continue;
+
+		gnutls_dtls_prestate_st prestate;
+		std::memset(&prestate, 0, sizeof(prestate));
+
+		int ret = gnutls_dtls_cookie_verify(&mCookieKey,
+						const_cast<sockaddr*>(sender.addr()),
+						sender.addrLen(),
+						buffer, len,
+						&prestate);
+
+		// On success, the ClientHello is left queued and will be dispatched to the new stream
+		if(ret == GNUTLS_E_SUCCESS && accept(sender, prestate))
+			continue;
+
+		NOEXCEPTION(mSock->read(buffer, DatagramSocket::MaxDatagramSize, sender, duration::zero()));
+
+		// Answer only ClientHellos without a valid cookie, no state is kept
+		if(ret == GNUTLS_E_BAD_COOKIE)
+		{
+			std::pair<DatagramSocket*, const Address*> target(mSock, &sender);
+			gnutls_dtls_cookie_send(&mCookieKey,
+						const_cast<sockaddr*>(sender.addr()),
+						sender.addrLen(),
+						&prestate,
+						static_cast<gnutls_transport_ptr_t>(&target),
+						CookieCallback);
+			++mCookiesSent;
+		}
+	}
+}
+
+bool SecureTransportServer::DatagramListener::accept(const Address &sender, gnutls_dtls_prestate_st &prestate)
+{
+	duration streamTimeout;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if(mPending.size() >= mMaxPending)
+		{
+			++mDropped;
+			return false;
+		}
+
+		streamTimeout = mStreamTimeout;
+	}
+
+	SecureTransportServer *transport = NULL;
+	try {
+		DatagramStream *stream = new DatagramStream(mSock, sender);
+		try {
+			if(streamTimeout > duration::zero()) stream->setTimeout(streamTimeout);
+			transport = new SecureTransportServer(stream, NULL, mRequestClientCertificate);
+		}
+		catch(...)
+		{
+			delete stream;
+			throw;
+		}
+
+		gnutls_dtls_prestate_set(transport->mSession, &prestate);
+		transport->addCredentials(mCredentials);
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mPending.insert(transport);
+		mPool.enqueue([this, transport, sender]() {
+			handshake(transport, sender);
+		});
+		return true;
+	}
+	catch(const std::exception &e)
+	{
+		LogWarn("SecureTransportServer::DatagramListener", e.what());
+		if(transport)
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mPending.erase(transport);
+		}
+		delete transport;
+		++mFailures;
+		return false;
+	}
+}
+
+void SecureTransportServer::DatagramListener::handshake(SecureTransportServer *transport, const Address &sender)
+{
+	bool success = false;
+	try {
+		transport->handshake();
+		success = true;
+	}
+	catch(const std::exception &e)
+	{
+		LogDebug("SecureTransportServer::DatagramListener", String("DTLS handshake failed: ") + e.what());
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mPending.erase(transport);
+	}
+
+	if(!success)
+	{
+		++mFailures;
+		delete transport;
+		return;
+	}
+
+	++mHandshakes;
+	try {
+		mHandler(transport, sender);
+	}
+	catch(const std::exception &e)
+	{
+		LogWarn("SecureTransportServer::DatagramListener", String("Unhandled exception in handler: ") + e.what());
+	}
+}
+
 SecureTransportServer::Anonymous::Anonymous(void)
 {
 	// Allocate anonymous credentials
 	Assert(gnutls_anon_allocate_server_credentials(&mCreds) == GNUTLS_E_SUCCESS);
 
-	// Set DH parameters
-	{
-		std::unique_lock<std::mutex> lock(ParamsMutex);
-		gnutls_anon_set_server_dh_params(mCreds, Params);
-	}
+	// Set DH parameters, generated ones are provided per session
+	gnutls_anon_set_server_known_dh_params(mCreds, GNUTLS_SEC_PARAM_HIGH);
+	gnutls_anon_set_server_params_function(mCreds, SecureTransport::ParamsCallback);
 }
 
 SecureTransportServer::Anonymous::~Anonymous(void)
@@ -1010,14 +2206,12 @@ SecureTransportServer::PrivateSharedKey::PrivateSharedKey(const String &hint)
 	if(!hint.empty())
 		Assert(gnutls_psk_set_server_credentials_hint(mCreds, hint.c_str()) == GNUTLS_E_SUCCESS);
 
-	// Set DH parameters
-	{
-		std::unique_lock<std::mutex> lock(ParamsMutex);
-		gnutls_psk_set_server_dh_params(mCreds, Params);
-	}
-
 	// Set PSK callback
 	gnutls_psk_set_server_credentials_function(mCreds, SecureTransport::PrivateSharedKeyCallback);
+
+	// Set DH parameters, generated ones are provided per session
+	gnutls_psk_set_server_known_dh_params(mCreds, GNUTLS_SEC_PARAM_HIGH);
+	gnutls_psk_set_server_params_function(mCreds, SecureTransport::ParamsCallback);
 }
 
 SecureTransportServer::PrivateSharedKey::~PrivateSharedKey(void)
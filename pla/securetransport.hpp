@@ -29,10 +29,17 @@
 #include "pla/crypto.hpp"
 #include "pla/serversocket.hpp"
 #include "pla/datagramsocket.hpp"
+#include "pla/threadpool.hpp"
+#include "pla/histogram.hpp"
+#include "pla/set.hpp"
 
 #include <gnutls/gnutls.h>
 #include <gnutls/abstract.h>
 #include <gnutls/x509.h>
+#include <gnutls/dtls.h>
+
+#include <atomic>
+#include <memory>
 
 namespace pla
 {
@@ -42,10 +49,101 @@ class SecureTransport : public Stream
 public:
 	static duration DefaultTimeout;
 	static String DefaultPriorities;
+	static size_t DefaultMaxRecordSize;	// 0 means protocol default
+	static size_t ReadAheadSize;		// buffered transport reads in stream mode, 0 disables
+	static size_t CoalescingSize;		// coalesced writes are sent once reaching this size
+
+	static bool SessionTickets;			// server-side session tickets, enabled by default
+	static duration TicketKeyRotation;	// ticket keys are rotated after this period and still accepted during the next one
+
+	// DH parameters are generated in background, predefined groups are used until available
+	// Settings must be changed before Init()
+	static bool PredefinedGroups;		// only use RFC 7919 groups, never generate parameters
+	static String ParamsFile;			// persistence file for DH parameters, empty to disable
+	static duration ParamsRotation;		// interval between background generations
+	static unsigned ParamsBits;
 
 	static void Init(void);
 	static void Cleanup(void);
-	static void GenerateParams(void);
+	static void GenerateParams(void);	// synchronous, swaps the new parameters in
+
+	// Bounded LRU cache of session data for resumption
+	class SessionCache
+	{
+	public:
+		SessionCache(size_t capacity);
+		~SessionCache(void);
+
+		bool get(const BinaryString &key, BinaryString &data);
+		void set(const BinaryString &key, const BinaryString &data);
+		void remove(const BinaryString &key);
+		void clear(void);
+		size_t size(void) const;
+
+	private:
+		typedef std::list<std::pair<BinaryString, BinaryString> > entries_t;
+		entries_t mEntries;	// most recently used first
+		std::map<BinaryString, entries_t::iterator> mIndex;
+		size_t mCapacity;
+		mutable std::mutex mMutex;
+	};
+
+	struct ResumptionStats
+	{
+		uint64_t full;
+		uint64_t resumed;
+		double hitRate(void) const { return full + resumed ? double(resumed)/double(full + resumed) : 0.; }
+	};
+
+	static void SetServerSessionCache(size_t capacity);	// session ID cache, 0 disables (default)
+	static void SetClientSessionCache(size_t capacity);	// keyed by hostname or address, 0 disables
+	static ResumptionStats GetResumptionStats(bool isClient);
+
+	// Result of non-blocking calls, see setBlocking()
+	enum Status { Success, WantRead, WantWrite, Closed };
+
+	// Dedicated executor for server handshakes, limiting the concurrency of asymmetric crypto
+	// Handshakes are driven in non-blocking steps, so a slot is only held while computing
+	// and never while waiting for the peer
+	class HandshakeExecutor
+	{
+	public:
+		struct Stats
+		{
+			Histogram queueTime;	// milliseconds, per step
+			Histogram stepTime;		// milliseconds, per step excluding queue time
+			uint64_t completed;
+			uint64_t failed;
+			uint64_t shed;
+			size_t queueDepth;
+			size_t maxQueueDepth;
+		};
+
+		typedef std::function<void(Status status, std::exception_ptr error)> Callback;
+
+		HandshakeExecutor(size_t concurrency);
+		~HandshakeExecutor(void);
+
+		void setQueueBudget(duration budget);	// handshakes not started and queued longer are shed, negative means wait
+		void setMaxQueueDepth(size_t depth);	// handshakes not started are rejected when the queue is full, 0 means unlimited
+		Stats stats(void) const;
+
+		// Both run tryHandshake() once, the caller then waits for the returned direction
+		Status step(SecureTransport *transport);	// waits for the step, throws if shed
+		void submit(SecureTransport *transport, Callback done);	// done is called from a worker, or immediately if rejected
+
+	private:
+		Status run(SecureTransport *transport, std::chrono::steady_clock::time_point queued);
+
+		ThreadPool mPool;
+		duration mQueueBudget;
+		size_t mMaxQueueDepth;
+		Stats mStats;
+		mutable std::mutex mMutex;
+	};
+
+	static void SetHandshakeExecutor(sptr<HandshakeExecutor> executor);	// NULL runs handshakes inline (default)
+	static sptr<HandshakeExecutor> GetHandshakeExecutor(void);
 
 	class Credentials
 	{
@@ -94,27 +192,46 @@ public:
 	virtual ~SecureTransport(void);
 
 	void addCredentials(Credentials *creds, bool mustDelete = false);	// creds will be deleted if mustDelete == true
+	void addCredentials(sptr<Credentials> creds);	// creds are kept alive as long as the transport
 	void setHandshakeTimeout(duration timeout);
 	void setDatagramMtu(unsigned int mtu);	// ignored if not a datagram stream
 	void setDatagramTimeout(duration timeout, duration retransTimeout = duration(-1));	// ignored if not a datagram stream
+	void setMaxRecordSize(size_t size);		// must be called before handshake
+	void setWriteCoalescing(bool enabled);	// ignored if datagram stream, see flush()
 
 	void handshake(void);
 	void close(void);
 
+	// Non-blocking mode, to be driven by socket readiness, e.g. from an EventLoop
+	// Blocking calls like handshake() or readData() are not allowed in this mode
+	// Streams other than sockets are read when waitData() reports data, writes to them may block
+	void setBlocking(bool enabled);	// write coalescing is disabled when non-blocking
+	bool isBlocking(void) const;
+	Status tryHandshake(void);
+	Status tryRead(char *buffer, size_t size, size_t &count);	// call until WantRead, buffered data is not signaled by the socket
+	Status tryWrite(const char *data, size_t size, size_t &count);	// on WantWrite, call again with the same data
+	Status tryClose(void);
+	duration nextTimeout(void) const;	// datagram retransmission timeout, negative if none
+
 	void setHostname(const String &hostname);	// remote hostname for client
+	void setProtocols(const List<String> &protocols);	// offered with ALPN in preference order, must be called before handshake
+	String getProtocol(void) const;	// negotiated with ALPN, empty if none
 
 	virtual bool isClient(void) const;
 	bool isHandshakeDone(void) const;
+	bool isResumed(void) const;
 	bool isAnonymous(void) const;
 	bool hasPrivateSharedKey(void) const;
 	bool hasCertificate(void) const;
 	String getPrivateSharedKeyHint(void) const;	// only valid on client-side
+	Socket *socket(void) const;	// underlying socket, NULL if the stream is not a socket
 
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
-	// TODO: waitData
+	bool waitData(duration timeout);	// flushes coalesced writes before waiting
 	bool nextRead(void);
 	bool nextWrite(void);
+	void flush(void);	// sends coalesced writes, also done before reading and on close
 	bool isDatagram(void) const;
 
 	struct Verifier
@@ -130,6 +247,7 @@ public:
 protected:
 	static ssize_t	DirectWriteCallback(gnutls_transport_ptr_t ptr, const void* data, size_t len);
 	static ssize_t	WriteCallback(gnutls_transport_ptr_t ptr, const void* data, size_t len);
+	static ssize_t	WriteVectorCallback(gnutls_transport_ptr_t ptr, const giovec_t *iov, int iovcnt);
 	static ssize_t	ReadCallback(gnutls_transport_ptr_t ptr, void* data, size_t maxlen);
 	static int	TimeoutCallback(gnutls_transport_ptr_t ptr, unsigned int ms);
 
@@ -137,10 +255,47 @@ protected:
 	static int PrivateSharedKeyCallback(gnutls_session_t session, const char* username, gnutls_datum_t* datum);
 	static int PrivateSharedKeyClientCallback(gnutls_session_t session, char** username, gnutls_datum_t* datum);
 
+	static int ParamsCallback(gnutls_session_t session, gnutls_params_type_t type, gnutls_params_st *st);
+	static int SessionTicketCallback(gnutls_session_t session, unsigned int htype, unsigned when, unsigned int incoming, const gnutls_datum_t *msg);
+	static int StoreSessionCallback(void *ptr, gnutls_datum_t key, gnutls_datum_t data);
+	static gnutls_datum_t RetrieveSessionCallback(void *ptr, gnutls_datum_t key);
+	static int RemoveSessionCallback(void *ptr, gnutls_datum_t key);
+
 	static String ErrorString(int code);
 
-	static gnutls_dh_params_t Params;
-	static std::mutex ParamsMutex;
+	static sptr<gnutls_dh_params_int> GetParams(void);
+	static void LoadParams(void);
+	static void RunParams(void);
+	static void StopParams(void);
+
+	static sptr<gnutls_dh_params_int> Params;	// accessed atomically
+	static std::mutex ParamsMutex;				// serializes generation
+	static std::thread ParamsThread;
+	static std::mutex ParamsThreadMutex;
+	static std::condition_variable ParamsCondition;
+	static bool ParamsStopping;
+
+	// Joins the thread at exit if Cleanup() was not called, after a running generation
+	struct ParamsThreadGuard { ~ParamsThreadGuard(void) { StopParams(); } };
+	static ParamsThreadGuard ParamsGuard;
+
+	static gnutls_datum_t TicketKey;	// master key, ticket keys are derived from it by gnutls
+	static std::mutex TicketKeyMutex;
+
+	static sptr<HandshakeExecutor> Executor;	// accessed atomically
+	static sptr<SessionCache> ServerSessions;
+	static sptr<SessionCache> ClientSessions;
+	static std::mutex SessionsMutex;
+	static std::atomic<uint64_t> FullHandshakes[2], ResumedHandshakes[2];	// indexed by isClient()
+
+	void storeClientSession(void);
+	BinaryString clientSessionKey(void) const;
+	void uncork(void);
+	void performHandshake(void);
+	void prepareHandshake(void);
+	void finishHandshake(void);
+	ssize_t pull(char *buffer, size_t size);	// returns -1 if it would block
+	Status direction(void) const;
 
 	SecureTransport(Stream *stream, bool server);	// stream will be deleted on success
 
@@ -149,6 +304,15 @@ protected:
 	Verifier *mVerifier;
 	String mPriorities;
 	String mHostname;
+	sptr<SessionCache> mSessionCache;
+	Socket *mSocket;	// underlying socket for vectored writes, if any
+
+	// For stream mode
+	char *mReadAhead;
+	size_t mReadAheadCapacity, mReadAheadSize, mReadAheadOffset;
+	bool mWriteCoalescing;
+	bool mCorked;
+	bool mBlocking;
 
 	// For datagram mode
 	char *mBuffer;
@@ -156,6 +320,9 @@ protected:
 	BinaryString mWriteBuffer;
 
 	List<Credentials*> mCredsToDelete;
+	List<sptr<Credentials> > mSharedCreds;
+	duration mHandshakeTimeout;
+	bool mIsHandshakeStarted;
 	bool mIsHandshakeDone;
 	bool mIsByeDone;
 };
@@ -219,6 +386,52 @@ public:
 	static SecureTransport *Listen(ServerSocket &sock, Address *remote = NULL, bool requestClientCertificate = false, duration connectionTimeout = seconds(-1.));
 	static SecureTransport *Listen(DatagramSocket &sock, Address *remote = NULL, bool requestClientCertificate = false, duration streamTimeout = seconds(-1.));
 
+	// Multi-session DTLS server, datagrams are demultiplexed per peer and cookies are
+	// verified statelessly on a receiving thread, then handshakes run concurrently on workers
+	class DatagramListener
+	{
+	public:
+		typedef std::function<void(SecureTransport *transport, const Address &remote)> handler_t;	// handler owns transport
+
+		struct Stats
+		{
+			uint64_t cookiesSent;
+			uint64_t handshakes;
+			uint64_t failures;
+			uint64_t dropped;	// over the pending handshakes limit
+		};
+
+		DatagramListener(DatagramSocket *sock, Credentials *creds, handler_t handler, size_t workers = 8, bool requestClientCertificate = false);	// creds will be deleted with the last transport using them
+		~DatagramListener(void);
+
+		void setMaxPending(size_t count);
+		void setStreamTimeout(duration timeout);
+		Stats stats(void) const;
+		void join(void);
+
+	private:
+		static ssize_t CookieCallback(gnutls_transport_ptr_t ptr, const void* data, size_t len);
+
+		void run(void);
+		bool accept(const Address &sender, gnutls_dtls_prestate_st &prestate);
+		void handshake(SecureTransportServer *transport, const Address &sender);
+
+		DatagramSocket *mSock;
+		sptr<Credentials> mCredentials;	// shared with the transports handed to the handler, which may outlive the listener
+		handler_t mHandler;
+		bool mRequestClientCertificate;
+		gnutls_datum_t mCookieKey;
+		size_t mMaxPending;
+		duration mStreamTimeout;
+		std::atomic<uint64_t> mCookiesSent, mHandshakes, mFailures, mDropped;
+
+		Set<SecureTransportServer*> mPending;
+		mutable std::mutex mMutex;
+		std::atomic<bool> mJoining;
+		ThreadPool mPool;
+		std::thread mThread;
+	};
+
 	SecureTransportServer(Stream *stream, Credentials *creds = NULL, bool requestClientCertificate = false);	// creds will be deleted
 	~SecureTransportServer(void);
 
@@ -218,7 +218,7 @@ void ServerSocket::listen(int port)
 			throw NetException(String("Binding failed on port ")+String::number(port));
 
 		// Listen
-		if(::listen(mSock, 16) != 0)
+		if(::listen(mSock, SOMAXCONN) != 0)	// bursts of connections must not overflow the queue
 			throw NetException(String("Listening failed on port ")+String::number(port));
 
 		ctl_t b = 0;
@@ -252,6 +252,7 @@ void ServerSocket::accept(Socket &sock)
 	socket_t clientSock = ::accept(mSock, NULL, NULL);
 	if(clientSock == INVALID_SOCKET) throw NetException(String("Listening socket closed on port ")+String::number(mPort) + " (error "+String::number(sockerrno)+")");
 	sock.mSock = clientSock;
+	sock.applyOptions();
 }
 
 }
@@ -48,6 +48,8 @@ public:
 private:
 	socket_t	mSock;
 	int			mPort;
+
+	friend class EventLoop;
 };
 
 }
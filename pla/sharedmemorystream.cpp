@@ -0,0 +1,375 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#include "pla/sharedmemorystream.hpp"
+#include "pla/exception.hpp"
+
+#ifdef LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+namespace pla
+{
+
+size_t SharedMemoryStream::DefaultRingSize = 1024*1024;	// 1 MiB per direction
+unsigned SharedMemoryStream::SpinCount = 1000;
+const uint32_t SharedMemoryStream::Magic = 0x504C4153;	// "PLAS"
+
+SharedMemoryStream::SharedMemoryStream(const String &name, size_t ringSize) :
+	mName(name),
+	mFd(-1),
+	mCreator(true),
+	mLength(0),
+	mHeader(NULL),
+	mIn(NULL),
+	mOut(NULL),
+	mInData(NULL),
+	mOutData(NULL),
+	mRingSize(0),
+	mReadTimeout(seconds(-1.)),
+	mWriteTimeout(seconds(-1.))
+{
+#ifdef LINUX
+	// Round ring size up to a power of two so positions can be masked
+	size_t size = 4096;
+	while(size < ringSize) size<<= 1;
+	if(size > std::numeric_limits<uint32_t>::max())
+		throw Exception("Shared memory ring size is too large");
+
+	String path = "/" + name;
+	mFd = ::shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(mFd < 0) throw Exception("Unable to create shared memory segment: " + name + " (error " + String::number(errno) + ")");
+
+	try {
+		size_t length = sizeof(Header) + 2*size;
+		if(::ftruncate(mFd, off_t(length)) != 0)
+			throw Exception("Unable to resize shared memory segment: " + name);
+
+		map(length);
+
+		mHeader->ringSize = uint32_t(size);
+		for(int i=0; i<2; ++i)
+			new (&mHeader->rings[i]) Ring();	// zero-initialized
+
+		std::atomic_thread_fence(std::memory_order_release);
+		mHeader->magic = Magic;
+
+		mRingSize = size;
+		mOut = &mHeader->rings[0];
+		mIn  = &mHeader->rings[1];
+		mOutData = reinterpret_cast<char*>(mHeader + 1);
+		mInData  = mOutData + size;
+	}
+	catch(...)
+	{
+		unmap();
+		::shm_unlink(path.c_str());
+		throw;
+	}
+#else
+	throw Unsupported("Shared memory stream");
+#endif
+}
+
+SharedMemoryStream::SharedMemoryStream(const String &name) :
+	mName(name),
+	mFd(-1),
+	mCreator(false),
+	mLength(0),
+	mHeader(NULL),
+	mIn(NULL),
+	mOut(NULL),
+	mInData(NULL),
+	mOutData(NULL),
+	mRingSize(0),
+	mReadTimeout(seconds(-1.)),
+	mWriteTimeout(seconds(-1.))
+{
+#ifdef LINUX
+	String path = "/" + name;
+	mFd = ::shm_open(path.c_str(), O_RDWR, 0600);
+	if(mFd < 0) throw Exception("Unable to open shared memory segment: " + name);
+
+	try {
+		struct stat st;
+		if(::fstat(mFd, &st) != 0 || size_t(st.st_size) < sizeof(Header))
+			throw Exception("Invalid shared memory segment: " + name);
+
+		map(size_t(st.st_size));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(mHeader->magic != Magic || sizeof(Header) + 2*size_t(mHeader->ringSize) > mLength)
+			throw Exception("Invalid shared memory segment: " + name);
+
+		mRingSize = mHeader->ringSize;
+		mIn  = &mHeader->rings[0];
+		mOut = &mHeader->rings[1];
+		mInData  = reinterpret_cast<char*>(mHeader + 1);
+		mOutData = mInData + mRingSize;
+	}
+	catch(...)
+	{
+		unmap();
+		throw;
+	}
+#else
+	throw Unsupported("Shared memory stream");
+#endif
+}
+
+SharedMemoryStream::~SharedMemoryStream(void)
+{
+	NOEXCEPTION(close());
+	unmap();
+}
+
+String SharedMemoryStream::name(void) const
+{
+	return mName;
+}
+
+bool SharedMemoryStream::isConnected(void) const
+{
+	return mHeader && !mOut->closed.load() && !mIn->closed.load();
+}
+
+void SharedMemoryStream::setReadTimeout(duration timeout)
+{
+	mReadTimeout = timeout;
+}
+
+void SharedMemoryStream::setWriteTimeout(duration timeout)
+{
+	mWriteTimeout = timeout;
+}
+
+void SharedMemoryStream::setTimeout(duration timeout)
+{
+	setReadTimeout(timeout);
+	setWriteTimeout(timeout);
+}
+
+size_t SharedMemoryStream::readData(char *buffer, size_t size)
+{
+	if(!mHeader) throw NetException("Shared memory stream is closed");
+	if(!size) return 0;
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point end = clock::time_point::max();
+	if(mReadTimeout >= duration::zero())
+		end = clock::now() + std::chrono::duration_cast<clock::duration>(mReadTimeout);
+
+	if(!waitReadable(end))
+		throw Timeout();
+
+	uint64_t tail = mIn->tail.load(std::memory_order_relaxed);
+	uint64_t head = mIn->head.load(std::memory_order_acquire);
+	size = std::min(size, size_t(head - tail));
+	if(!size) return 0;	// closed by peer
+
+	// Copy in at most two parts if data wraps around
+	size_t offset = size_t(tail & (mRingSize - 1));
+	size_t first = std::min(size, mRingSize - offset);
+	std::memcpy(buffer, mInData + offset, first);
+	if(first < size) std::memcpy(buffer + first, mInData, size - first);
+
+	mIn->tail.store(tail + size, std::memory_order_seq_cst);
+	mIn->spaceSeq.fetch_add(1, std::memory_order_seq_cst);
+	if(mIn->producerWaiting.load(std::memory_order_seq_cst))
+		Wake(mIn->spaceSeq);
+
+	return size;
+}
+
+void SharedMemoryStream::writeData(const char *data, size_t size)
+{
+	if(!mHeader) throw NetException("Shared memory stream is closed");
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point end = clock::time_point::max();
+	if(mWriteTimeout >= duration::zero())
+		end = clock::now() + std::chrono::duration_cast<clock::duration>(mWriteTimeout);
+
+	while(size)
+	{
+		if(!waitWritable(end))
+			throw Timeout();
+
+		if(mOut->closed.load() || mIn->closed.load())
+			throw NetException("Connection lost");
+
+		uint64_t head = mOut->head.load(std::memory_order_relaxed);
+		uint64_t tail = mOut->tail.load(std::memory_order_acquire);
+		size_t len = std::min(size, mRingSize - size_t(head - tail));
+
+		size_t offset = size_t(head & (mRingSize - 1));
+		size_t first = std::min(len, mRingSize - offset);
+		std::memcpy(mOutData + offset, data, first);
+		if(first < len) std::memcpy(mOutData, data + first, len - first);
+
+		mOut->head.store(head + len, std::memory_order_seq_cst);
+		mOut->dataSeq.fetch_add(1, std::memory_order_seq_cst);
+		if(mOut->consumerWaiting.load(std::memory_order_seq_cst))
+			Wake(mOut->dataSeq);
+
+		data+= len;
+		size-= len;
+	}
+}
+
+bool SharedMemoryStream::waitData(duration timeout)
+{
+	if(!mHeader) throw NetException("Shared memory stream is closed");
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point end = clock::time_point::max();
+	if(timeout >= duration::zero())
+		end = clock::now() + std::chrono::duration_cast<clock::duration>(timeout);
+
+	return waitReadable(end);
+}
+
+void SharedMemoryStream::close(void)
+{
+	if(mHeader && !mOut->closed.load())
+	{
+		// Signal end of stream in our direction and unblock the peer in both
+		mOut->closed.store(1, std::memory_order_seq_cst);
+		mOut->dataSeq.fetch_add(1);
+		Wake(mOut->dataSeq);
+		mIn->spaceSeq.fetch_add(1);
+		Wake(mIn->spaceSeq);
+	}
+}
+
+void SharedMemoryStream::map(size_t length)
+{
+#ifdef LINUX
+	void *ptr = ::mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+	if(ptr == MAP_FAILED) throw Exception("Unable to map shared memory segment: " + mName);
+	mHeader = static_cast<Header*>(ptr);
+	mLength = length;
+#endif
+}
+
+void SharedMemoryStream::unmap(void)
+{
+#ifdef LINUX
+	if(mHeader)
+	{
+		::munmap(mHeader, mLength);
+		mHeader = NULL;
+		mLength = 0;
+	}
+
+	if(mFd >= 0)
+	{
+		::close(mFd);
+		mFd = -1;
+
+		// The creator owns the name
+		if(mCreator) ::shm_unlink(("/" + mName).c_str());
+	}
+#endif
+}
+
+bool SharedMemoryStream::waitReadable(std::chrono::steady_clock::time_point end)
+{
+	unsigned spin = SpinCount;
+	while(true)
+	{
+		uint32_t seq = mIn->dataSeq.load(std::memory_order_seq_cst);
+		if(mIn->head.load(std::memory_order_acquire) != mIn->tail.load(std::memory_order_relaxed)) return true;
+		if(mIn->closed.load() || mOut->closed.load()) return true;	// read will return 0
+
+		if(spin)
+		{
+			--spin;
+			continue;
+		}
+
+		mIn->consumerWaiting.store(1, std::memory_order_seq_cst);
+		bool ready = (mIn->head.load(std::memory_order_seq_cst) != mIn->tail.load(std::memory_order_relaxed));
+		bool timeout = !ready && !Wait(mIn->dataSeq, seq, end);
+		mIn->consumerWaiting.store(0, std::memory_order_relaxed);
+		if(timeout) return false;
+	}
+}
+
+bool SharedMemoryStream::waitWritable(std::chrono::steady_clock::time_point end)
+{
+	unsigned spin = SpinCount;
+	while(true)
+	{
+		uint32_t seq = mOut->spaceSeq.load(std::memory_order_seq_cst);
+		if(mOut->head.load(std::memory_order_relaxed) - mOut->tail.load(std::memory_order_acquire) < mRingSize) return true;
+		if(mIn->closed.load() || mOut->closed.load()) return true;	// write will throw
+
+		if(spin)
+		{
+			--spin;
+			continue;
+		}
+
+		mOut->producerWaiting.store(1, std::memory_order_seq_cst);
+		bool ready = (mOut->head.load(std::memory_order_relaxed) - mOut->tail.load(std::memory_order_seq_cst) < mRingSize);
+		bool timeout = !ready && !Wait(mOut->spaceSeq, seq, end);
+		mOut->producerWaiting.store(0, std::memory_order_relaxed);
+		if(timeout) return false;
+	}
+}
+
+bool SharedMemoryStream::Wait(std::atomic<uint32_t> &word, uint32_t value, std::chrono::steady_clock::time_point end)
+{
+#ifdef LINUX
+	using clock = std::chrono::steady_clock;
+
+	struct timespec ts;
+	struct timespec *pts = NULL;
+	if(end != clock::time_point::max())
+	{
+		clock::time_point now = clock::now();
+		if(now >= end) return false;
+		durationToStruct(std::chrono::duration_cast<duration>(end - now), ts);
+		pts = &ts;
+	}
+
+	// Not FUTEX_PRIVATE_FLAG since the word is shared between processes
+	if(::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, pts, NULL, 0) < 0)
+	{
+		if(errno == ETIMEDOUT) return clock::now() < end;
+		if(errno != EAGAIN && errno != EINTR)
+			throw Exception("Unable to wait on shared memory stream (error " + String::number(errno) + ")");
+	}
+#endif
+	return true;
+}
+
+void SharedMemoryStream::Wake(std::atomic<uint32_t> &word)
+{
+#ifdef LINUX
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+}
@@ -0,0 +1,102 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+#ifndef PLA_SHAREDMEMORYSTREAM_H
+#define PLA_SHAREDMEMORYSTREAM_H
+
+#include "pla/include.hpp"
+#include "pla/stream.hpp"
+#include "pla/string.hpp"
+
+#include <atomic>
+
+namespace pla
+{
+
+// Bidirectional stream over a pair of single-producer single-consumer rings
+// in a shared memory segment, for same-host IPC without going through the kernel.
+// Blocking is implemented with futexes, so this is only available on Linux.
+class SharedMemoryStream : public Stream
+{
+public:
+	static size_t DefaultRingSize;
+	static unsigned SpinCount;
+
+	SharedMemoryStream(const String &name, size_t ringSize);	// create segment (server side)
+	SharedMemoryStream(const String &name);						// open existing segment (client side)
+	~SharedMemoryStream(void);
+
+	String name(void) const;
+	bool isConnected(void) const;
+
+	void setReadTimeout(duration timeout);
+	void setWriteTimeout(duration timeout);
+	void setTimeout(duration timeout);	// read + write
+
+	// Stream
+	size_t readData(char *buffer, size_t size);
+	void writeData(const char *data, size_t size);
+	bool waitData(duration timeout);
+	void close(void);
+
+private:
+	struct alignas(64) Ring
+	{
+		std::atomic<uint64_t> head;		// write position
+		std::atomic<uint64_t> tail;		// read position
+		std::atomic<uint32_t> dataSeq;	// futex word bumped by producer
+		std::atomic<uint32_t> spaceSeq;	// futex word bumped by consumer
+		std::atomic<uint32_t> consumerWaiting;
+		std::atomic<uint32_t> producerWaiting;
+		std::atomic<uint32_t> closed;
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t ringSize;
+		Ring rings[2];	// rings[0]: creator to opener, rings[1]: opener to creator
+	};
+
+	static const uint32_t Magic;
+
+	void map(size_t length);
+	void unmap(void);
+	bool waitReadable(std::chrono::steady_clock::time_point end);
+	bool waitWritable(std::chrono::steady_clock::time_point end);
+
+	static bool Wait(std::atomic<uint32_t> &word, uint32_t value, std::chrono::steady_clock::time_point end);
+	static void Wake(std::atomic<uint32_t> &word);
+
+	String mName;
+	int mFd;
+	bool mCreator;
+	size_t mLength;
+	Header *mHeader;
+	Ring *mIn, *mOut;
+	char *mInData, *mOutData;
+	size_t mRingSize;
+	duration mReadTimeout, mWriteTimeout;
+};
+
+}
+
+#endif
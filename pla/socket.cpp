@@ -24,9 +24,55 @@
 #include "pla/http.hpp"
 #include "pla/proxy.hpp"
 
+#ifndef WINDOWS
+#include <poll.h>
+#endif
+
 namespace pla
 {
 
+#ifndef WINDOWS
+// poll() is preferred to select() since descriptors may exceed FD_SETSIZE
+static int PollSocket(socket_t sock, short events, duration timeout)
+{
+	struct pollfd pfd;
+	pfd.fd = sock;
+	pfd.events = events;
+	pfd.revents = 0;
+
+	int ms = -1;
+	if(timeout >= duration::zero())
+		ms = int(std::ceil(milliseconds(timeout).count()));
+
+	int ret;
+	do {
+		ret = ::poll(&pfd, 1, ms);
+	}
+	while(ret < 0 && errno == EINTR);
+	return ret;
+}
+#endif
+
+#ifdef LINUX
+// Kernel tcp_info is a superset of the glibc structure, the extension
+// is filled only if the running kernel supports it
+struct tcp_info_ext
+{
+	struct tcp_info base;
+	uint64_t tcpi_pacing_rate;
+	uint64_t tcpi_max_pacing_rate;
+	uint64_t tcpi_bytes_acked;
+	uint64_t tcpi_bytes_received;
+	uint32_t tcpi_segs_out;
+	uint32_t tcpi_segs_in;
+	uint32_t tcpi_notsent_bytes;
+	uint32_t tcpi_min_rtt;
+	uint32_t tcpi_data_segs_in;
+	uint32_t tcpi_data_segs_out;
+	uint64_t tcpi_delivery_rate;
+};
+#endif
+
 void Socket::Transfer(Socket *sock1, Socket *sock2)
 {
 	Assert(sock1);
@@ -176,6 +222,81 @@ void Socket::setTimeout(duration timeout)
 	setWriteTimeout(timeout);
 }
 
+void Socket::setSendBufferSize(size_t size)
+{
+	mSendBufferSize = int(std::min(size, size_t(std::numeric_limits<int>::max())));
+	if(isConnected()) applyOptions();
+}
+
+void Socket::setReceiveBufferSize(size_t size)
+{
+	mReceiveBufferSize = int(std::min(size, size_t(std::numeric_limits<int>::max())));
+	if(isConnected()) applyOptions();
+}
+
+void Socket::setNotSentLowWatermark(size_t size)
+{
+	mNotSentLowWatermark = int(std::min(size, size_t(std::numeric_limits<int>::max())));
+	if(isConnected()) applyOptions();
+}
+
+void Socket::setCongestionControl(const String &algorithm)
+{
+	mCongestionControl = algorithm;
+	if(isConnected()) applyOptions();
+}
+
+void Socket::setKeepAlive(bool enabled, duration idle, duration interval, int count)
+{
+	mKeepAlive = (enabled ? 1 : 0);
+	mKeepAliveIdle = (idle >= duration::zero() ? std::max(int(seconds(idle).count()), 1) : -1);
+	mKeepAliveInterval = (interval >= duration::zero() ? std::max(int(seconds(interval).count()), 1) : -1);
+	mKeepAliveCount = count;
+	if(isConnected()) applyOptions();
+}
+
+void Socket::setNoDelay(bool enabled)
+{
+	mNoDelay = (enabled ? 1 : 0);
+	if(isConnected()) applyOptions();
+}
+
+Socket::Stats Socket::stats(void) const
+{
+	if(mSock == INVALID_SOCKET)
+		throw NetException("Socket is closed");
+
+	Stats s;
+	std::memset(&s, 0, sizeof(s));
+
+#ifdef LINUX
+	struct tcp_info_ext info;
+	std::memset(&info, 0, sizeof(info));
+	socklen_t len = sizeof(info);
+	if(::getsockopt(mSock, IPPROTO_TCP, TCP_INFO, reinterpret_cast<char*>(&info), &len) != 0)
+		throw NetException("Unable to retrieve TCP information (error " + String::number(sockerrno) + ")");
+
+	s.rtt = microseconds(info.base.tcpi_rtt);
+	s.rttVar = microseconds(info.base.tcpi_rttvar);
+	s.congestionWindow = info.base.tcpi_snd_cwnd;
+	s.mss = info.base.tcpi_snd_mss;
+	s.retransmits = info.base.tcpi_total_retrans;
+	s.lost = info.base.tcpi_lost;
+	s.bytesInFlight = size_t(info.base.tcpi_unacked)*info.base.tcpi_snd_mss;
+
+	// Extended fields, zero if unsupported by the kernel
+	s.minRtt = microseconds(info.tcpi_min_rtt);
+	s.bytesNotSent = info.tcpi_notsent_bytes;
+	s.bytesAcked = info.tcpi_bytes_acked;
+	s.bytesReceived = info.tcpi_bytes_received;
+	s.deliveryRate = info.tcpi_delivery_rate;
+#else
+	throw Unsupported("TCP statistics");
+#endif
+
+	return s;
+}
+
 void Socket::connect(const Address &addr, bool noproxy)
 {
 	String target = addr.toString();
@@ -220,6 +341,9 @@ void Socket::connect(const Address &addr, bool noproxy)
 		if(mSock == INVALID_SOCKET)
 			throw NetException("Socket creation failed");
 
+		// Buffer sizes must be set before connection for window scaling
+		applyOptions();
+
 		if(mConnectTimeout >= duration::zero())
 		{
 			ctl_t b = 1;
@@ -271,6 +395,13 @@ void Socket::close(void)
 	mProxifiedAddr.clear();
 }
 
+void Socket::shutdownWrite(void)
+{
+	if(mSock == INVALID_SOCKET) throw NetException("Socket not connected");
+	if(::shutdown(mSock, SHUT_WR) < 0)
+		throw NetException("Unable to shut down socket (error " + String::number(sockerrno) + ")");
+}
+
 size_t Socket::readData(char *buffer, size_t size)
 {
 	return recvData(buffer, size, 0);
@@ -286,6 +417,7 @@ bool Socket::waitData(duration timeout)
 	if(mSock == INVALID_SOCKET)
 		throw NetException("Socket is closed");
 
+#ifdef WINDOWS
 	fd_set readfds;
 	FD_ZERO(&readfds);
 	FD_SET(mSock, &readfds);
@@ -293,6 +425,29 @@ bool Socket::waitData(duration timeout)
 	struct timeval tv;
 	durationToStruct(timeout, tv);
 	int ret = ::select(SOCK_TO_INT(mSock)+1, &readfds, NULL, NULL, &tv);
+#else
+	int ret = PollSocket(mSock, POLLIN, timeout);
+#endif
+	if (ret < 0) throw Exception("Unable to wait on socket");
+	return (ret != 0);
+}
+
+bool Socket::waitWriteable(duration timeout)
+{
+	if(mSock == INVALID_SOCKET)
+		throw NetException("Socket is closed");
+
+#ifdef WINDOWS
+	fd_set writefds;
+	FD_ZERO(&writefds);
+	FD_SET(mSock, &writefds);
+
+	struct timeval tv;
+	durationToStruct(timeout, tv);
+	int ret = ::select(SOCK_TO_INT(mSock)+1, NULL, &writefds, NULL, &tv);
+#else
+	int ret = PollSocket(mSock, POLLOUT, timeout);
+#endif
 	if (ret < 0) throw Exception("Unable to wait on socket");
 	return (ret != 0);
 }
@@ -324,21 +479,7 @@ void Socket::sendData(const char *data, size_t size, int flags)
 	durationToStruct(std::max(mWriteTimeout, duration::zero()), tv);
 
 	do {
-		if(mSock == INVALID_SOCKET)
-			throw NetException("Socket is closed");
-
-		if(mWriteTimeout >= duration::zero())
-		{
-			fd_set writefds;
-			FD_ZERO(&writefds);
-			FD_SET(mSock, &writefds);
-
-			int ret = ::select(SOCK_TO_INT(mSock)+1, NULL, &writefds, NULL, &tv);
-			if (ret == -1)
-				throw Exception("Unable to wait on socket");
-			if (ret == 0)
-				throw Timeout();
-		}
+		waitWriteable(tv);
 
 		int count = ::send(mSock, data, size, flags | MSG_NOSIGNAL);
 		if(count < 0)
@@ -350,4 +491,198 @@ void Socket::sendData(const char *data, size_t size, int flags)
 	while(size);
 }
 
+void Socket::writeData(const struct iovec *iov, int count)
+{
+#ifdef WINDOWS
+	for(int i = 0; i < count; ++i)
+		if(iov[i].iov_len)
+			sendData(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len, 0);
+#else
+	struct timeval tv;
+	durationToStruct(std::max(mWriteTimeout, duration::zero()), tv);
+
+	// Vectors are copied by chunks since partial writes modify them
+	const int ChunkSize = 16;
+	struct iovec chunk[ChunkSize];
+	while(count > 0)
+	{
+		int n = std::min(count, ChunkSize);
+		std::copy(iov, iov + n, chunk);
+		iov+= n;
+		count-= n;
+
+		struct iovec *p = chunk;
+		while(n > 0)
+		{
+			waitWriteable(tv);
+
+			struct msghdr msg;
+			std::memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = p;
+			msg.msg_iovlen = n;
+
+			ssize_t ret = ::sendmsg(mSock, &msg, MSG_NOSIGNAL);
+			if(ret < 0)
+				throw NetException("Connection lost (error " + String::number(sockerrno) + ")");
+
+			size_t written = size_t(ret);
+			while(n > 0 && written >= p->iov_len)
+			{
+				written-= p->iov_len;
+				++p;
+				--n;
+			}
+
+			if(n > 0)
+			{
+				p->iov_base = static_cast<char*>(p->iov_base) + written;
+				p->iov_len-= written;
+			}
+		}
+	}
+#endif
+}
+
+void Socket::writeChain(const IOBufChain &chain)
+{
+	// Buffers are gathered instead of being written one by one
+	std::vector<struct iovec> iov;
+	iov.reserve(chain.count());
+	for(auto it = chain.begin(); it != chain.end(); ++it)
+	{
+		struct iovec v;
+		v.iov_base = const_cast<char*>(it->data());
+		v.iov_len = it->size();
+		iov.push_back(v);
+	}
+
+	if(!iov.empty()) writeData(iov.data(), int(iov.size()));
+}
+
+ssize_t Socket::tryReadData(char *buffer, size_t size)
+{
+	if(mSock == INVALID_SOCKET)
+		throw NetException("Socket is closed");
+
+#ifdef MSG_DONTWAIT
+	ssize_t count = ::recv(mSock, buffer, size, MSG_DONTWAIT);
+#else
+	if(!waitData(duration::zero())) return -1;
+	ssize_t count = ::recv(mSock, buffer, size, 0);
+#endif
+	if(count < 0)
+	{
+		if(sockerrno == SEAGAIN || sockerrno == SEWOULDBLOCK) return -1;
+		throw NetException("Connection lost (error " + String::number(sockerrno) + ")");
+	}
+
+	return count;
+}
+
+ssize_t Socket::tryWriteData(const struct iovec *iov, int count)
+{
+	if(mSock == INVALID_SOCKET)
+		throw NetException("Socket is closed");
+
+#ifdef MSG_DONTWAIT
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec*>(iov);
+	msg.msg_iovlen = count;
+
+	ssize_t ret = ::sendmsg(mSock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if(ret < 0)
+	{
+		if(sockerrno == SEAGAIN || sockerrno == SEWOULDBLOCK) return -1;
+		throw NetException("Connection lost (error " + String::number(sockerrno) + ")");
+	}
+
+	return ret;
+#else
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+
+	fd_set writefds;
+	FD_ZERO(&writefds);
+	FD_SET(mSock, &writefds);
+	int ret = ::select(SOCK_TO_INT(mSock)+1, NULL, &writefds, NULL, &tv);
+	if(ret == -1) throw Exception("Unable to wait on socket");
+	if(ret == 0) return -1;
+
+	// Only the first buffer is written, which is allowed for a partial write
+	int i = 0;
+	while(i < count && !iov[i].iov_len) ++i;
+	if(i == count) return 0;
+	ret = ::send(mSock, static_cast<const char*>(iov[i].iov_base), iov[i].iov_len, 0);
+	if(ret < 0) throw NetException("Connection lost (error " + String::number(sockerrno) + ")");
+	return ret;
+#endif
+}
+
+void Socket::waitWriteable(struct timeval &tv)
+{
+	if(mSock == INVALID_SOCKET)
+		throw NetException("Socket is closed");
+
+	if(mWriteTimeout >= duration::zero())
+	{
+#ifdef WINDOWS
+		fd_set writefds;
+		FD_ZERO(&writefds);
+		FD_SET(mSock, &writefds);
+
+		int ret = ::select(SOCK_TO_INT(mSock)+1, NULL, &writefds, NULL, &tv);
+#else
+		// Remaining time is updated like select() does
+		duration timeout = structToDuration(tv);
+		auto start = std::chrono::steady_clock::now();
+		int ret = PollSocket(mSock, POLLOUT, timeout);
+		durationToStruct(std::max(timeout - duration(std::chrono::steady_clock::now() - start), duration::zero()), tv);
+#endif
+		if (ret == -1)
+			throw Exception("Unable to wait on socket");
+		if (ret == 0)
+			throw Timeout();
+	}
+}
+
+void Socket::applyOptions(void)
+{
+	if(mSendBufferSize >= 0) setOption(SOL_SOCKET, SO_SNDBUF, mSendBufferSize, "SO_SNDBUF");
+	if(mReceiveBufferSize >= 0) setOption(SOL_SOCKET, SO_RCVBUF, mReceiveBufferSize, "SO_RCVBUF");
+	if(mNoDelay >= 0) setOption(IPPROTO_TCP, TCP_NODELAY, mNoDelay, "TCP_NODELAY");
+
+	if(mKeepAlive >= 0)
+	{
+		setOption(SOL_SOCKET, SO_KEEPALIVE, mKeepAlive, "SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+		if(mKeepAlive && mKeepAliveIdle > 0) setOption(IPPROTO_TCP, TCP_KEEPIDLE, mKeepAliveIdle, "TCP_KEEPIDLE");
+#endif
+#ifdef TCP_KEEPINTVL
+		if(mKeepAlive && mKeepAliveInterval > 0) setOption(IPPROTO_TCP, TCP_KEEPINTVL, mKeepAliveInterval, "TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+		if(mKeepAlive && mKeepAliveCount > 0) setOption(IPPROTO_TCP, TCP_KEEPCNT, mKeepAliveCount, "TCP_KEEPCNT");
+#endif
+	}
+
+#ifdef TCP_NOTSENT_LOWAT
+	if(mNotSentLowWatermark >= 0) setOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, mNotSentLowWatermark, "TCP_NOTSENT_LOWAT");
+#endif
+
+#ifdef TCP_CONGESTION
+	if(!mCongestionControl.empty())
+		if(::setsockopt(mSock, IPPROTO_TCP, TCP_CONGESTION, mCongestionControl.c_str(), socklen_t(mCongestionControl.size())) != 0)
+			LogWarn("Socket::applyOptions", "Unable to set congestion control algorithm: " + mCongestionControl);
+#endif
+}
+
+void Socket::setOption(int level, int option, int value, const char *name)
+{
+	// Tuning failures are not fatal
+	if(::setsockopt(mSock, level, option, reinterpret_cast<char*>(&value), sizeof(value)) != 0)
+		LogWarn("Socket::setOption", String("Unable to set ") + name + " (error " + String::number(sockerrno) + ")");
+}
+
 }
@@ -25,6 +25,7 @@
 #include "pla/include.hpp"
 #include "pla/stream.hpp"
 #include "pla/address.hpp"
+#include "pla/iobuf.hpp"
 
 namespace pla
 {
@@ -37,6 +38,23 @@ public:
 	static void Transfer(Socket *sock1, Socket *sock2);
 	static Address HttpProxy;
 
+	// Transport metrics snapshot, see stats()
+	struct Stats
+	{
+		duration rtt;				// smoothed round-trip time
+		duration rttVar;			// round-trip time variance
+		duration minRtt;			// minimum observed round-trip time
+		unsigned congestionWindow;	// in segments
+		unsigned mss;				// sender maximum segment size
+		unsigned retransmits;		// total retransmitted segments
+		unsigned lost;				// segments currently considered lost
+		size_t bytesInFlight;		// sent but unacknowledged
+		size_t bytesNotSent;		// queued but not yet sent
+		uint64_t bytesAcked;
+		uint64_t bytesReceived;
+		uint64_t deliveryRate;		// bytes per second, 0 if unavailable
+	};
+
 	Socket(void);
 	Socket(const Address &a, duration timeout = seconds(-1.));
 	Socket(socket_t sock);
@@ -53,27 +71,61 @@ public:
 	void setWriteTimeout(duration timeout);
 	void setTimeout(duration timeout);	// connect + read + write
 
+	// Tuning, applied immediately if connected and on subsequent connections
+	void setSendBufferSize(size_t size);
+	void setReceiveBufferSize(size_t size);
+	void setNotSentLowWatermark(size_t size);	// limits unsent data queued in kernel
+	void setCongestionControl(const String &algorithm);	// e.g. "cubic" or "bbr"
+	void setKeepAlive(bool enabled, duration idle = seconds(-1.), duration interval = seconds(-1.), int count = -1);
+	void setNoDelay(bool enabled);
+
+	Stats stats(void) const;
+
 	void connect(const Address &addr, bool noproxy = false);
 	void close(void);
+	void shutdownWrite(void);	// sends the end of stream, reading is still possible
 
 	// Stream
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
 	bool waitData(duration timeout);
 
+	void writeChain(const IOBufChain &chain);
+
 	// Socket-specific
 	size_t peekData(char *buffer, size_t size);
+	void writeData(const struct iovec *iov, int count);	// gathers buffers in as few calls as possible
+
+	// Non-blocking access, return -1 if the operation would block, 0 on read means closed
+	ssize_t tryReadData(char *buffer, size_t size);
+	ssize_t tryWriteData(const struct iovec *iov, int count);
+	bool waitWriteable(duration timeout);	// returns false on timeout
 
 private:
 	size_t recvData(char *buffer, size_t size, int flags);
 	void sendData(const char *data, size_t size, int flags);
+	void waitWriteable(struct timeval &tv);
+	void applyOptions(void);
+	void setOption(int level, int option, int value, const char *name);
 
 	socket_t mSock;
 	duration mConnectTimeout, mReadTimeout, mWriteTimeout;
+
+	// Tuning, negative means unset
+	int mSendBufferSize = -1;
+	int mReceiveBufferSize = -1;
+	int mNotSentLowWatermark = -1;
+	int mKeepAlive = -1;
+	int mKeepAliveIdle = -1;
+	int mKeepAliveInterval = -1;
+	int mKeepAliveCount = -1;
+	int mNoDelay = -1;
+	String mCongestionControl;
 	Address mProxifiedAddr;
 
 	friend class ServerSocket;
 	friend class SocketSelect;
+	friend class EventLoop;
 };
 
 }
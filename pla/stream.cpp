@@ -23,6 +23,11 @@
 #include "pla/string.hpp"
 #include "pla/serializable.hpp"
 #include "pla/exception.hpp"
+#include "pla/iobuf.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace pla
 {
@@ -32,6 +37,86 @@ const String Stream::BlankCharacters = " \t\r\n";
 const String Stream::NewLine = "\r\n";
 const char Stream::Space = ' ';
 
+// Set of bytes searched in bulk in spans
+struct Stream::CharClass
+{
+	static const size_t MaxVectorChars = 8;	// more members are looked up in the table
+
+	CharClass(const String &chars, bool negate = false);	// negate matches bytes not in chars
+
+	const char *find(const char *begin, const char *end) const;	// first matching byte, or end
+
+	bool mTable[256];
+	char mChars[MaxVectorChars];
+	size_t mCount;
+	bool mNegate;
+};
+
+Stream::CharClass::CharClass(const String &chars, bool negate) :
+	mCount(0),
+	mNegate(negate)
+{
+	std::fill(mTable, mTable + 256, negate);
+	for(size_t i = 0; i < chars.size(); ++i)
+	{
+		uint8_t c = uint8_t(chars[i]);
+		if(mTable[c] == negate)
+		{
+			mTable[c] = !negate;
+			if(mCount < MaxVectorChars) mChars[mCount] = char(c);
+			++mCount;
+		}
+	}
+}
+
+const char *Stream::CharClass::find(const char *begin, const char *end) const
+{
+	if(!mNegate)
+	{
+		if(mCount == 0) return end;
+		if(mCount == 1)
+		{
+			const char *p = static_cast<const char*>(std::memchr(begin, mChars[0], end - begin));	// vectorized by the C library
+			return p ? p : end;
+		}
+	}
+
+#ifdef __SSE2__
+	if(mCount <= MaxVectorChars)
+	{
+		__m128i chars[MaxVectorChars];
+		for(size_t i = 0; i < mCount; ++i)
+			chars[i] = _mm_set1_epi8(mChars[i]);
+
+		while(end - begin >= 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			__m128i match = _mm_setzero_si128();
+			for(size_t i = 0; i < mCount; ++i)
+				match = _mm_or_si128(match, _mm_cmpeq_epi8(block, chars[i]));
+
+			int mask = _mm_movemask_epi8(match);
+			if(mNegate) mask^= 0xFFFF;
+			if(mask) return begin + __builtin_ctz(mask);
+			begin+= 16;
+		}
+	}
+#endif
+
+	while(begin != end && !mTable[uint8_t(*begin)]) ++begin;
+	return begin;
+}
+
+// Ignored characters are skipped by get(), so they never match as delimiters
+static String Significant(const String &chars)
+{
+	String result;
+	for(size_t i = 0; i < chars.size(); ++i)
+		if(!Stream::IgnoredCharacters.contains(chars[i]))
+			result+= chars[i];
+	return result;
+}
+
 bool Stream::waitData(duration timeout)
 {
 	return true;
@@ -136,6 +221,40 @@ size_t Stream::writeData(Stream &s, size_t max)
 	return max-left;
 }
 
+size_t Stream::readChain(IOBufChain &chain, size_t max)
+{
+	// Read directly into a pooled block
+	IOBuf buf(std::min(max, IOBuf::BlockSize));
+	size_t size = readData(buf.tail(), std::min(max, buf.tailroom()));
+	if(!size) return 0;
+
+	buf.commit(size);
+	mLast = buf.data()[size-1];
+	chain.append(buf);
+	return size;
+}
+
+void Stream::writeChain(const IOBufChain &chain)
+{
+	for(auto it = chain.begin(); it != chain.end(); ++it)
+		writeData(it->data(), it->size());
+}
+
+bool Stream::lendsBuffers(void) const
+{
+	return false;
+}
+
+bool Stream::peekSpan(const char *&data, size_t &size)
+{
+	return false;	// no spans
+}
+
+void Stream::consume(size_t size)
+{
+	ignore(size);
+}
+
 bool Stream::hexaMode(void)
 {
 	return mHexa;
@@ -152,6 +271,31 @@ bool Stream::get(char &chr)
 {
 	skipMark();
 
+	const char *data;
+	size_t size;
+	if(peekSpan(data, size))
+	{
+		static const CharClass Others(IgnoredCharacters, true);
+		while(size)
+		{
+			mEnd = false;
+			const char *p = Others.find(data, data + size);
+			if(p != data + size)
+			{
+				chr = mLast = *p;
+				consume(p - data + 1);
+				return true;
+			}
+
+			mLast = data[size-1];
+			consume(size);
+			peekSpan(data, size);
+		}
+
+		mEnd = true;
+		return false;
+	}
+
 	while(readData(&mLast,1))
 	{
 		mEnd = false;
@@ -193,6 +337,9 @@ bool Stream::atEnd(void) const
 
 bool Stream::ignoreUntil(char delimiter)
 {
+	if(scanSpans(CharClass(Significant(String(1, delimiter))), NULL, std::numeric_limits<size_t>::max()) >= 0)
+		return !mEnd;
+
 	if(!get(mLast)) return false;
 	while(mLast != delimiter)
 		if(!get(mLast)) return false;
@@ -201,6 +348,9 @@ bool Stream::ignoreUntil(char delimiter)
 
 bool Stream::ignoreUntil(const String &delimiters)
 {
+	if(scanSpans(CharClass(Significant(delimiters)), NULL, std::numeric_limits<size_t>::max()) >= 0)
+		return !mEnd;
+
 	if(!get(mLast)) return false;
 	while(!delimiters.contains(mLast))
 		if(!get(mLast)) return false;
@@ -209,6 +359,9 @@ bool Stream::ignoreUntil(const String &delimiters)
 
 bool Stream::ignoreWhile(const String &chars)
 {
+	if(scanSpans(CharClass(chars + IgnoredCharacters, true), NULL, std::numeric_limits<size_t>::max()) >= 0)
+		return !mEnd;
+
 	if(!get(mLast)) return false;
 	while(chars.contains(mLast))
 		if(!get(mLast)) return false;
@@ -219,6 +372,9 @@ bool Stream::readUntil(Stream &output, char delimiter)
 {
 	const int maxCount = 10240;	// 10 Ko for security reasons
 
+	int64_t count = scanSpans(CharClass(Significant(String(1, delimiter))), &output, maxCount);
+	if(count >= 0) return count > 0;
+
 	int left = maxCount;
 	char chr;
 	if(!get(chr)) return false;
@@ -235,6 +391,9 @@ bool Stream::readUntil(Stream &output, const String &delimiters)
 {
 	const int maxCount = 10240;	// 10 Ko for security reasons
 
+	int64_t count = scanSpans(CharClass(Significant(delimiters)), &output, maxCount);
+	if(count >= 0) return count > 0;
+
 	int left = maxCount;
 	char chr;
 	if(!get(chr)) return false;
@@ -247,16 +406,91 @@ bool Stream::readUntil(Stream &output, const String &delimiters)
 	return true;
 }
 
+// Consumes spans up to and including the first delimiter, writing at most max of the other bytes to output,
+// ignored characters excepted, and returns the count of bytes get() would have returned
+int64_t Stream::scanSpans(const CharClass &delimiters, Stream *output, size_t max)
+{
+	static const CharClass Ignored(IgnoredCharacters);
+
+	skipMark();
+
+	const char *data;
+	size_t size;
+	if(!peekSpan(data, size)) return -1;
+
+	int64_t count = 0;
+	while(size)
+	{
+		mEnd = false;
+		const char *end = data + size;
+		const char *p = delimiters.find(data, end);
+
+		const char *q = data;
+		while(q != p && max)
+		{
+			const char *r = Ignored.find(q, p);
+			size_t len = std::min(size_t(r - q), max);
+			if(len)
+			{
+				if(output) output->writeData(q, len);
+				count+= len;
+				max-= len;
+				q+= len;
+			}
+
+			if(max && q != p) ++q;	// ignored character
+		}
+
+		if(!max)
+		{
+			// Limit reached, the following bytes are left in the stream
+			if(q != data)
+			{
+				mLast = q[-1];
+				consume(q - data);
+			}
+			return count;
+		}
+
+		if(p != end)
+		{
+			mLast = *p;
+			consume(p - data + 1);
+			return count + 1;
+		}
+
+		mLast = end[-1];
+		consume(size);
+		peekSpan(data, size);
+	}
+
+	mEnd = true;
+	return count;
+}
+
 int64_t Stream::read(Stream &s)
 {
-	char buffer[BufferSize];
 	int64_t total = 0;
 	size_t size;
-	while((size = readData(buffer,BufferSize)))
+	if(lendsBuffers())
 	{
-		total+= size;
-		mLast = buffer[size-1];
-		s.writeData(buffer,size);
+		// Lent buffers are passed along without copy
+		IOBufChain chain;
+		while((size = readChain(chain, IOBuf::BlockSize)))
+		{
+			total+= size;
+			s.writeChain(chain);
+			chain.clear();
+		}
+	}
+	else {
+		char buffer[BufferSize];
+		while((size = readData(buffer,BufferSize)))
+		{
+			total+= size;
+			mLast = buffer[size-1];
+			s.writeData(buffer,size);
+		}
 	}
 	mEnd = true;
 	return total;
@@ -264,14 +498,26 @@ int64_t Stream::read(Stream &s)
 
 int64_t Stream::read(Stream &s, int64_t max)
 {
-	char buffer[BufferSize];
 	int64_t left = max;
 	size_t size;
-	while(left && (size = readData(buffer,size_t(std::min(int64_t(BufferSize),left)))))
+	if(lendsBuffers())
 	{
-		left-=size;
-		mLast = buffer[size-1];
-		s.writeData(buffer,size);
+		IOBufChain chain;
+		while(left && (size = readChain(chain, size_t(std::min(int64_t(IOBuf::BlockSize),left)))))
+		{
+			left-=size;
+			s.writeChain(chain);
+			chain.clear();
+		}
+	}
+	else {
+		char buffer[BufferSize];
+		while(left && (size = readData(buffer,size_t(std::min(int64_t(BufferSize),left)))))
+		{
+			left-=size;
+			mLast = buffer[size-1];
+			s.writeData(buffer,size);
+		}
 	}
 	mEnd = (left != 0);
 	return max-left;
@@ -33,6 +33,7 @@ class Serializable;
 class BinaryString;
 class String;
 class Pipe;
+class IOBufChain;
 
 class Stream
 {
@@ -68,8 +69,17 @@ public:
 
 	size_t readData(Stream &s, size_t max);
 	size_t writeData(Stream &s, size_t max);
+
+	// Buffer chains, received bytes are lent and sent buffers are taken without copy where supported
+	virtual size_t readChain(IOBufChain &chain, size_t max);	// appends up to max bytes, returns 0 at the end
+	virtual void writeChain(const IOBufChain &chain);
+	virtual bool lendsBuffers(void) const;	// true if readChain() shares buffers instead of reading into new ones
 	inline void discard(void) { clear(); }
 
+	// Spans, readable bytes are exposed in place where the stream holds them in memory
+	virtual bool peekSpan(const char *&data, size_t &size);	// false if unsupported, otherwise waits like readData, size is 0 at the end
+	virtual void consume(size_t size);	// drops size bytes of the span, which is invalidated
+
 	// Atomic
 	bool get(char &chr);
 	void put(char chr);
@@ -200,6 +210,9 @@ protected:
 	bool mFailed = false;
 
 private:
+	struct CharClass;
+	int64_t scanSpans(const CharClass &delimiters, Stream *output, size_t max);	// -1 if spans are unsupported
+
 	bool readStdString(std::string &output);
 
 	template<typename T> bool readStd(T &val);
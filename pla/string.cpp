@@ -837,7 +837,7 @@ size_t String::readData(char *buffer, size_t size)
 {
 	size = std::min(size,this->size());
 	std::copy(begin(),begin()+size,buffer);
-	erase(begin(),begin()+size); // WARNING: linear with string size
+	erase(begin(),begin()+size); // WARNING: linear with string size, use ByteQueue as a FIFO
 	return size;
 }
 
@@ -846,4 +846,16 @@ void String::writeData(const char *data, size_t size)
 	insert(end(), data, data+size);
 }
 
+bool String::peekSpan(const char *&data, size_t &size)
+{
+	data = this->data();
+	size = this->size();
+	return true;
+}
+
+void String::consume(size_t size)
+{
+	erase(begin(),begin()+std::min(size,this->size())); // one erase for a whole scan instead of one per character
+}
+
 }
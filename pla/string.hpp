@@ -147,6 +147,8 @@ protected:
 	// Stream
 	size_t readData(char *buffer, size_t size);
 	void writeData(const char *data, size_t size);
+	bool peekSpan(const char *&data, size_t &size);
+	void consume(size_t size);
 };
 
 template<typename T> String String::number(T n)
@@ -136,7 +136,11 @@ inline void ThreadPool::clear(void)
 
 inline void ThreadPool::join(void)
 {
-	joining = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		joining = true;
+		condition.notify_all();	// wake up idle workers
+	}
 
 	for(std::thread &w: workers)
 		if(w.joinable())
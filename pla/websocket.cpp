@@ -0,0 +1,742 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#include "pla/websocket.hpp"
+#include "pla/exception.hpp"
+#include "pla/crypto.hpp"
+#include "pla/random.hpp"
+#include "pla/socket.hpp"
+#include "pla/securetransport.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace pla
+{
+
+size_t WebSocket::MaxMessageSize = 16*1024*1024;
+size_t WebSocket::FragmentSize = 64*1024;
+int WebSocket::CompressionLevel = 1;
+size_t WebSocket::CompressionMinSize = 64;
+
+static const size_t ReadSize = 64*1024;
+static const char DeflateTail[4] = { '\x00', '\x00', '\xFF', '\xFF' };	// removed from compressed messages
+
+// Parses a Sec-WebSocket-Extensions header, returns true if permessage-deflate is acceptable
+// Messages are always compressed with the maximum window, but inflating accepts any window
+static bool ParseDeflateExtension(const String &header, bool server, bool &serverNoContextTakeover, bool &clientNoContextTakeover)
+{
+	List<String> offers;
+	header.explode(offers, ',');
+	for(List<String>::iterator it = offers.begin(); it != offers.end(); ++it)
+	{
+		List<String> params;
+		it->explode(params, ';');
+		if(params.empty() || params.front().trimmed() != "permessage-deflate")
+			continue;
+
+		bool acceptable = true;
+		serverNoContextTakeover = false;
+		clientNoContextTakeover = false;
+		for(List<String>::iterator jt = ++params.begin(); jt != params.end(); ++jt)
+		{
+			String name = *jt;
+			String value = name.cut('=');
+			name.trim();
+			value.trim();
+			value.trimQuotes();
+
+			// In an offer, client_max_window_bits can have no value
+			int bits = (value.empty() && server ? MAX_WBITS : value.toInt());
+			bool valid = (bits >= 8 && bits <= MAX_WBITS);
+
+			if(name == "server_no_context_takeover") serverNoContextTakeover = true;
+			else if(name == "client_no_context_takeover") clientNoContextTakeover = true;
+			else if(name == "client_max_window_bits")
+			{
+				// The client compresses with this window and the server inflates it
+				if(!valid || (!server && bits != MAX_WBITS)) acceptable = false;
+			}
+			else if(name == "server_max_window_bits")
+			{
+				// The server compresses with this window and the client inflates it
+				if(!valid || (server && bits != MAX_WBITS)) acceptable = false;
+			}
+			else acceptable = false;
+		}
+
+		if(acceptable) return true;
+	}
+
+	return false;
+}
+
+// Checks UTF-8 as defined by RFC 3629, rejecting overlong forms, surrogates and code points above U+10FFFF
+static bool IsValidUtf8(const char *data, size_t size)
+{
+	const uint8_t *p = reinterpret_cast<const uint8_t*>(data);
+	const uint8_t *end = p + size;
+	while(p != end)
+	{
+		// Skip ASCII a word at a time
+		uint64_t word;
+		while(end - p >= 8 && (std::memcpy(&word, p, 8), (word & 0x8080808080808080ULL) == 0))
+			p+= 8;
+
+		if(p == end) break;
+		if(*p < 0x80)
+		{
+			++p;
+			continue;
+		}
+
+		size_t count;
+		uint8_t min = 0x80, max = 0xBF;	// range of the second byte
+		if(*p >= 0xC2 && *p <= 0xDF) count = 1;
+		else if(*p >= 0xE0 && *p <= 0xEF)
+		{
+			count = 2;
+			if(*p == 0xE0) min = 0xA0;			// overlong
+			else if(*p == 0xED) max = 0x9F;		// surrogates
+		}
+		else if(*p >= 0xF0 && *p <= 0xF4)
+		{
+			count = 3;
+			if(*p == 0xF0) min = 0x90;			// overlong
+			else if(*p == 0xF4) max = 0x8F;		// above U+10FFFF
+		}
+		else return false;
+
+		if(size_t(end - p) <= count) return false;
+		if(p[1] < min || p[1] > max) return false;
+		for(size_t i = 2; i <= count; ++i)
+			if((p[i] & 0xC0) != 0x80)
+				return false;
+
+		p+= count + 1;
+	}
+
+	return true;
+}
+
+WebSocket *WebSocket::Upgrade(Http::Request &request, bool deflate)
+{
+	String upgrade, connection, key, version;
+	request.headers.get("Upgrade", upgrade);
+	request.headers.get("Connection", connection);
+	if(request.method != "GET" || upgrade.toLower() != "websocket" || !connection.toLower().contains("upgrade"))
+		return NULL;
+
+	if(!request.headers.get("Sec-WebSocket-Key", key) || key.trimmed().empty())
+		throw 400;
+
+	if(!request.headers.get("Sec-WebSocket-Version", version) || version.trimmed() != "13")
+		throw 400;
+
+	bool serverNoContextTakeover = false;
+	bool clientNoContextTakeover = false;
+	String extensions;
+	if(deflate)
+		deflate = request.headers.get("Sec-WebSocket-Extensions", extensions)
+			&& ParseDeflateExtension(extensions, true, serverNoContextTakeover, clientNoContextTakeover);
+
+	// The session holds a server thread, so the server limits upgraded connections
+	if(request.server && !request.server->upgrade(request))
+		throw 503;
+
+	Http::Response response(request, 101);
+	response.headers.erase("Content-Type");
+	response.headers["Upgrade"] = "websocket";
+	response.headers["Connection"] = "Upgrade";
+	response.headers["Sec-WebSocket-Accept"] = AcceptKey(key.trimmed());
+	if(deflate)
+	{
+		response.headers["Sec-WebSocket-Extensions"] = "permessage-deflate";
+		if(serverNoContextTakeover) response.headers["Sec-WebSocket-Extensions"]+= "; server_no_context_takeover";
+	}
+
+	response.send();
+	response.stream->flush();
+
+	// The connection ends with the WebSocket
+	request.keepAlive = false;
+	request.persistent = false;
+
+	WebSocket *ws = new WebSocket(request.stream, false);
+	ws->setDeflate(deflate, serverNoContextTakeover);
+	return ws;
+}
+
+WebSocket *WebSocket::Connect(const String &url, const StringMap &headers, bool deflate)
+{
+	int p = url.find("://");
+	String scheme = (p != String::NotFound ? String(url.substr(0, p)).toLower() : "");
+	if(scheme != "ws" && scheme != "wss")
+		throw Exception("Invalid WebSocket URL: " + url);
+
+	Http::Request request((scheme == "ws" ? "http" : "https") + url.substr(p), "GET");
+	request.version = "1.1";
+	request.headers.insert(headers);
+
+	String host;
+	if(!request.headers.get("Host", host))
+		throw Exception("Invalid URL");
+
+	List<Address> addrs;
+	if(!Address::Resolve(host, addrs, request.protocol.toLower()))
+		throw NetException("Unable to resolve: " + host);
+
+	Socket *sock = new Socket;
+	Stream *stream = sock;
+	try {
+		sock->setConnectTimeout(Http::ConnectTimeout);
+		sock->setReadTimeout(Http::RequestTimeout);
+		for(List<Address>::iterator it = addrs.begin(); it != addrs.end(); ++it)
+		{
+			try {
+				sock->connect(*it, true);
+				break;
+			}
+			catch(const NetException &e)
+			{
+				// Connection failed for this address
+			}
+		}
+
+		if(!sock->isConnected())
+			throw NetException("Connection to " + host + " failed");
+
+		sock->setNoDelay(true);	// messages are small and latency-sensitive
+
+		if(request.protocol == "HTTPS")
+			stream = new SecureTransportClient(sock, new SecureTransportClient::Certificate, host);
+
+		BinaryString nonce(16, '\0');
+		Random().generate(nonce.ptr(), nonce.size());
+		String key = nonce.base64Encode();
+
+		request.headers["Upgrade"] = "websocket";
+		request.headers["Connection"] = "Upgrade";
+		request.headers["Sec-WebSocket-Key"] = key;
+		request.headers["Sec-WebSocket-Version"] = "13";
+		if(deflate) request.headers["Sec-WebSocket-Extensions"] = "permessage-deflate; client_max_window_bits";
+		request.send(stream);
+
+		Http::Response response;
+		response.recv(stream);
+
+		String upgrade, accept, extensions;
+		response.headers.get("Upgrade", upgrade);
+		response.headers.get("Sec-WebSocket-Accept", accept);
+		if(response.code != 101 || upgrade.toLower() != "websocket" || accept.trimmed() != AcceptKey(key))
+			throw NetException("WebSocket handshake failed with status " + String::number(response.code));
+
+		bool serverNoContextTakeover = false;
+		bool clientNoContextTakeover = false;
+		if(deflate && response.headers.get("Sec-WebSocket-Extensions", extensions) && !extensions.trimmed().empty())
+		{
+			// The server might already compress, so an unacceptable response fails the connection (RFC 7692 section 5)
+			if(!ParseDeflateExtension(extensions, false, serverNoContextTakeover, clientNoContextTakeover))
+				throw NetException("WebSocket handshake failed: unacceptable extensions: " + extensions);
+		}
+		else {
+			deflate = false;
+		}
+
+		sock->setReadTimeout(seconds(-1.));	// messages can be awaited with waitData()
+
+		WebSocket *ws = new WebSocket(stream, true, true);
+		ws->setDeflate(deflate, clientNoContextTakeover);
+		return ws;
+	}
+	catch(...)
+	{
+		delete stream;
+		throw;
+	}
+}
+
+WebSocket::WebSocket(Stream *stream, bool client, bool mustDelete) :
+	mStream(stream),
+	mClient(client),
+	mMustDelete(mustDelete),
+	mInputOffset(0),
+	mMessageOffset(0),
+	mHasMessage(false),
+	mMessageBinary(false),
+	mWriteStarted(false),
+	mBinary(false),
+	mCloseSent(false),
+	mCloseReceived(false),
+	mDeflateEnabled(false),
+	mResetDeflate(false),
+	mInflateInit(false)
+{
+	Assert(mStream);
+	std::memset(&mInflate, 0, sizeof(mInflate));
+}
+
+WebSocket::~WebSocket(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(mWriteMutex);
+		if(!mCloseSent) NOEXCEPTION(sendClose(1000));	// going away would be 1001, but the session is over
+	}
+
+	mDeflate.reset();
+	if(mInflateInit) inflateEnd(&mInflate);
+	if(mMustDelete) delete mStream;
+}
+
+void WebSocket::setDeflate(bool enabled, bool resetDeflate)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	mDeflateEnabled = enabled;
+	mResetDeflate = resetDeflate;
+	mDeflate.reset();
+}
+
+void WebSocket::setBinary(bool enabled)
+{
+	mBinary = enabled;
+}
+
+bool WebSocket::isBinary(void) const
+{
+	return mMessageBinary;
+}
+
+bool WebSocket::isClosed(void) const
+{
+	return mCloseReceived;
+}
+
+bool WebSocket::receive(BinaryString &message)
+{
+	if(!mHasMessage && !receiveMessage())
+		return false;
+
+	message.assign(mMessage.data() + mMessageOffset, mMessage.size() - mMessageOffset);
+	mHasMessage = false;
+	return true;
+}
+
+void WebSocket::send(const String &message)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	sendMessage(Text, message.data(), message.size());
+	mStream->flush();
+}
+
+void WebSocket::send(const BinaryString &message)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	sendMessage(Binary, message.data(), message.size());
+	mStream->flush();
+}
+
+void WebSocket::ping(const BinaryString &payload)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	sendFrame(Ping, payload.data(), std::min(payload.size(), size_t(125)), true);
+	mStream->flush();
+}
+
+void WebSocket::close(int code)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	if(!mCloseSent) sendClose(code);
+}
+
+size_t WebSocket::readData(char *buffer, size_t size)
+{
+	if(!mHasMessage && !receiveMessage())
+		return 0;
+
+	size = std::min(size, mMessage.size() - mMessageOffset);
+	std::memcpy(buffer, mMessage.data() + mMessageOffset, size);
+	mMessageOffset+= size;
+	return size;
+}
+
+void WebSocket::writeData(const char *data, size_t size)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	mWriteBuffer.append(data, size);
+
+	// Without compression, large messages are sent as fragments while they are written
+	if(!mDeflateEnabled)
+	{
+		while(mWriteBuffer.size() > FragmentSize)
+		{
+			sendFrame(mWriteStarted ? Continuation : (mBinary ? Binary : Text), mWriteBuffer.data(), FragmentSize, false);
+			mWriteBuffer.consume(FragmentSize);
+			mWriteStarted = true;
+		}
+	}
+}
+
+bool WebSocket::waitData(duration timeout)
+{
+	if(mHasMessage && mMessageOffset < mMessage.size()) return true;
+	if(mInputOffset < mInput.size()) return true;
+	if(mCloseReceived) return false;
+	return mStream->waitData(timeout);
+}
+
+bool WebSocket::nextRead(void)
+{
+	if(!mHasMessage && mCloseReceived) return false;
+	mHasMessage = false;
+	return !mCloseReceived;
+}
+
+bool WebSocket::nextWrite(void)
+{
+	std::unique_lock<std::mutex> lock(mWriteMutex);
+	if(mWriteStarted) sendFrame(Continuation, mWriteBuffer.data(), mWriteBuffer.size(), true);
+	else sendMessage(mBinary ? Binary : Text, mWriteBuffer.data(), mWriteBuffer.size());
+
+	mWriteBuffer.clear();
+	mWriteStarted = false;
+	mStream->flush();
+	return true;
+}
+
+void WebSocket::flush(void)
+{
+	mStream->flush();
+}
+
+void WebSocket::close(void)
+{
+	close(1000);
+}
+
+bool WebSocket::isDatagram(void) const
+{
+	return true;
+}
+
+String WebSocket::AcceptKey(const String &key)
+{
+	BinaryString digest;
+	String str = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	Sha1().compute(str.data(), str.size(), digest);
+	return digest.base64Encode();
+}
+
+void WebSocket::Mask(char *data, size_t size, const char *key)
+{
+	// XOR with the key repeated, wide blocks keep the key phase since their size is a multiple of 4
+	uint32_t pattern;
+	std::memcpy(&pattern, key, 4);
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi32(int(pattern));
+	for(; i + 16 <= size; i+= 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, mask));
+	}
+#endif
+
+	const uint64_t mask64 = uint64_t(pattern) | (uint64_t(pattern) << 32);
+	for(; i + 8 <= size; i+= 8)
+	{
+		uint64_t block;
+		std::memcpy(&block, data + i, 8);
+		block^= mask64;
+		std::memcpy(data + i, &block, 8);
+	}
+
+	for(; i < size; ++i)
+		data[i]^= key[i % 4];
+}
+
+bool WebSocket::fill(size_t size)
+{
+	if(mInputOffset == mInput.size())
+	{
+		mInput.clear();
+		mInputOffset = 0;
+	}
+	else if(mInputOffset >= ReadSize)
+	{
+		mInput.erase(0, mInputOffset);
+		mInputOffset = 0;
+	}
+
+	char buffer[ReadSize];
+	while(mInput.size() - mInputOffset < size)
+	{
+		size_t len = mStream->readData(buffer, ReadSize);
+		if(!len) return false;
+		mInput.append(buffer, len);
+	}
+
+	return true;
+}
+
+bool WebSocket::receiveMessage(void)
+{
+	if(mCloseReceived) return false;
+
+	mMessage.clear();
+	mMessageOffset = 0;
+
+	int type = -1;
+	bool compressed = false;
+	BinaryString deflated;
+	while(true)
+	{
+		if(!fill(2))
+		{
+			mCloseReceived = true;
+			if(type >= 0) throw NetException("WebSocket connection closed in a message");
+			return false;
+		}
+
+		const uint8_t *head = reinterpret_cast<const uint8_t*>(mInput.data() + mInputOffset);
+		bool fin = (head[0] & 0x80) != 0;
+		bool rsv1 = (head[0] & 0x40) != 0;
+		int opcode = head[0] & 0x0F;
+		bool masked = (head[1] & 0x80) != 0;
+		uint64_t length = head[1] & 0x7F;
+
+		size_t headSize = 2;
+		if(length == 126) headSize+= 2;
+		else if(length == 127) headSize+= 8;
+		if(masked) headSize+= 4;
+
+		if(head[0] & 0x30) fail(1002, "Reserved bits set");
+		if(rsv1 && (!mDeflateEnabled || opcode == Continuation || (opcode & 0x08))) fail(1002, "Unexpected compressed frame");
+		if(masked == mClient) fail(1002, mClient ? "Masked frame from server" : "Unmasked frame from client");
+		if((opcode & 0x08) && (!fin || length > 125)) fail(1002, "Invalid control frame");
+
+		if(!fill(headSize)) throw NetException("WebSocket connection closed in a frame");
+		head = reinterpret_cast<const uint8_t*>(mInput.data() + mInputOffset);
+
+		if(length >= 126)
+		{
+			size_t count = (length == 126 ? 2 : 8);
+			length = 0;
+			for(size_t i = 0; i < count; ++i)
+				length = (length << 8) | head[2 + i];
+		}
+
+		if(length > MaxMessageSize || mMessage.size() + deflated.size() + length > MaxMessageSize)
+			fail(1009, "Message too large");
+
+		if(!fill(headSize + size_t(length))) throw NetException("WebSocket connection closed in a frame");
+
+		char *payload = mInput.ptr() + mInputOffset + headSize;
+		if(masked) Mask(payload, size_t(length), payload - 4);
+		mInputOffset+= headSize + size_t(length);
+
+		switch(opcode)
+		{
+		case Ping:
+		{
+			std::unique_lock<std::mutex> lock(mWriteMutex);
+			if(!mCloseSent)
+			{
+				sendFrame(Pong, payload, size_t(length), true);
+				mStream->flush();
+			}
+			break;
+		}
+
+		case Pong:
+			break;
+
+		case Close:
+		{
+			mCloseReceived = true;
+			std::unique_lock<std::mutex> lock(mWriteMutex);
+			if(!mCloseSent)
+			{
+				int code = 1000;
+				if(length >= 2) code = (uint8_t(payload[0]) << 8) | uint8_t(payload[1]);
+				sendClose(code);
+			}
+			return false;
+		}
+
+		case Text:
+		case Binary:
+		case Continuation:
+			if((opcode == Continuation) != (type >= 0))
+				fail(1002, "Unexpected continuation frame");
+
+			if(type < 0)
+			{
+				type = opcode;
+				compressed = rsv1;
+			}
+
+			if(compressed) deflated.append(payload, size_t(length));
+			else mMessage.append(payload, size_t(length));
+
+			if(fin)
+			{
+				if(compressed) inflate(deflated, mMessage);
+
+				// Text messages must be valid UTF-8 once complete (RFC 6455 8.1)
+				if(type == Text && !IsValidUtf8(mMessage.data(), mMessage.size()))
+					fail(1007, "Invalid UTF-8 in text message");
+
+				mMessageBinary = (type == Binary);
+				mHasMessage = true;
+				return true;
+			}
+			break;
+
+		default:
+			fail(1002, "Unknown opcode");
+		}
+	}
+}
+
+void WebSocket::fail(int code, const String &reason)
+{
+	{
+		std::unique_lock<std::mutex> lock(mWriteMutex);
+		if(!mCloseSent) NOEXCEPTION(sendClose(code));
+	}
+
+	mCloseReceived = true;
+	throw NetException("WebSocket error: " + reason);
+}
+
+void WebSocket::sendFrame(int opcode, const char *data, size_t size, bool fin, bool compressed)
+{
+	if(mCloseSent) throw NetException("WebSocket is closed");
+
+	mFrame.clear();
+	mFrame.reserve(14 + size);
+	mFrame+= char((fin ? 0x80 : 0x00) | (compressed ? 0x40 : 0x00) | opcode);
+
+	char maskBit = (mClient ? char(0x80) : char(0x00));
+	if(size < 126)
+	{
+		mFrame+= char(maskBit | char(size));
+	}
+	else if(size <= 0xFFFF)
+	{
+		mFrame+= char(maskBit | 126);
+		mFrame+= char(size >> 8);
+		mFrame+= char(size);
+	}
+	else {
+		mFrame+= char(maskBit | 127);
+		for(int i = 7; i >= 0; --i)
+			mFrame+= char(uint64_t(size) >> (8*i));
+	}
+
+	size_t offset = mFrame.size();
+	if(mClient)
+	{
+		char key[4];
+		Random().generate(key, 4);
+		mFrame.append(key, 4);
+		offset+= 4;
+	}
+
+	mFrame.append(data, size);
+	if(mClient) Mask(mFrame.ptr() + offset, size, mFrame.data() + offset - 4);
+
+	mStream->writeData(mFrame.data(), mFrame.size());
+}
+
+void WebSocket::sendMessage(int opcode, const char *data, size_t size)
+{
+	bool compressed = false;
+	if(mDeflateEnabled && size >= CompressionMinSize)
+	{
+		// A sync flush ends the message on a byte boundary, its empty block is implied
+		if(!mDeflate || mResetDeflate) mDeflate = std::make_shared<Deflate>(&mDeflated, Deflate::Raw, CompressionLevel);
+		mDeflated.clear();
+		mDeflate->writeData(data, size);
+		mDeflate->flush();
+
+		Assert(mDeflated.size() >= 4 && std::memcmp(mDeflated.data() + mDeflated.size() - 4, DeflateTail, 4) == 0);
+		mDeflated.resize(mDeflated.size() - 4);
+		data = mDeflated.data();
+		size = mDeflated.size();
+		compressed = true;
+	}
+
+	size_t offset = 0;
+	do {
+		size_t len = std::min(size - offset, FragmentSize);
+		bool first = (offset == 0);
+		sendFrame(first ? opcode : Continuation, data + offset, len, offset + len == size, first && compressed);
+		offset+= len;
+	}
+	while(offset < size);
+}
+
+void WebSocket::sendClose(int code)
+{
+	char payload[2] = { char(code >> 8), char(code) };
+	sendFrame(Close, payload, 2, true);
+	mCloseSent = true;
+	mStream->flush();
+}
+
+void WebSocket::inflate(const BinaryString &input, BinaryString &output)
+{
+	if(!mInflateInit)
+	{
+		if(inflateInit2(&mInflate, -MAX_WBITS) != Z_OK)
+			throw Exception("Unable to initialize inflate");
+
+		mInflateInit = true;
+	}
+
+	// The context is kept between messages, as the peer may refer to previous ones
+	const char *chunks[2] = { input.data(), DeflateTail };
+	size_t sizes[2] = { input.size(), 4 };
+	char buffer[ReadSize];
+	for(int i = 0; i < 2; ++i)
+	{
+		mInflate.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunks[i]));
+		mInflate.avail_in = uInt(sizes[i]);
+		do {
+			mInflate.next_out = reinterpret_cast<Bytef*>(buffer);
+			mInflate.avail_out = uInt(ReadSize);
+			int ret = ::inflate(&mInflate, Z_SYNC_FLUSH);
+			if(ret != Z_OK && ret != Z_BUF_ERROR)
+				fail(1007, "Invalid compressed data");
+
+			output.append(buffer, ReadSize - mInflate.avail_out);
+			if(output.size() > MaxMessageSize)
+				fail(1009, "Message too large");
+		}
+		while(mInflate.avail_out == 0);
+	}
+}
+
+}
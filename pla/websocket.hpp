@@ -0,0 +1,126 @@
+/*************************************************************************
+ *   Copyright (C) 2011-2017 by Paul-Louis Ageneau                       *
+ *   paul-louis (at) ageneau (dot) org                                   *
+ *                                                                       *
+ *   This file is part of Plateform.                                     *
+ *                                                                       *
+ *   Plateform is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Affero General Public License as      *
+ *   published by the Free Software Foundation, either version 3 of      *
+ *   the License, or (at your option) any later version.                 *
+ *                                                                       *
+ *   Plateform is distributed in the hope that it will be useful, but    *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the        *
+ *   GNU Affero General Public License for more details.                 *
+ *                                                                       *
+ *   You should have received a copy of the GNU Affero General Public    *
+ *   License along with Plateform.                                       *
+ *   If not, see <http://www.gnu.org/licenses/>.                         *
+ *************************************************************************/
+
+
+#ifndef PLA_WEBSOCKET_H
+#define PLA_WEBSOCKET_H
+
+#include "pla/include.hpp"
+#include "pla/stream.hpp"
+#include "pla/string.hpp"
+#include "pla/binarystring.hpp"
+#include "pla/bytequeue.hpp"
+#include "pla/deflate.hpp"
+#include "pla/http.hpp"
+
+#include <zlib.h>
+
+namespace pla
+{
+
+// WebSocket connection (RFC 6455) with permessage-deflate (RFC 7692)
+// Messages behave as datagrams: readData() reads the current message, nextRead() moves to the next one,
+// writeData() appends to the outgoing message and nextWrite() sends it. Pings are answered while reading.
+// Sending is thread-safe, so one thread can read while others send.
+class WebSocket : public Stream
+{
+public:
+	static size_t MaxMessageSize;	// larger incoming messages close the connection
+	static size_t FragmentSize;		// outgoing messages are split in frames of this size
+	static int CompressionLevel;
+	static size_t CompressionMinSize;	// smaller messages are sent uncompressed
+
+	// Server side, answers the handshake with 101 from Server::process()
+	// Returns NULL if the request is not a WebSocket upgrade, the caller keeps ownership of the result
+	// The session holds a server thread until process() returns, reads on the connection do not time out
+	// Throws 503 if the server reached its limit of upgraded connections, see Http::Server::setUpgradeLimit()
+	static WebSocket *Upgrade(Http::Request &request, bool deflate = true);
+
+	// Client side, for ws:// and wss:// URLs
+	static WebSocket *Connect(const String &url, const StringMap &headers = StringMap(), bool deflate = true);
+
+	WebSocket(Stream *stream, bool client, bool mustDelete = false);	// handshake already done
+	~WebSocket(void);
+
+	void setDeflate(bool enabled, bool resetDeflate = false);	// as negotiated, resetDeflate for no context takeover
+	void setBinary(bool enabled);	// type of outgoing messages, text by default
+
+	bool isBinary(void) const;		// type of the current incoming message
+	bool isClosed(void) const;
+
+	bool receive(BinaryString &message);	// returns false once closed
+	void send(const String &message);		// text message
+	void send(const BinaryString &message);	// binary message
+	void ping(const BinaryString &payload = "");
+	void close(int code);
+
+	// Stream
+	size_t readData(char *buffer, size_t size);
+	void writeData(const char *data, size_t size);
+	bool waitData(duration timeout);
+	bool nextRead(void);
+	bool nextWrite(void);
+	void flush(void);
+	void close(void);	// sends a normal close
+	bool isDatagram(void) const;
+
+private:
+	enum Opcode { Continuation = 0x0, Text = 0x1, Binary = 0x2, Close = 0x8, Ping = 0x9, Pong = 0xA };
+
+	static String AcceptKey(const String &key);
+	static void Mask(char *data, size_t size, const char *key);
+
+	bool fill(size_t size);	// buffers at least size bytes of input, false on end of stream
+	bool receiveMessage(void);
+	void fail(int code, const String &reason);	// closes with code and throws
+	void sendFrame(int opcode, const char *data, size_t size, bool fin, bool compressed = false);	// mWriteMutex must be locked
+	void sendMessage(int opcode, const char *data, size_t size);	// mWriteMutex must be locked
+	void sendClose(int code);	// mWriteMutex must be locked
+	void inflate(const BinaryString &input, BinaryString &output);
+
+	Stream *mStream;
+	bool mClient;
+	bool mMustDelete;
+
+	String mInput;		// buffered frames
+	size_t mInputOffset;
+	BinaryString mMessage;	// current incoming message
+	size_t mMessageOffset;
+	bool mHasMessage;
+	bool mMessageBinary;
+
+	ByteQueue mWriteBuffer;		// outgoing message
+	bool mWriteStarted;			// a first fragment was already sent
+	bool mBinary;
+	bool mCloseSent, mCloseReceived;
+	BinaryString mFrame;
+	std::mutex mWriteMutex;
+
+	bool mDeflateEnabled, mResetDeflate;
+	sptr<Deflate> mDeflate;		// persistent context unless mResetDeflate
+	BinaryString mDeflated;
+	z_stream mInflate;
+	bool mInflateInit;
+};
+
+}
+
+#endif